@@ -0,0 +1,24 @@
+#ifndef BITOPS_H
+#define BITOPS_H
+
+#include <cstdint>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Index of the highest set bit of value (0 for 1, 63 for 2^63), value must not be 0
+inline int highestBit(const uint64_t value) {
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return static_cast<int>(index);
+#elif defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(value);
+#else
+    int index = 0;
+    for (uint64_t rest = value; rest >>= 1;) index++;
+    return index;
+#endif
+}
+
+#endif // BITOPS_H
@@ -0,0 +1,427 @@
+#include "contractionhierarchy.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+
+#include "mapgraph.h"
+#include "threadpool.h"
+
+namespace {
+
+using Arc = ContractionHierarchy::Arc;
+using TimeQueue = std::priority_queue<std::pair<double, int>, std::vector<std::pair<double, int>>, std::greater<>>;
+
+constexpr double unreached = std::numeric_limits<double>::infinity();
+// Nodes a witness search may settle, and arcs a witness may have, before giving up and
+// keeping the shortcut. Extra shortcuts never change an answer, only the size of the hierarchy.
+constexpr size_t contractSettleLimit = 1000;
+constexpr size_t simulateSettleLimit = 100;
+constexpr int contractHopLimit = 5;
+constexpr int simulateHopLimit = 2;
+// Smaller sweep levels run on the calling thread, the hand-off would cost more than the work
+constexpr size_t parallelSweepLevel = 4096;
+
+class Contractor {
+public:
+    Contractor(const CsrGraph& graph, const double* arcMinutes) {
+        const int nodeCount = static_cast<int>(graph.nodeCount());
+        adjacency.resize(nodeCount);
+        for (int node = 0; node < nodeCount; node++) {
+            for (uint32_t arc = graph.firstArc(node); arc < graph.lastArc(node); arc++) {
+                const int target = graph.targets[arc];
+                if (target != node) addArc(node, {target, -1, arcMinutes[arc], graph.distance[arc]});
+            }
+        }
+        contracted.assign(nodeCount, 0);
+        changed.assign(nodeCount, 0);
+        deletedNeighbors.assign(nodeCount, 0);
+        level.assign(nodeCount, 0);
+        witness.assign(nodeCount, unreached);
+        hops.assign(nodeCount, 0);
+        targetOf.assign(nodeCount, 0);
+    }
+
+    // Contracts every node; upward[v] receives the arcs v still had to live nodes
+    void run(std::vector<std::vector<Arc>>& upward, size_t& shortcutCount) {
+        const int nodeCount = static_cast<int>(adjacency.size());
+        upward.assign(nodeCount, {});
+
+        TimeQueue order; // (priority, node)
+        for (int node = 0; node < nodeCount; node++) order.emplace(priority(node), node);
+
+        std::vector<Shortcut> shortcuts;
+        while (!order.empty()) {
+            const int node = order.top().second;
+            order.pop();
+            if (contracted[node]) continue;
+
+            // Lazy update: a node whose neighbourhood changed since its priority was stored is
+            // contracted only if its recomputed priority is still the smallest
+            if (changed[node]) {
+                changed[node] = 0;
+                if (const double current = priority(node); !order.empty() && current > order.top().first) {
+                    order.emplace(current, node);
+                    continue;
+                }
+            }
+
+            shortcuts.clear();
+            findShortcuts(node, contractSettleLimit, contractHopLimit, shortcuts);
+            contracted[node] = 1;
+            upward[node] = std::move(adjacency[node]);
+            adjacency[node] = {};
+            for (const Arc& arc : upward[node]) {
+                auto& neighbor = adjacency[arc.target];
+                neighbor.erase(std::remove_if(neighbor.begin(), neighbor.end(),
+                                              [node](const Arc& other) { return other.target == node; }),
+                               neighbor.end());
+                deletedNeighbors[arc.target]++;
+                changed[arc.target] = 1;
+                level[arc.target] = std::max(level[arc.target], level[node] + 1);
+            }
+            for (const auto& [from, to, time, distance] : shortcuts) {
+                addArc(from, {to, node, time, distance});
+                addArc(to, {from, node, time, distance});
+            }
+            shortcutCount += shortcuts.size();
+            // Recomputing every neighbour's priority right here costs twice the build time on
+            // grids for no better order; the changed flags above refresh them when they come up
+        }
+    }
+
+private:
+    struct Shortcut {
+        int from;
+        int to;
+        double time;
+        double distance;
+    };
+
+    // Edge difference, plus contracted neighbours and depth, which spread contraction
+    // evenly over the map instead of growing one dense core
+    double priority(const int node) {
+        simulated.clear();
+        findShortcuts(node, simulateSettleLimit, simulateHopLimit, simulated);
+        const double edgeDifference = static_cast<double>(simulated.size()) - static_cast<double>(adjacency[node].size());
+        return 2 * edgeDifference + deletedNeighbors[node] + level[node];
+    }
+
+    // Shortcuts needed between the live neighbours of node if it were removed
+    void findShortcuts(const int node, const size_t settleLimit, const int hopLimit, std::vector<Shortcut>& out) {
+        const std::vector<Arc>& arcs = adjacency[node];
+        for (size_t i = 0; i + 1 < arcs.size(); i++) {
+            double limit = 0;
+            for (size_t j = i + 1; j < arcs.size(); j++) limit = std::max(limit, arcs[i].time + arcs[j].time);
+            // The targets are the neighbours after i, each pair is checked once
+            searchId++;
+            for (size_t j = i + 1; j < arcs.size(); j++) targetOf[arcs[j].target] = searchId;
+            witnessSearch(arcs[i].target, node, limit, settleLimit, hopLimit, arcs.size() - i - 1);
+            for (size_t j = i + 1; j < arcs.size(); j++) {
+                // A witness as short as the path through node makes the shortcut unnecessary
+                if (const double via = arcs[i].time + arcs[j].time; witness[arcs[j].target] > via) {
+                    out.push_back({arcs[i].target, arcs[j].target, via, arcs[i].distance + arcs[j].distance});
+                }
+            }
+        }
+    }
+
+    // Dijkstra from source over live nodes except skipped, up to limit minutes or
+    // until every node marked as a target of this search is settled. Paths stop
+    // growing at hopLimit arcs.
+    void witnessSearch(const int source, const int skipped, const double limit, const size_t settleLimit,
+                       const int hopLimit, size_t targets) {
+        for (const int node : touched) witness[node] = unreached;
+        touched.clear();
+
+        heap.clear();
+        witness[source] = 0;
+        hops[source] = 0;
+        touched.push_back(source);
+        heap.emplace_back(0.0, source);
+        for (size_t settled = 0; !heap.empty() && settled < settleLimit; settled++) {
+            std::pop_heap(heap.begin(), heap.end(), std::greater<>());
+            const auto [time, node] = heap.back();
+            heap.pop_back();
+            if (time > witness[node]) continue;
+            if (time > limit) break;
+            if (targetOf[node] == searchId && --targets == 0) break;
+            if (hops[node] == hopLimit) continue;
+            for (const Arc& arc : adjacency[node]) {
+                if (arc.target == skipped) continue;
+                if (const double newTime = time + arc.time; newTime < witness[arc.target]) {
+                    if (witness[arc.target] == unreached) touched.push_back(arc.target);
+                    witness[arc.target] = newTime;
+                    hops[arc.target] = hops[node] + 1;
+                    heap.emplace_back(newTime, arc.target);
+                    std::push_heap(heap.begin(), heap.end(), std::greater<>());
+                }
+            }
+        }
+    }
+
+    // Keeps only the faster of two parallel arcs
+    void addArc(const int from, const Arc& arc) {
+        for (Arc& existing : adjacency[from]) {
+            if (existing.target == arc.target) {
+                if (arc.time < existing.time) existing = arc;
+                return;
+            }
+        }
+        adjacency[from].push_back(arc);
+    }
+
+    std::vector<std::vector<Arc>> adjacency; // arcs between live nodes
+    std::vector<char> contracted;
+    std::vector<char> changed; // a neighbour was contracted since the priority was stored
+    std::vector<int> deletedNeighbors;
+    std::vector<int> level; // longest chain of contracted nodes below
+    std::vector<double> witness;
+    std::vector<int> hops; // arcs on the witness path to the node
+    std::vector<int> touched;
+    std::vector<std::pair<double, int>> heap; // witness search queue, its memory kept between searches
+    std::vector<uint32_t> targetOf; // id of the last witness search that looks for the node
+    uint32_t searchId = 0;
+    std::vector<Shortcut> simulated;
+};
+
+}
+
+void ContractionHierarchy::build(const CsrGraph& graph, const double* arcMinutes, BuildStats* stats) {
+    clear();
+    if (graph.nodeCount() == 0) return;
+
+    std::vector<std::vector<Arc>> upward;
+    size_t shortcuts = 0;
+    Contractor(graph, arcMinutes).run(upward, shortcuts);
+
+    std::vector<uint32_t> arcOffsets(upward.size() + 1, 0);
+    for (size_t node = 0; node < upward.size(); node++) arcOffsets[node + 1] = arcOffsets[node] + upward[node].size();
+    std::vector<Arc> flat;
+    flat.reserve(arcOffsets.back());
+    for (const auto& nodeArcs : upward) flat.insert(flat.end(), nodeArcs.begin(), nodeArcs.end());
+
+    offsets.assign(std::move(arcOffsets));
+    arcs.assign(std::move(flat));
+    buildSweepOrder();
+    if (stats) stats->shortcuts = shortcuts;
+}
+
+void ContractionHierarchy::clear() {
+    offsets.clear();
+    arcs.clear();
+    sweepOrder.clear();
+    sweepLevelStart.clear();
+}
+
+void ContractionHierarchy::attach(FlatArray<uint32_t> arcOffsets, FlatArray<Arc> upwardArcs) {
+    offsets = std::move(arcOffsets);
+    arcs = std::move(upwardArcs);
+    buildSweepOrder();
+}
+
+void ContractionHierarchy::buildSweepOrder() {
+    sweepOrder.clear();
+    sweepLevelStart.clear();
+    if (empty()) return;
+
+    // Kahn's algorithm over the reversed upward arcs, starting from the nodes without any
+    const int nodeCount = static_cast<int>(offsets.size() - 1);
+    std::vector<uint32_t> downStart(nodeCount + 1, 0);
+    for (const Arc& up : arcs) downStart[up.target + 1]++;
+    for (int node = 0; node < nodeCount; node++) downStart[node + 1] += downStart[node];
+    std::vector<int> down(arcs.size());
+    {
+        std::vector<uint32_t> next(downStart.begin(), downStart.end() - 1);
+        for (int node = 0; node < nodeCount; node++) {
+            for (uint32_t arc = offsets[node]; arc < offsets[node + 1]; arc++) down[next[arcs[arc].target]++] = node;
+        }
+    }
+
+    std::vector<uint32_t> pending(nodeCount);
+    sweepOrder.reserve(nodeCount);
+    for (int node = 0; node < nodeCount; node++) {
+        pending[node] = offsets[node + 1] - offsets[node];
+        if (pending[node] == 0) sweepOrder.push_back(node);
+    }
+    sweepLevelStart.push_back(0);
+    for (size_t levelBegin = 0; levelBegin < sweepOrder.size();) {
+        const size_t levelEnd = sweepOrder.size();
+        sweepLevelStart.push_back(static_cast<uint32_t>(levelEnd));
+        for (size_t i = levelBegin; i < levelEnd; i++) {
+            const int node = sweepOrder[i];
+            for (uint32_t j = downStart[node]; j < downStart[node + 1]; j++) {
+                if (--pending[down[j]] == 0) sweepOrder.push_back(down[j]);
+            }
+        }
+        levelBegin = levelEnd;
+    }
+}
+
+bool ContractionHierarchy::search(const std::vector<std::pair<int, double>>& startNodes,
+                                  const std::vector<std::pair<int, double>>& endNodes, QueryWorkspace& workspace,
+                                  PathResult& result) const {
+    SearchLabels& forward = workspace.forward;
+    SearchLabels& backward = workspace.backward;
+
+    TimeQueue pqForward;
+    TimeQueue pqBackward;
+    for (const auto& [node, distance] : startNodes) pqForward.emplace(forward.time(node), node);
+    for (const auto& [node, distance] : endNodes) pqBackward.emplace(backward.time(node), node);
+    QueryStats& stats = result.stats;
+    stats.queuePushes += startNodes.size() + endNodes.size();
+
+    double best = unreached;
+    int meetingNode = -1;
+    // Smallest key still waiting, entries of settled nodes are dropped
+    const auto topKey = [&stats](TimeQueue& pq, const SearchLabels& labels) {
+        while (!pq.empty() && labels.settled(pq.top().second)) {
+            pq.pop();
+            stats.queuePops++;
+        }
+        return pq.empty() ? unreached : pq.top().first;
+    };
+    const auto step = [&](TimeQueue& pq, SearchLabels& labels, const SearchLabels& other) {
+        const int node = pq.top().second;
+        pq.pop();
+        labels.settle(node);
+        stats.queuePops++;
+        stats.settledNodes++;
+        stats.relaxedArcs += offsets[node + 1] - offsets[node];
+
+        const double time = labels.time(node);
+        if (const double total = time + other.time(node); total < best) {
+            best = total;
+            meetingNode = node;
+        }
+        // Stall on demand: reached cheaper through a higher node, so no shortest upward path continues here
+        for (uint32_t arc = offsets[node]; arc < offsets[node + 1]; arc++) {
+            if (labels.time(arcs[arc].target) + arcs[arc].time < time) return;
+        }
+        for (uint32_t arc = offsets[node]; arc < offsets[node + 1]; arc++) {
+            const Arc& up = arcs[arc];
+            if (const double newTime = time + up.time; newTime < labels.time(up.target)) {
+                labels.set(up.target, newTime, labels.dist(node) + up.distance, node);
+                pq.emplace(newTime, up.target);
+                stats.queuePushes++;
+            }
+        }
+    };
+
+    // Each side may stop once its smallest key reaches the best meeting time
+    while (true) {
+        const double forwardKey = topKey(pqForward, forward);
+        const double backwardKey = topKey(pqBackward, backward);
+        if (std::min(forwardKey, backwardKey) >= best) break;
+        if (forwardKey <= backwardKey) {
+            step(pqForward, forward, backward);
+        } else {
+            step(pqBackward, backward, forward);
+        }
+    }
+    if (meetingNode == -1) return false;
+    const auto unpackStart = std::chrono::high_resolution_clock::now();
+
+    // Upward chains from the meeting node back to a seed on either side
+    std::vector<int> up;
+    for (int at = meetingNode; at != -1; at = forward.prev(at)) up.push_back(at);
+    std::reverse(up.begin(), up.end());
+    std::vector<int> down;
+    for (int at = meetingNode; at != -1; at = backward.prev(at)) down.push_back(at);
+
+    double time = forward.time(up.front());
+    double roadDistance = 0;
+    result.path.assign(1, up.front());
+    for (size_t i = 1; i < up.size(); i++) {
+        unpack(up[i - 1], up[i], findArc(up[i - 1], up[i]), result.path, time, roadDistance);
+    }
+    for (size_t i = 1; i < down.size(); i++) {
+        unpack(down[i - 1], down[i], findArc(down[i], down[i - 1]), result.path, time, roadDistance);
+    }
+    time += backward.time(down.back());
+
+    result.travelTime = time;
+    result.walkingDistance = forward.dist(up.front()) + backward.dist(down.back());
+    result.totalDistance = result.walkingDistance + roadDistance;
+    result.vehicleDistance = std::round((result.totalDistance - result.walkingDistance) * 100) / 100;
+    stats.pathMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - unpackStart).count();
+    return true;
+}
+
+void ContractionHierarchy::upwardSearch(const std::vector<std::pair<int, double>>& seeds, SearchLabels& labels,
+                                        std::vector<int>& reached) const {
+    reached.clear();
+    TimeQueue queue;
+    for (const auto& [node, distance] : seeds) queue.emplace(labels.time(node), node);
+    while (!queue.empty()) {
+        const int node = queue.top().second;
+        queue.pop();
+        if (labels.settled(node)) continue;
+        labels.settle(node);
+
+        const double time = labels.time(node);
+        bool stalled = false;
+        for (uint32_t arc = offsets[node]; arc < offsets[node + 1] && !stalled; arc++) {
+            stalled = labels.time(arcs[arc].target) + arcs[arc].time < time;
+        }
+        if (stalled) continue;
+        reached.push_back(node);
+        for (uint32_t arc = offsets[node]; arc < offsets[node + 1]; arc++) {
+            const Arc& up = arcs[arc];
+            if (const double newTime = time + up.time; newTime < labels.time(up.target)) {
+                labels.set(up.target, newTime, labels.dist(node) + up.distance, node);
+                queue.emplace(newTime, up.target);
+            }
+        }
+    }
+}
+
+void ContractionHierarchy::downwardSweep(SearchLabels& labels, ThreadPool& pool) const {
+    // Every upward arc of a node leads to an earlier level, whose labels are final by now
+    const auto sweep = [&](const size_t begin, const size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const int node = sweepOrder[i];
+            double time = labels.time(node);
+            int via = -1;
+            for (uint32_t arc = offsets[node]; arc < offsets[node + 1]; arc++) {
+                if (const double newTime = labels.time(arcs[arc].target) + arcs[arc].time; newTime < time) {
+                    time = newTime;
+                    via = static_cast<int>(arc);
+                }
+            }
+            if (via != -1) labels.set(node, time, labels.dist(arcs[via].target) + arcs[via].distance, arcs[via].target);
+        }
+    };
+    for (size_t level = 0; level + 1 < sweepLevelStart.size(); level++) {
+        const size_t begin = sweepLevelStart[level];
+        const size_t end = sweepLevelStart[level + 1];
+        if (end - begin < parallelSweepLevel) {
+            sweep(begin, end);
+        } else {
+            pool.parallelFor(end - begin, parallelSweepLevel / 4, [&](const size_t from, const size_t to, unsigned) {
+                sweep(begin + from, begin + to);
+            });
+        }
+    }
+}
+
+const ContractionHierarchy::Arc& ContractionHierarchy::findArc(const int from, const int to) const {
+    uint32_t arc = offsets[from];
+    while (arcs[arc].target != to) arc++;
+    return arcs[arc];
+}
+
+void ContractionHierarchy::unpack(const int from, const int to, const Arc& arc, std::vector<int>& path, double& time,
+                                  double& distance) const {
+    if (arc.middle < 0) {
+        path.push_back(to);
+        time += arc.time;
+        distance += arc.distance;
+        return;
+    }
+    // Both halves are arcs of the bypassed node, which was contracted before either end
+    unpack(from, arc.middle, findArc(arc.middle, from), path, time, distance);
+    unpack(arc.middle, to, findArc(arc.middle, to), path, time, distance);
+}
@@ -0,0 +1,72 @@
+#ifndef CONTRACTIONHIERARCHY_H
+#define CONTRACTIONHIERARCHY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "csrgraph.h"
+#include "flatarray.h"
+#include "queryworkspace.h"
+
+struct PathResult;
+class ThreadPool;
+
+// Contraction Hierarchy over the road graph. Nodes are contracted one by one in
+// edge difference order; a shortcut replaces u - v - w whenever no witness path
+// avoiding v is as short. Every node keeps the arcs to the nodes contracted
+// after it, so a query only searches upward from both ends.
+class ContractionHierarchy {
+public:
+    // Upward arc, shortcuts remember the node they bypass for unpacking
+    struct Arc {
+        int target;
+        int middle; // -1 for a road
+        double time;
+        double distance;
+    };
+
+    struct BuildStats {
+        size_t shortcuts = 0;
+    };
+
+    // arcMinutes holds the weight of every CSR arc of graph
+    void build(const CsrGraph& graph, const double* arcMinutes, BuildStats* stats = nullptr);
+    void clear();
+    [[nodiscard]] bool empty() const { return offsets.empty(); }
+
+    // Raw arrays for snapshot files, attach() views them without copying
+    [[nodiscard]] const FlatArray<uint32_t>& arcOffsets() const { return offsets; }
+    [[nodiscard]] const FlatArray<Arc>& upwardArcs() const { return arcs; }
+    void attach(FlatArray<uint32_t> arcOffsets, FlatArray<Arc> upwardArcs);
+
+    // Upward search from the seeds already labelled in workspace (walking time and
+    // distance). Fills path, travel time and the distances of result, false if the
+    // two sides never meet.
+    bool search(const std::vector<std::pair<int, double>>& startNodes, const std::vector<std::pair<int, double>>& endNodes,
+                QueryWorkspace& workspace, PathResult& result) const;
+    // Whole upward search space of the seeds already labelled in labels. reached receives the
+    // settled nodes that were not stalled, their labels hold time and distance from the seeds.
+    // The buckets of a many-to-many search are built from these.
+    void upwardSearch(const std::vector<std::pair<int, double>>& seeds, SearchLabels& labels, std::vector<int>& reached) const;
+    // PHAST downward pass after upwardSearch: lowers every label of labels to the shortest
+    // time from the seeds. Nodes are visited top down, one sweep level at a time; a level has
+    // no arcs inside it, so large levels are split across pool.
+    void downwardSweep(SearchLabels& labels, ThreadPool& pool) const;
+
+private:
+    [[nodiscard]] const Arc& findArc(int from, int to) const;
+    // Appends the road nodes after from up to to, adding their times and distances
+    void unpack(int from, int to, const Arc& arc, std::vector<int>& path, double& time, double& distance) const;
+
+    FlatArray<uint32_t> offsets; // nodeCount + 1 entries into arcs
+    FlatArray<Arc> arcs;
+
+    // Nodes ordered so that the targets of a node's upward arcs come before it, grouped in
+    // levels by the longest upward chain; rebuilt by build() and attach()
+    void buildSweepOrder();
+    std::vector<int> sweepOrder;
+    std::vector<uint32_t> sweepLevelStart; // level count + 1 entries into sweepOrder
+};
+
+#endif // CONTRACTIONHIERARCHY_H
@@ -0,0 +1,45 @@
+#include "csrgraph.h"
+
+void CsrGraph::clear() {
+    offsets.clear();
+    targets.clear();
+    distance.clear();
+    speed.clear();
+    travelTime.clear();
+}
+
+CsrGraph CsrGraph::build(std::vector<uint32_t> rowOffsets, const std::vector<std::pair<int, int>>& edges,
+                         const std::vector<double>& edgeDistance, const std::vector<double>& edgeSpeed) {
+    // Shift the degrees into row starts: rowOffsets[v + 1] becomes the first arc of v
+    const size_t nodeCount = rowOffsets.size() - 1;
+    uint32_t arcs = 0;
+    for (size_t v = 1; v <= nodeCount; v++) arcs += std::exchange(rowOffsets[v], arcs);
+
+    // Scatter both directions of every edge. Each write advances the row's cursor,
+    // so afterwards rowOffsets[v + 1] is the end of v and the offsets are final
+    std::vector<int> arcTargets(arcs);
+    std::vector<double> arcDistance(arcs), arcSpeed(arcs), arcTime(arcs);
+    for (size_t i = 0; i < edges.size(); i++) {
+        const auto [source, destination] = edges[i];
+        const double minutes = travelMinutes(edgeDistance[i], edgeSpeed[i]);
+        uint32_t arc = rowOffsets[source + 1]++;
+        arcTargets[arc] = destination;
+        arcDistance[arc] = edgeDistance[i];
+        arcSpeed[arc] = edgeSpeed[i];
+        arcTime[arc] = minutes;
+
+        arc = rowOffsets[destination + 1]++;
+        arcTargets[arc] = source;
+        arcDistance[arc] = edgeDistance[i];
+        arcSpeed[arc] = edgeSpeed[i];
+        arcTime[arc] = minutes;
+    }
+
+    CsrGraph graph;
+    graph.offsets.assign(std::move(rowOffsets));
+    graph.targets.assign(std::move(arcTargets));
+    graph.distance.assign(std::move(arcDistance));
+    graph.speed.assign(std::move(arcSpeed));
+    graph.travelTime.assign(std::move(arcTime));
+    return graph;
+}
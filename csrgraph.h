@@ -0,0 +1,43 @@
+#ifndef CSRGRAPH_H
+#define CSRGRAPH_H
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "flatarray.h"
+
+// Undirected road graph in compressed sparse row form. Every edge is stored
+// as two directed arcs; the arcs leaving node v are [offsets[v], offsets[v+1]).
+// Per-arc attributes live in parallel arrays so the search streams through
+// exactly the columns it needs.
+struct CsrGraph {
+    FlatArray<uint32_t> offsets; // nodeCount + 1 entries
+    FlatArray<int> targets;
+    FlatArray<double> distance;   // km
+    FlatArray<double> speed;      // km/h
+    FlatArray<double> travelTime; // minutes, distance / speed precomputed at load
+
+    [[nodiscard]] size_t nodeCount() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+    [[nodiscard]] size_t arcCount() const { return targets.size(); }
+    [[nodiscard]] uint32_t firstArc(const int node) const { return offsets[node]; }
+    [[nodiscard]] uint32_t lastArc(const int node) const { return offsets[node + 1]; }
+    // Node the arc leaves, a binary search over the offsets
+    [[nodiscard]] int arcTail(const uint32_t arc) const {
+        return static_cast<int>(std::upper_bound(offsets.begin(), offsets.end(), arc) - offsets.begin()) - 1;
+    }
+
+    void clear();
+
+    // Travel time in minutes along an edge, the search weight
+    static double travelMinutes(const double distance, const double speed) { return (distance / speed) * 60; }
+
+    // Counting build from degrees the caller tallied while reading the edges
+    // (degree of v in rowOffsets[v + 1], the rest zero). Arcs of a node keep the
+    // file order of their edges, which is the order the old per-node vectors
+    // were filled in.
+    static CsrGraph build(std::vector<uint32_t> rowOffsets, const std::vector<std::pair<int, int>>& edges,
+                          const std::vector<double>& edgeDistance, const std::vector<double>& edgeSpeed);
+};
+
+#endif // CSRGRAPH_H
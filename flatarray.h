@@ -0,0 +1,69 @@
+#ifndef FLATARRAY_H
+#define FLATARRAY_H
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Contiguous read-only array that either owns its elements or views memory
+// owned by someone else (e.g. a mapped snapshot file), so graph data can be
+// used in place without copying it into a std::vector first. Copies share the
+// owned elements, which never change once assigned, so copying is O(1).
+template <typename T>
+class FlatArray {
+public:
+    FlatArray() = default;
+    FlatArray(std::vector<T> values) { assign(std::move(values)); }
+
+    FlatArray(const FlatArray& other) = default;
+    FlatArray(FlatArray&& other) noexcept { *this = std::move(other); }
+    FlatArray& operator=(const FlatArray& other) = default;
+    FlatArray& operator=(FlatArray&& other) noexcept {
+        owned = std::move(other.owned);
+        items = other.items;
+        count = other.count;
+        other.items = nullptr;
+        other.count = 0;
+        return *this;
+    }
+
+    void assign(std::vector<T> values) {
+        auto storage = std::make_shared<const std::vector<T>>(std::move(values));
+        items = storage->data();
+        count = storage->size();
+        owned = std::move(storage);
+    }
+    // The viewed memory must outlive this array
+    void view(const T* data, const size_t size) {
+        owned.reset();
+        items = data;
+        count = size;
+    }
+    void clear() { view(nullptr, 0); }
+
+    [[nodiscard]] bool ownsData() const { return owned != nullptr; }
+    [[nodiscard]] const T* data() const { return items; }
+    [[nodiscard]] size_t size() const { return count; }
+    [[nodiscard]] bool empty() const { return count == 0; }
+    const T& operator[](const size_t i) const { return items[i]; }
+    [[nodiscard]] const T* begin() const { return items; }
+    [[nodiscard]] const T* end() const { return items + count; }
+    [[nodiscard]] const T& back() const { return items[count - 1]; }
+
+    bool operator==(const std::vector<T>& other) const {
+        if (count != other.size()) return false;
+        for (size_t i = 0; i < count; i++) {
+            if (!(items[i] == other[i])) return false;
+        }
+        return true;
+    }
+    bool operator!=(const std::vector<T>& other) const { return !(*this == other); }
+
+private:
+    std::shared_ptr<const std::vector<T>> owned;
+    const T* items = nullptr;
+    size_t count = 0;
+};
+
+#endif // FLATARRAY_H
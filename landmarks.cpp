@@ -0,0 +1,229 @@
+#include "landmarks.h"
+#include <functional>
+#include <queue>
+#include <random>
+
+#include "threadpool.h"
+
+namespace {
+
+using TimeQueue = std::priority_queue<std::pair<double, int>, std::vector<std::pair<double, int>>, std::greater<>>;
+
+// Dijkstra from source that only lowers entries of times, so a table already
+// holding the distance to other sources is updated in the region source wins.
+// Fill times with infinity for a plain one-to-all search.
+void growTree(const CsrGraph& graph, const double* arcMinutes, const int source, std::vector<double>& times,
+              std::vector<int>* parent = nullptr, std::vector<int>* order = nullptr) {
+    TimeQueue queue;
+    times[source] = 0;
+    if (parent) (*parent)[source] = -1;
+    queue.emplace(0.0, source);
+    while (!queue.empty()) {
+        const auto [time, node] = queue.top();
+        queue.pop();
+        if (time > times[node]) continue;
+        if (order) order->push_back(node);
+        for (uint32_t arc = graph.firstArc(node); arc < graph.lastArc(node); arc++) {
+            const int neighbor = graph.targets[arc];
+            if (const double newTime = time + arcMinutes[arc]; newTime < times[neighbor]) {
+                times[neighbor] = newTime;
+                if (parent) (*parent)[neighbor] = node;
+                queue.emplace(newTime, neighbor);
+            }
+        }
+    }
+}
+
+// Node with the largest finite entry, -1 if none is positive
+int farthestNode(const std::vector<double>& times) {
+    int best = -1;
+    for (int node = 0; node < static_cast<int>(times.size()); node++) {
+        if (times[node] != std::numeric_limits<double>::infinity() && times[node] > 0 &&
+            (best == -1 || times[node] > times[best])) {
+            best = node;
+        }
+    }
+    return best;
+}
+
+std::vector<int> selectFarthest(const CsrGraph& graph, const double* arcMinutes, const unsigned count) {
+    const size_t nodeCount = graph.nodeCount();
+    std::vector<double> nearest(nodeCount, std::numeric_limits<double>::infinity());
+
+    // The first landmark is the far end of the graph as seen from node 0
+    growTree(graph, arcMinutes, 0, nearest);
+    int next = farthestNode(nearest);
+    std::fill(nearest.begin(), nearest.end(), std::numeric_limits<double>::infinity());
+
+    std::vector<int> chosen;
+    while (chosen.size() < count && next != -1) {
+        chosen.push_back(next);
+        // Only the region closer to the new landmark than to the others is searched
+        growTree(graph, arcMinutes, next, nearest);
+        next = farthestNode(nearest);
+    }
+    return chosen;
+}
+
+// Goldberg and Werneck's avoid heuristic: in a shortest path tree from a random
+// root, weigh every node by how much the current landmarks underestimate its
+// distance, then walk from the root down the heaviest child subtrees without a
+// landmark. The leaf reached becomes the next landmark.
+std::vector<int> selectAvoid(const CsrGraph& graph, const double* arcMinutes, const unsigned count,
+                             std::vector<std::vector<double>>& rows) {
+    const int nodeCount = static_cast<int>(graph.nodeCount());
+    std::mt19937 random(12345); // fixed, the same map always gets the same landmarks
+    std::uniform_int_distribution<int> anyNode(0, nodeCount - 1);
+
+    std::vector<int> chosen;
+    std::vector<char> isLandmark(nodeCount, 0);
+    std::vector<double> rootTimes(nodeCount), size(nodeCount);
+    std::vector<int> parent(nodeCount), order, childStart(nodeCount + 1), children(nodeCount);
+    std::vector<char> covered(nodeCount);
+    for (unsigned attempt = 0; chosen.size() < count && attempt < 4 * count; attempt++) {
+        const int root = anyNode(random);
+        std::fill(rootTimes.begin(), rootTimes.end(), std::numeric_limits<double>::infinity());
+        order.clear();
+        growTree(graph, arcMinutes, root, rootTimes, &parent, &order);
+
+        // Subtree sizes bottom up, a subtree holding a landmark weighs nothing
+        std::fill(size.begin(), size.end(), 0.0);
+        std::fill(covered.begin(), covered.end(), 0);
+        for (auto it = order.rbegin(); it != order.rend(); ++it) {
+            const int node = *it;
+            double bound = 0;
+            for (const auto& row : rows) {
+                if (row[root] != std::numeric_limits<double>::infinity() && row[node] != std::numeric_limits<double>::infinity()) {
+                    bound = std::max(bound, std::abs(row[root] - row[node]));
+                }
+            }
+            covered[node] |= isLandmark[node];
+            size[node] = covered[node] ? 0 : size[node] + rootTimes[node] - bound;
+            if (parent[node] != -1) {
+                size[parent[node]] += size[node];
+                covered[parent[node]] |= covered[node];
+            }
+        }
+
+        // Children of every tree node, CSR style
+        std::fill(childStart.begin(), childStart.end(), 0);
+        for (const int node : order) {
+            if (parent[node] != -1) childStart[parent[node] + 1]++;
+        }
+        for (int node = 0; node < nodeCount; node++) childStart[node + 1] += childStart[node];
+        std::vector<int> next(childStart.begin(), childStart.end() - 1);
+        for (const int node : order) {
+            if (parent[node] != -1) children[next[parent[node]]++] = node;
+        }
+
+        int leaf = root;
+        for (bool descended = true; descended;) {
+            descended = false;
+            int best = -1;
+            for (int i = childStart[leaf]; i < childStart[leaf + 1]; i++) {
+                if (size[children[i]] > 0 && (best == -1 || size[children[i]] > size[best])) best = children[i];
+            }
+            if (best != -1) {
+                leaf = best;
+                descended = true;
+            }
+        }
+        // The root's tree holds every landmark of its component, only a strict descent counts
+        if (leaf == root) continue;
+
+        isLandmark[leaf] = 1;
+        chosen.push_back(leaf);
+        // The next round needs this landmark's bounds, so its row is computed here
+        rows.emplace_back(nodeCount, std::numeric_limits<double>::infinity());
+        growTree(graph, arcMinutes, leaf, rows.back());
+    }
+    return chosen;
+}
+
+}
+
+void Landmarks::build(const CsrGraph& graph, const double* arcMinutes, const unsigned count,
+                      const LandmarkSelection selection, ThreadPool& pool) {
+    clear();
+    const size_t nodeCount = graph.nodeCount();
+    if (nodeCount == 0 || count == 0) return;
+
+    std::vector<std::vector<double>> rows;
+    const std::vector<int> chosen = selection == LandmarkSelection::Avoid ? selectAvoid(graph, arcMinutes, count, rows)
+                                                                          : selectFarthest(graph, arcMinutes, count);
+
+    // One independent Dijkstra per landmark whose row the selection did not produce
+    const size_t known = rows.size();
+    rows.resize(chosen.size());
+    pool.parallelFor(chosen.size() - known, 1, [&](const size_t begin, const size_t end, unsigned) {
+        for (size_t i = known + begin; i < known + end; i++) {
+            rows[i].assign(nodeCount, unreachable);
+            growTree(graph, arcMinutes, chosen[i], rows[i]);
+        }
+    });
+
+    const size_t k = chosen.size();
+    std::vector<double> table(nodeCount * k);
+    for (size_t node = 0; node < nodeCount; node++) {
+        for (size_t i = 0; i < k; i++) table[node * k + i] = rows[i][node];
+    }
+    landmarkNodes.assign(std::vector<int>(chosen));
+    times.assign(std::move(table));
+}
+
+unsigned Landmarks::refresh(const CsrGraph& graph, const double* arcMinutes, const std::vector<uint32_t>& arcs,
+                            ThreadPool& pool) {
+    const size_t k = landmarkNodes.size();
+    std::vector<size_t> broken;
+    for (size_t i = 0; i < k; i++) {
+        for (const uint32_t arc : arcs) {
+            const double tail = times[static_cast<size_t>(graph.arcTail(arc)) * k + i];
+            const double head = times[static_cast<size_t>(graph.targets[arc]) * k + i];
+            if (tail != unreachable && head != unreachable && std::abs(head - tail) > arcMinutes[arc]) {
+                broken.push_back(i);
+                break;
+            }
+        }
+    }
+    if (broken.empty()) return 0;
+
+    const size_t nodeCount = graph.nodeCount();
+    std::vector<std::vector<double>> rows(broken.size());
+    pool.parallelFor(broken.size(), 1, [&](const size_t begin, const size_t end, unsigned) {
+        for (size_t j = begin; j < end; j++) {
+            rows[j].assign(nodeCount, unreachable);
+            growTree(graph, arcMinutes, landmarkNodes[broken[j]], rows[j]);
+        }
+    });
+    // Copies of the table may still be read, so the new rows go into a new one
+    std::vector<double> table(times.begin(), times.end());
+    for (size_t node = 0; node < nodeCount; node++) {
+        for (size_t j = 0; j < broken.size(); j++) table[node * k + broken[j]] = rows[j][node];
+    }
+    times.assign(std::move(table));
+    return static_cast<unsigned>(broken.size());
+}
+
+void Landmarks::clear() {
+    landmarkNodes.clear();
+    times.clear();
+}
+
+void Landmarks::attach(FlatArray<int> nodes, FlatArray<double> table) {
+    landmarkNodes = std::move(nodes);
+    times = std::move(table);
+}
+
+void Landmarks::boundSeeds(const std::vector<std::pair<int, double>>& seeds, SeedBounds& bounds) const {
+    const size_t k = landmarkNodes.size();
+    bounds.nearest.assign(k, unreachable);
+    bounds.farthest.assign(k, -unreachable);
+    for (const auto& [node, cost] : seeds) {
+        const double* row = times.data() + static_cast<size_t>(node) * k;
+        for (size_t i = 0; i < k; i++) {
+            if (row[i] == unreachable) continue;
+            bounds.nearest[i] = std::min(bounds.nearest[i], row[i] + cost);
+            bounds.farthest[i] = std::max(bounds.farthest[i], row[i] - cost);
+        }
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef LANDMARKS_H
+#define LANDMARKS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+#include "csrgraph.h"
+#include "flatarray.h"
+
+class ThreadPool;
+
+enum class LandmarkSelection : uint32_t {
+    Farthest = 0, // each landmark as far as possible from the ones before
+    Avoid = 1,    // grow into the parts of a shortest path tree the others cover worst
+};
+
+// Travel times from a few landmark nodes to every node, the lower bounds of the
+// ALT search (A*, landmarks, triangle inequality). The table is node major, so
+// the bounds of one node are a single contiguous row.
+class Landmarks {
+public:
+    // Per landmark summary of a seed set (node, cost to enter), see lowerBound
+    struct SeedBounds {
+        std::vector<double> nearest;  // min over seeds of landmark time + cost
+        std::vector<double> farthest; // max over seeds of landmark time - cost
+    };
+
+    // Picks count landmarks and fills the table with one Dijkstra per landmark on the pool.
+    // arcMinutes holds the weight of every CSR arc.
+    void build(const CsrGraph& graph, const double* arcMinutes, unsigned count, LandmarkSelection selection,
+               ThreadPool& pool);
+    // After the weights of arcs dropped, recomputes the rows of the landmarks whose bounds
+    // they break (|time(head) - time(tail)| above the new weight); the others stay valid
+    // lower bounds. Returns the number of landmarks recomputed.
+    unsigned refresh(const CsrGraph& graph, const double* arcMinutes, const std::vector<uint32_t>& arcs, ThreadPool& pool);
+    void clear();
+    [[nodiscard]] bool empty() const { return landmarkNodes.empty(); }
+    [[nodiscard]] unsigned count() const { return static_cast<unsigned>(landmarkNodes.size()); }
+
+    // Raw arrays for snapshot files, attach() views them without copying
+    [[nodiscard]] const FlatArray<int>& nodes() const { return landmarkNodes; }
+    [[nodiscard]] const FlatArray<double>& table() const { return times; }
+    void attach(FlatArray<int> nodes, FlatArray<double> table);
+
+    void boundSeeds(const std::vector<std::pair<int, double>>& seeds, SeedBounds& bounds) const;
+
+    // Lower bound on the cheapest way from node into the seed set, seed cost included.
+    // Consistent along every arc, landmarks that cannot reach either side are skipped.
+    [[nodiscard]] double lowerBound(const int node, const SeedBounds& bounds) const {
+        const size_t k = landmarkNodes.size();
+        const double* row = times.data() + static_cast<size_t>(node) * k;
+        double bound = 0;
+        for (size_t i = 0; i < k; i++) {
+            if (row[i] == unreachable || bounds.nearest[i] == unreachable) continue;
+            bound = std::max(bound, std::max(bounds.nearest[i] - row[i], row[i] - bounds.farthest[i]));
+        }
+        return bound;
+    }
+
+private:
+    static constexpr double unreachable = std::numeric_limits<double>::infinity();
+
+    FlatArray<int> landmarkNodes;
+    FlatArray<double> times; // times[node * count + i] = minutes between landmark i and node
+};
+
+#endif // LANDMARKS_H
@@ -17,6 +17,23 @@
 #include <QPushButton>
 #include <QStyle>
 
+namespace {
+
+// One line on where the time of a query went
+QString describeStats(const QueryStats& stats) {
+    return "Candidates: " + QString::number(stats.startCandidates) + " + " + QString::number(stats.endCandidates) +
+           ", settled nodes: " + QString::number(stats.settledNodes) + ", relaxed arcs: " + QString::number(stats.relaxedArcs) +
+           "\nSnap " + QString::number(stats.snapMs, 'f', 3) + " ms, search " + QString::number(stats.searchMs, 'f', 3) +
+           " ms, path " + QString::number(stats.pathMs, 'f', 3) + " ms";
+}
+
+QString describePercentiles(const char* name, const Percentiles& values, const int decimals) {
+    return QString(name) + " p50/p95/p99: " + QString::number(values.p50, 'f', decimals) + " / " +
+           QString::number(values.p95, 'f', decimals) + " / " + QString::number(values.p99, 'f', decimals);
+}
+
+}
+
 bool MainWindow::isSelectionEnabled = false;
 
 MainWindow::MainWindow(QWidget *parent)
@@ -154,8 +171,7 @@ void MainWindow::setupUi()
         if (currentQueryIndex > 0 && !queryList.empty()) {
             currentQueryIndex--;
             const Query query = queryList[currentQueryIndex];
-            const QString resultText = QString::fromStdString(MapGraph::instance().findShortestPath(query.startX, query.startY,
-                                                                                                    query.endX, query.endY, query.R).resultText);
+            const QString resultText = QString::fromStdString(showPath(query.startX, query.startY, query.endX, query.endY, query.R).resultText);
             displayQuery(query, resultText);
         }
     });
@@ -164,8 +180,7 @@ void MainWindow::setupUi()
         if (currentQueryIndex < queryList.size() - 1 && !queryList.empty()) {
             currentQueryIndex++;
             const Query query = queryList[currentQueryIndex];
-            const QString resultText = QString::fromStdString(MapGraph::instance().findShortestPath(query.startX, query.startY,
-                                                                                                    query.endX, query.endY, query.R).resultText);
+            const QString resultText = QString::fromStdString(showPath(query.startX, query.startY, query.endX, query.endY, query.R).resultText);
             displayQuery(query, resultText);
         }
     });
@@ -176,7 +191,7 @@ void MainWindow::setupUi()
         if (const int newIndex = queryIndexEdit->text().toInt(&ok) - 1; ok && newIndex >= 0 && newIndex < queryList.size()) {
             currentQueryIndex = newIndex;
             const Query query = queryList[currentQueryIndex];
-            const QString resultText = QString::fromStdString(MapGraph::instance().findShortestPath(query.startX, query.startY, query.endX, query.endY, query.R).resultText);
+            const QString resultText = QString::fromStdString(showPath(query.startX, query.startY, query.endX, query.endY, query.R).resultText);
             displayQuery(query, resultText);
         } else {
             queryIndexEdit->setText(QString::number(currentQueryIndex + 1)); // Reset to current index if invalid
@@ -265,6 +280,7 @@ void MainWindow::setupUi()
 
 void MainWindow::loadMapFile()
 {
+    if (mapLoading) return;
     timeInMap = 0;
     const QString filePath = QFileDialog::getOpenFileName(this, "Open Map File", "", "Text Files (*.txt)");
     if (filePath.isEmpty()) {
@@ -274,30 +290,41 @@ void MainWindow::loadMapFile()
     mapPathLabel->setText(mapFilePath);
 
     showLoading("Loading map... Please wait");
+    mapLoading = true;
 
+    // Parsing and preprocessing run on a worker so the window keeps painting, the
+    // new map is swapped in there and the view is updated back on the GUI thread
     const auto startInMap = std::chrono::high_resolution_clock::now();
-    if (MapGraph::instance().loadMapFromFile(mapFilePath.toStdString())) {
-        MapVisualizer::instance()->setMapGraph();
-
-        // === NEW: Reset map view and UI ===
-        MapVisualizer::instance()->reset();
-        handleResetAll();  // Also resets UI fields
-
-        // === NEW: Clear queries path info ===
-        queriesFilePath.clear();
-        queriesPathLabel->setText("No queries file selected");
+    auto* watcher = new QFutureWatcher<bool>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, startInMap] {
+        watcher->deleteLater();
+        mapLoading = false;
+        if (watcher->result()) {
+            MapVisualizer::instance()->setMapGraph();
+
+            // === NEW: Reset map view and UI ===
+            MapVisualizer::instance()->reset();
+            handleResetAll();  // Also resets UI fields
+
+            // === NEW: Clear queries path info ===
+            queriesFilePath.clear();
+            queriesPathLabel->setText("No queries file selected");
+
+            displayResult("Map file loaded successfully.");
+        } else {
+            displayResult("Error loading map file.");
+            hideLoading();
+            return;
+        }
+        const auto endInMap = std::chrono::high_resolution_clock::now();
+        timeInMap = std::chrono::duration_cast<std::chrono::milliseconds>(endInMap - startInMap).count();
 
-        displayResult("Map file loaded successfully.");
-    } else {
-        displayResult("Error loading map file.");
+        pathFindingTextEdit(MapGraph::instance().empty());
         hideLoading();
-        return;
-    }
-    const auto endInMap = std::chrono::high_resolution_clock::now();
-    timeInMap = std::chrono::duration_cast<std::chrono::milliseconds>(endInMap - startInMap).count();
-
-    pathFindingTextEdit(MapGraph::instance().empty());
-    hideLoading();
+    });
+    watcher->setFuture(QtConcurrent::run([path = mapFilePath.toStdString()] {
+        return MapGraph::instance().loadMapFromFile(path);
+    }));
 }
 
 void MainWindow::loadQueriesFile()
@@ -337,7 +364,7 @@ void MainWindow::loadQueriesFile()
     queryIndexEdit->setDisabled(false);
     currentQueryIndex = 0;
     const Query query = queryList[currentQueryIndex];
-    const QString resultText = QString::fromStdString(MapGraph::instance().findShortestPath(query.startX, query.startY, query.endX, query.endY, query.R).resultText);
+    const QString resultText = QString::fromStdString(showPath(query.startX, query.startY, query.endX, query.endY, query.R).resultText);
     displayQuery(query, resultText);
 
     const auto endInQuery = std::chrono::high_resolution_clock::now();
@@ -364,13 +391,14 @@ void MainWindow::findShortestPath() const {
     const double R = REdit->text().toDouble();
 
     const auto start = std::chrono::high_resolution_clock::now();
-    const PathResult pathResult = MapGraph::instance().findShortestPath(startX, startY, endX, endY, R);
+    const PathResult pathResult = showPath(startX, startY, endX, endY, R);
     const auto end = std::chrono::high_resolution_clock::now();
 
     const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
 
     QString result = QString::fromStdString(pathResult.resultText);
     result += "\nComputation time: " + QString::number(duration) + " ms";
+    result += "\n" + describeStats(pathResult.stats);
 
     displayResult(result);
 
@@ -381,13 +409,14 @@ void MainWindow::onPointsSelected(const double startX, const double startY, cons
     const double R = REdit->text().toDouble();
 
     const auto start = std::chrono::high_resolution_clock::now();
-    const PathResult pathResult = MapGraph::instance().findShortestPath(startX, startY, endX, endY, R);
+    const PathResult pathResult = showPath(startX, startY, endX, endY, R);
     const auto end = std::chrono::high_resolution_clock::now();
 
     const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
     
     QString result = QString::fromStdString(pathResult.resultText);
     result += "\nComputation time: " + QString::number(duration) + " ms";
+    result += "\n" + describeStats(pathResult.stats);
     pathFindingTextUpdate(startX, startY, endX, endY, R);
     displayResult(result);
     MapVisualizer::instance()->update();
@@ -450,41 +479,55 @@ void MainWindow::runAllQueries()
     connect(&progressDialog, &QProgressDialog::canceled, [&]{ cancel = true; });
 
     const auto future = QtConcurrent::run([this, &cancel, &progressDialog] {
-        std::vector<PathResult> localResults;
-        localResults.reserve(queryList.size());
-        const auto startAll = std::chrono::high_resolution_clock::now();
-        for (size_t i = 0; i < queryList.size(); ++i) {
-            if (cancel.load()) break;
-            const auto &[startX, startY, endX, endY, R] = queryList[i];
-            localResults.push_back(MapGraph::instance().findShortestPath(startX, startY, endX, endY, R));
-            QMetaObject::invokeMethod(&progressDialog, [this, &progressDialog, i] {
+        BatchOptions options;
+        options.cancel = &cancel;
+        options.onProgress = [this, &progressDialog](const size_t completed) {
+            QMetaObject::invokeMethod(&progressDialog, [this, &progressDialog, completed] {
                 progressDialog.setRange(0, static_cast<int>(queryList.size()));
-                progressDialog.setValue(static_cast<int>(i + 1));
-                progressDialog.setLabelText(QString("Processing %1 / %2 ...").arg(static_cast<int>(i + 1)).arg(static_cast<int>(queryList.size())));
+                progressDialog.setValue(static_cast<int>(completed));
+                progressDialog.setLabelText(QString("Processing %1 / %2 ...").arg(static_cast<int>(completed)).arg(static_cast<int>(queryList.size())));
             }, Qt::QueuedConnection);
-        }
-        const auto endAll = std::chrono::high_resolution_clock::now();
-        long long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(endAll - startAll).count();
-        return std::make_pair(elapsed, std::move(localResults));
+        };
+        BatchStats stats;
+        auto localResults = MapGraph::instance().runQueries(queryList, options, &stats);
+        return std::make_pair(stats, std::move(localResults));
     });
 
-    QFutureWatcher<std::pair<long long, std::vector<PathResult>>> watcher;
+    QFutureWatcher<std::pair<BatchStats, std::vector<PathResult>>> watcher;
     connect(&watcher, &QFutureWatcherBase::progressValueChanged, &progressDialog, &QProgressDialog::setValue);
     connect(&watcher, &QFutureWatcherBase::progressRangeChanged, &progressDialog, &QProgressDialog::setRange);
     connect(&watcher, &QFutureWatcherBase::finished, this, [this, &progressDialog, &watcher] {
-        auto [fst, snd] = watcher.result();
-        timeBase = fst;
-        const auto results = std::move(snd);
+        auto [stats, snd] = watcher.result();
+        timeBase = static_cast<long long>(stats.elapsedMs);
+
+        // A cancelled batch leaves the queries it did not reach unanswered, only the others are kept
+        std::vector<PathResult> results;
+        size_t lastAnswered = 0;
+        for (size_t i = 0; i < snd.size(); i++) {
+            if (snd[i].resultText.empty()) continue;
+            results.push_back(std::move(snd[i]));
+            lastAnswered = i;
+        }
+        if (results.empty()) {
+            progressDialog.close();
+            displayResult("Cancelled before any query was answered.");
+            return;
+        }
 
         saveResults("Output/outputs.txt", results);
 
         QString resultText;
-        resultText += "Executed " + QString::number(results.size()) + " queries in " + 
-                      QString::number(timeBase) + " ms\nExecution time + I/O: " +
-                      QString::number(timeInMap + timeInQuery + timeBase + timeOut) + " ms\n\n";
+        resultText += "Executed " + QString::number(results.size()) + " queries in " +
+                      QString::number(timeBase) + " ms on " + QString::number(stats.threads) + " threads (" +
+                      QString::number(stats.queriesPerSecond, 'f', 0) + " queries/s)\nExecution time + I/O: " +
+                      QString::number(timeInMap + timeInQuery + timeBase + timeOut) + " ms\n";
+        resultText += describePercentiles("Query ms", stats.totalMs, 3) + "\n" +
+                      describePercentiles("Candidates", stats.candidates, 0) + "\n" +
+                      describePercentiles("Settled nodes", stats.settledNodes, 0) + "\n\n";
         resultText += QString::fromStdString(MapGraph::instance().displayOutput(results));
         
-        currentQueryIndex = queryList.size() - 1;
+        currentQueryIndex = lastAnswered;
+        if (!results.back().path.empty()) MapGraph::instance().setLastPath(results.back().path);
         displayQuery(queryList[currentQueryIndex], resultText);
 
         progressDialog.close();
@@ -494,6 +537,20 @@ void MainWindow::runAllQueries()
     progressDialog.exec();
 }
 
+PathResult MainWindow::showPath(const double startX, const double startY, const double endX, const double endY, const double R) const {
+    PathResult pathResult = MapGraph::instance().findShortestPath(startX, startY, endX, endY, R);
+
+    // The search is side-effect free, the map view is updated here on the GUI thread
+    if (!pathResult.path.empty()) {
+        MapGraph::instance().setLastPath(pathResult.path);
+        MapVisualizer::instance()->setStartPoint(startX, startY);
+        MapVisualizer::instance()->setEndPoint(endX, endY);
+    } else if (pathResult.resultText == "Error: No reachable intersection within R") {
+        MapVisualizer::instance()->reset();
+    }
+    return pathResult;
+}
+
 void MainWindow::displayResult(const QString &result) const {
     outputTextEdit->setText(result);
     // Scroll to the top
@@ -72,7 +72,10 @@ private:
     long long timeOut{};
     long long timeBase{};
 
+    bool mapLoading = false; // a map is being loaded on a worker thread
+
     void setupUi();
+    PathResult showPath(double startX, double startY, double endX, double endY, double R) const;
     void displayResult(const QString &result) const;
     void displayQuery(const Query &query, const QString& resultText) const;
     void pathFindingTextEdit(const bool noMap) const;
@@ -1,115 +1,485 @@
 #include "mapgraph.h"
-#include "qminmax.h"
 #include <iomanip>
 #include <chrono>
 #include <algorithm>
-#include <fstream>
 #include <iostream>
 #include <cmath>
+#include <limits>
 #include <sstream>
+#include <tuple>
+#include <unordered_map>
 
-#include "mapvisualizer.h"
+#include "mappedfile.h"
+#include "mapsnapshot.h"
+#include "textscanner.h"
+#include "threadpool.h"
 
-MapGraph::MapGraph() = default;
+namespace {
 
-MapGraph::~MapGraph() = default;
+constexpr double fixedPointStep = 0.001; // minutes per FixedPoint unit
 
-bool MapGraph::empty() const {
-    return adjacencyList.empty();
+// Converts an arc weight back to minutes, the unit of the search labels
+inline double toMinutes(const double weight) { return weight; }
+inline double toMinutes(const float weight) { return weight; }
+inline double toMinutes(const uint32_t weight) { return weight * fixedPointStep; }
+// Minutes as a FixedPoint weight. NaN (a 0 km road at speed 0) and negative minutes have no
+// unit count and take the largest weight like times past the range, never a cast of them.
+inline uint32_t toFixedPoint(const double minutes) {
+    const double units = std::round(minutes / fixedPointStep);
+    return !(units >= 0) ? UINT32_MAX : static_cast<uint32_t>(std::min(units, static_cast<double>(UINT32_MAX)));
 }
 
-bool MapGraph::loadMapFromFile(const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
+// Largest minutes per unit of straight-line distance that keeps the A* potential
+// consistent: 60 / max_speed, lowered for arcs shorter than the gap between
+// their end points (the maps round lengths) or rounded down by a reduced weight.
+template <typename Weight>
+double computePotentialScale(const CsrGraph& graph, const FlatArray<std::pair<double, double>>& positions,
+                             const FlatArray<Weight>& weights, const double maxSpeed) {
+    double scale = maxSpeed > 0 ? 60.0 / maxSpeed : 0;
+    for (int node = 0; node < static_cast<int>(graph.nodeCount()); node++) {
+        const auto& [x, y] = positions[node];
+        for (uint32_t arc = graph.firstArc(node); arc < graph.lastArc(node); arc++) {
+            const auto& [targetX, targetY] = positions[graph.targets[arc]];
+            const double length = std::sqrt((targetX - x) * (targetX - x) + (targetY - y) * (targetY - y));
+            if (length > 0) scale = std::min(scale, toMinutes(weights[arc]) / length);
+        }
+    }
+    // Headroom for rounding in the potential differences
+    return scale * (1 - 1e-9);
+}
+
+// Position of cell (x, y) along the Hilbert curve through a 2^16 x 2^16 grid
+uint32_t hilbertIndex(uint32_t x, uint32_t y) {
+    uint32_t index = 0;
+    for (uint32_t half = 1u << 15; half > 0; half >>= 1) {
+        const uint32_t rx = (x & half) ? 1 : 0;
+        const uint32_t ry = (y & half) ? 1 : 0;
+        index += half * half * ((3 * rx) ^ ry);
+        // Rotate the quadrant so the curve enters and leaves it at the right corners
+        if (ry == 0) {
+            if (rx == 1) {
+                x = half - 1 - (x & (half - 1));
+                y = half - 1 - (y & (half - 1));
+            }
+            std::swap(x, y);
+        }
+    }
+    return index;
+}
+
+// Milliseconds since construction or the previous lap
+class PhaseClock {
+public:
+    double lap() {
+        const auto now = std::chrono::high_resolution_clock::now();
+        const double ms = std::chrono::duration<double, std::milli>(now - last).count();
+        last = now;
+        return ms;
+    }
+
+private:
+    std::chrono::high_resolution_clock::time_point last = std::chrono::high_resolution_clock::now();
+};
+
+// CSR row offsets: starting at 0, never decreasing and ending at end
+template <typename Offset>
+bool validOffsets(const FlatArray<Offset>& offsets, const size_t end) {
+    if (offsets.empty() || offsets[0] != 0 || static_cast<size_t>(offsets.back()) != end) return false;
+    for (size_t i = 1; i < offsets.size(); i++) {
+        if (offsets[i] < offsets[i - 1]) return false;
+    }
+    return true;
+}
+
+// Many-to-many bucket entry: a target reaches this node in time minutes over distance km
+struct BucketEntry {
+    uint32_t target;
+    double time;
+    double distance;
+};
+
+// Walking km to node among walks, sorted by node like SeedWalks; node is one of them
+double walkTo(const std::vector<std::pair<int, double>>& walks, const int node) {
+    return std::lower_bound(walks.begin(), walks.end(), std::pair(node, -std::numeric_limits<double>::infinity()))->second;
+}
+
+}
+
+CachedPath::CachedPath(PathResult result, SeedWalks walks) : result(std::move(result)), walks(std::move(walks)) {
+    const PathResult& path = this->result;
+    if (path.path.empty() || this->walks.start.empty() || this->walks.end.empty()) return;
+    const double startWalk = walkTo(this->walks.start, path.path.front());
+    const double endWalk = walkTo(this->walks.end, path.path.back());
+    roadTime = path.travelTime - (startWalk / 5.0) * 60.0 - (endWalk / 5.0) * 60.0;
+    roadDistance = path.totalDistance - path.walkingDistance;
+}
+
+MapData::MapData() = default;
+
+MapData::~MapData() = default;
+
+bool MapData::empty() const {
+    return graph.nodeCount() == 0;
+}
+
+std::shared_ptr<MapData> MapData::load(const std::string& filename, const MapOptions& options, ThreadPool& pool) {
+    auto file = std::make_shared<MappedFile>();
+    if (!file->open(filename)) {
         std::cerr << "Error opening map file: " << filename << std::endl;
-        return false;
+        return nullptr;
     }
+    auto map = std::make_shared<MapData>();
+    map->options = options;
+    const bool loaded = MapSnapshot::isSnapshot(file->data(), file->size()) ? map->loadSnapshot(std::move(file), pool)
+                                                                            : map->loadText(*file, pool);
+    return loaded ? map : nullptr;
+}
 
+bool MapData::loadText(const MappedFile& file, ThreadPool& pool) {
     try {
-        // Clear previous data
-        nodePositions.clear();
-        edges.clear();
-        adjacencyList.clear();
-    
+        const auto startParse = std::chrono::high_resolution_clock::now();
+
+        TextScanner scanner(file.data(), file.data() + file.size());
+
         // Read the number of nodes
-        int numNodes;
-        file >> numNodes;
-        
-        if (numNodes <= 0 || numNodes > 1000000) { // Sanity check for node count
-            std::cerr << "Invalid number of nodes: " << numNodes << std::endl;
+        int numNodes = 0;
+        if (!scanner.read(numNodes) || numNodes <= 0 || !scanner.canHold(numNodes, 3)) { // Sanity check for node count
+            std::cerr << "Invalid number of nodes at " << scanner.location() << std::endl;
             return false;
         }
         
         // Reserve capacity to avoid reallocations
-        nodePositions.reserve(numNodes);
+        std::vector<std::pair<double, double>> positions;
+        positions.reserve(numNodes);
 
         // Read node information
         for (int i = 0; i < numNodes; i++) {
             Node node{};
-            file >> node.id >> node.x >> node.y;
-            
             // Check for invalid node data
-            if (file.fail()) {
-                std::cerr << "Error reading node data at index " << i << std::endl;
+            if (!scanner.read(node.id) || !scanner.read(node.x) || !scanner.read(node.y)) {
+                std::cerr << "Error reading node data at index " << i << " (" << scanner.location() << ")" << std::endl;
                 return false;
             }
             
-            // Create the spatial index for faster lookups
-            nodePositions.emplace_back(node.x, node.y);
+            positions.emplace_back(node.x, node.y);
         }
+        nodePositions.assign(std::move(positions));
+
+        // Create the spatial index for faster lookups
+        const auto startIndex = std::chrono::high_resolution_clock::now();
+        spatialIndex.build(nodePositions);
+        const auto endIndex = std::chrono::high_resolution_clock::now();
+        loadStats.indexMs = std::chrono::duration<double, std::milli>(endIndex - startIndex).count();
         
         // Read the number of edges
-        int numEdges;
-        file >> numEdges;
-
-        if (numEdges <= 0 || numEdges > 10000000) { // Sanity check for edge count
-            std::cerr << "Invalid number of edges: " << numEdges << std::endl;
+        int numEdges = 0;
+        if (!scanner.read(numEdges) || numEdges <= 0 || !scanner.canHold(numEdges, 4) ||
+            2 * static_cast<uint64_t>(numEdges) > std::numeric_limits<uint32_t>::max()) { // Every edge is two arcs with 32-bit offsets
+            std::cerr << "Invalid number of edges at " << scanner.location() << std::endl;
             return false;
         }
 
         // Reserve capacity
-        edges.reserve(numEdges);
-
-        // Initialize the adjacency list
-        adjacencyList.resize(numNodes);
+        std::vector<std::pair<int, int>> edgeList;
+        edgeList.reserve(numEdges);
 
         max_speed = 0;
-        // Read edge information
+        // Read edge information, counting degrees on the way so the CSR arrays are filled in one pass
+        std::vector<uint32_t> rowOffsets(static_cast<size_t>(numNodes) + 1, 0);
+        std::vector<double> edgeDistance, edgeSpeed;
+        edgeDistance.reserve(numEdges);
+        edgeSpeed.reserve(numEdges);
         for (int i = 0; i < numEdges; i++) {
             int source, destination;
             Edge edge{};
-            file >> source >> destination >> edge.distance >> edge.speed;
-
-            max_speed = qMax(max_speed, edge.speed);
-
             // Check for invalid edge data
-            if (file.fail()) {
-                std::cerr << "Error reading edge data at index " << i << std::endl;
+            if (!scanner.read(source) || !scanner.read(destination) || !scanner.read(edge.distance) || !scanner.read(edge.speed)) {
+                std::cerr << "Error reading edge data at index " << i << " (" << scanner.location() << ")" << std::endl;
+                return false;
+            }
+            if (source < 0 || source >= numNodes || destination < 0 || destination >= numNodes) {
+                std::cerr << "Edge " << i << " references an unknown node (" << scanner.location() << ")" << std::endl;
                 return false;
             }
 
-            edges.emplace_back(source,destination);
-
-            // Update adjacency list
-            adjacencyList[source].push_back({destination, {edge.distance, edge.speed}});
-            // Assuming bidirectional edges
-            adjacencyList[destination].push_back({source, {edge.distance, edge.speed}});
+            max_speed = std::max(max_speed, edge.speed);
 
+            rowOffsets[source + 1]++;
+            rowOffsets[destination + 1]++;
+            edgeList.emplace_back(source,destination);
+            edgeDistance.push_back(edge.distance);
+            edgeSpeed.push_back(edge.speed);
         }
-        
-        file.close();
+
+        graph = CsrGraph::build(std::move(rowOffsets), edgeList, edgeDistance, edgeSpeed);
+        edges.assign(std::move(edgeList));
+        buildReducedWeights();
+        buildLandmarks(pool);
+        buildHierarchy();
+        buildOverlay(pool);
+
+        loadStats.parseMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startParse).count()
+                            - loadStats.indexMs - loadStats.landmarkMs - loadStats.hierarchyMs - loadStats.partitionMs
+                            - loadStats.customizeMs;
         return true;
     }
     catch (const std::exception& e) {
         std::cerr << "Exception during map loading: " << e.what() << std::endl;
-        file.close();
         return false;
     }
 }
 
+bool MapData::saveSnapshot(const std::string& filename) const {
+    const MapSnapshot::Meta meta{nodePositions.size(), edges.size(), max_speed};
+    const SpatialGrid::Layout gridLayout = spatialIndex.layout();
+
+    MapSnapshot::Writer writer;
+    writer.add(MapSnapshot::Section::Meta, &meta, 1);
+    writer.add(MapSnapshot::Section::Coordinates, nodePositions);
+    writer.add(MapSnapshot::Section::EdgeList, edges);
+    writer.add(MapSnapshot::Section::AdjacencyOffsets, graph.offsets);
+    writer.add(MapSnapshot::Section::AdjacencyTargets, graph.targets);
+    writer.add(MapSnapshot::Section::AdjacencyDistance, graph.distance);
+    writer.add(MapSnapshot::Section::AdjacencySpeed, graph.speed);
+    writer.add(MapSnapshot::Section::AdjacencyTime, graph.travelTime);
+    writer.add(MapSnapshot::Section::GridLayout, &gridLayout, 1);
+    writer.add(MapSnapshot::Section::GridCells, spatialIndex.cells());
+    writer.add(MapSnapshot::Section::GridPoints, spatialIndex.points());
+    const MapSnapshot::LandmarkMeta landmarkMeta{landmarks.count(), static_cast<uint32_t>(options.landmarkSelection),
+                                                 static_cast<uint32_t>(options.weightType), options.landmarkCount};
+    if (!landmarks.empty()) {
+        writer.add(MapSnapshot::Section::LandmarkMeta, &landmarkMeta, 1);
+        writer.add(MapSnapshot::Section::LandmarkNodes, landmarks.nodes());
+        writer.add(MapSnapshot::Section::LandmarkTable, landmarks.table());
+    }
+    const MapSnapshot::HierarchyMeta hierarchyMeta{static_cast<uint32_t>(options.weightType), 0};
+    if (!hierarchy.empty()) {
+        writer.add(MapSnapshot::Section::HierarchyMeta, &hierarchyMeta, 1);
+        writer.add(MapSnapshot::Section::HierarchyOffsets, hierarchy.arcOffsets());
+        writer.add(MapSnapshot::Section::HierarchyArcs, hierarchy.upwardArcs());
+    }
+    const MapSnapshot::OverlayMeta overlayMeta{static_cast<uint32_t>(options.weightType), 0};
+    const std::vector<double> overlayCliques = overlay.cliques();
+    if (!overlay.empty()) {
+        writer.add(MapSnapshot::Section::OverlayMeta, &overlayMeta, 1);
+        writer.add(MapSnapshot::Section::OverlayCells, overlay.cells());
+        writer.add(MapSnapshot::Section::OverlayCliques, overlayCliques.data(), overlayCliques.size());
+    }
+
+    if (std::string error; !writer.write(filename, error)) {
+        std::cerr << "Error saving map snapshot: " << error << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool MapData::loadSnapshot(std::shared_ptr<MappedFile> file, ThreadPool& pool) {
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    file->adviseRandomAccess();
+    MapSnapshot::Reader reader;
+    if (std::string error; !reader.open(file, error)) {
+        std::cerr << "Error opening map snapshot: " << error << std::endl;
+        return false;
+    }
+
+    FlatArray<MapSnapshot::Meta> meta;
+    FlatArray<SpatialGrid::Layout> gridLayout;
+    FlatArray<int> gridCells;
+    FlatArray<SpatialGrid::CellPoint> gridPoints;
+    if (!reader.get(MapSnapshot::Section::Meta, meta) || meta.size() != 1 ||
+        !reader.get(MapSnapshot::Section::Coordinates, nodePositions) ||
+        !reader.get(MapSnapshot::Section::EdgeList, edges) ||
+        !reader.get(MapSnapshot::Section::AdjacencyOffsets, graph.offsets) ||
+        !reader.get(MapSnapshot::Section::AdjacencyTargets, graph.targets) ||
+        !reader.get(MapSnapshot::Section::AdjacencyDistance, graph.distance) ||
+        !reader.get(MapSnapshot::Section::AdjacencySpeed, graph.speed) ||
+        !reader.get(MapSnapshot::Section::AdjacencyTime, graph.travelTime) ||
+        !reader.get(MapSnapshot::Section::GridLayout, gridLayout) || gridLayout.size() != 1 ||
+        !reader.get(MapSnapshot::Section::GridCells, gridCells) ||
+        !reader.get(MapSnapshot::Section::GridPoints, gridPoints)) {
+        std::cerr << "Error opening map snapshot: missing or malformed section" << std::endl;
+        return false;
+    }
+
+    const size_t numNodes = nodePositions.size();
+    if (meta[0].nodeCount != numNodes || meta[0].edgeCount != edges.size() || graph.offsets.size() != numNodes + 1 ||
+        graph.offsets.back() != graph.arcCount() || graph.distance.size() != graph.arcCount() ||
+        graph.speed.size() != graph.arcCount() || graph.travelTime.size() != graph.arcCount() ||
+        gridPoints.size() != numNodes) {
+        std::cerr << "Error opening map snapshot: inconsistent section sizes" << std::endl;
+        return false;
+    }
+    // The searches index with these arrays unchecked, so a damaged file has to fail here
+    const auto isNode = [numNodes](const int node) { return node >= 0 && static_cast<size_t>(node) < numNodes; };
+    const SpatialGrid::Layout& grid = gridLayout[0];
+    if (!validOffsets(graph.offsets, graph.arcCount()) || !std::all_of(graph.targets.begin(), graph.targets.end(), isNode) ||
+        !std::all_of(edges.begin(), edges.end(), [&](const auto& edge) { return isNode(edge.first) && isNode(edge.second); }) ||
+        !std::all_of(graph.distance.begin(), graph.distance.end(), [](const double km) { return km >= 0; }) ||
+        !std::all_of(graph.speed.begin(), graph.speed.end(), [](const double speed) { return speed > 0; }) ||
+        !std::all_of(graph.travelTime.begin(), graph.travelTime.end(), [](const double minutes) { return minutes >= 0; })) {
+        std::cerr << "Error opening map snapshot: corrupt road graph" << std::endl;
+        return false;
+    }
+    if (grid.columns <= 0 || grid.rows <= 0 || !(grid.cellSize > 0) ||
+        gridCells.size() != static_cast<size_t>(grid.columns) * static_cast<size_t>(grid.rows) + 1 ||
+        !validOffsets(gridCells, gridPoints.size()) ||
+        !std::all_of(gridPoints.begin(), gridPoints.end(), [&](const SpatialGrid::CellPoint& point) { return isNode(point.id); })) {
+        std::cerr << "Error opening map snapshot: corrupt spatial index" << std::endl;
+        return false;
+    }
+    snapshotFile = std::move(file);
+    max_speed = meta[0].maxSpeed;
+    spatialIndex.attach(gridLayout[0], std::move(gridCells), std::move(gridPoints));
+    buildReducedWeights();
+
+    // Stored landmark tables are only valid for the weights and settings they were built with
+    FlatArray<MapSnapshot::LandmarkMeta> landmarkMeta;
+    FlatArray<int> landmarkNodes;
+    FlatArray<double> landmarkTable;
+    // A map with fewer nodes than requested gets fewer landmarks, so settings compare with the request
+    const auto requestedLandmarks = [&landmarkMeta] {
+        return landmarkMeta[0].requested ? landmarkMeta[0].requested : landmarkMeta[0].count;
+    };
+    if (reader.get(MapSnapshot::Section::LandmarkMeta, landmarkMeta) && landmarkMeta.size() == 1 &&
+        reader.get(MapSnapshot::Section::LandmarkNodes, landmarkNodes) &&
+        reader.get(MapSnapshot::Section::LandmarkTable, landmarkTable) &&
+        landmarkNodes.size() == landmarkMeta[0].count && landmarkTable.size() == numNodes * landmarkNodes.size() &&
+        landmarkMeta[0].weightType == static_cast<uint32_t>(options.weightType) &&
+        (options.landmarkCount == 0 || (requestedLandmarks() == options.landmarkCount &&
+                                        landmarkMeta[0].selection == static_cast<uint32_t>(options.landmarkSelection)))) {
+        if (!std::all_of(landmarkNodes.begin(), landmarkNodes.end(), isNode)) {
+            std::cerr << "Error opening map snapshot: corrupt landmark table" << std::endl;
+            return false;
+        }
+        options.landmarkCount = requestedLandmarks();
+        options.landmarkSelection = static_cast<LandmarkSelection>(landmarkMeta[0].selection);
+        landmarks.attach(std::move(landmarkNodes), std::move(landmarkTable));
+    } else {
+        buildLandmarks(pool);
+    }
+
+    FlatArray<MapSnapshot::HierarchyMeta> hierarchyMeta;
+    FlatArray<uint32_t> hierarchyOffsets;
+    FlatArray<ContractionHierarchy::Arc> hierarchyArcs;
+    if (reader.get(MapSnapshot::Section::HierarchyMeta, hierarchyMeta) && hierarchyMeta.size() == 1 &&
+        reader.get(MapSnapshot::Section::HierarchyOffsets, hierarchyOffsets) &&
+        reader.get(MapSnapshot::Section::HierarchyArcs, hierarchyArcs) && hierarchyOffsets.size() == numNodes + 1 &&
+        hierarchyOffsets.back() == hierarchyArcs.size() && hierarchyMeta[0].weightType == static_cast<uint32_t>(options.weightType)) {
+        if (!validOffsets(hierarchyOffsets, hierarchyArcs.size()) ||
+            !std::all_of(hierarchyArcs.begin(), hierarchyArcs.end(), [&](const ContractionHierarchy::Arc& arc) {
+                return isNode(arc.target) && (arc.middle == -1 || isNode(arc.middle));
+            })) {
+            std::cerr << "Error opening map snapshot: corrupt contraction hierarchy" << std::endl;
+            return false;
+        }
+        options.hierarchy = true;
+        hierarchy.attach(std::move(hierarchyOffsets), std::move(hierarchyArcs));
+    } else {
+        buildHierarchy();
+    }
+    // The partition is used whenever stored, its cliques only for the weights they were customized over
+    FlatArray<MapSnapshot::OverlayMeta> overlayMeta;
+    FlatArray<uint32_t> overlayCells;
+    FlatArray<double> overlayCliques;
+    if (reader.get(MapSnapshot::Section::OverlayMeta, overlayMeta) && overlayMeta.size() == 1 &&
+        reader.get(MapSnapshot::Section::OverlayCells, overlayCells)) {
+        const auto startOverlay = std::chrono::high_resolution_clock::now();
+        if (!overlay.attach(graph, std::move(overlayCells))) {
+            std::cerr << "Error opening map snapshot: corrupt multilevel overlay" << std::endl;
+            return false;
+        }
+        options.overlay = true;
+        loadStats.partitionMs =
+            std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startOverlay).count();
+        if (overlayMeta[0].weightType == static_cast<uint32_t>(options.weightType) &&
+            reader.get(MapSnapshot::Section::OverlayCliques, overlayCliques)) {
+            if (!overlay.attachCliques(overlayCliques)) {
+                std::cerr << "Error opening map snapshot: corrupt multilevel overlay" << std::endl;
+                return false;
+            }
+            overlayMinutes.assign(reducedMinutes());
+            loadStats.customizeMs = 0;
+        } else {
+            customizeCliques(pool);
+        }
+        const MultilevelOverlay::Stats overlayStats = overlay.stats();
+        loadStats.overlayLevels = overlayStats.levels;
+        loadStats.overlayDroppedLevels = overlayStats.droppedLevels;
+    } else {
+        buildOverlay(pool);
+    }
+
+    loadStats.parseMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count()
+                        - loadStats.landmarkMs - loadStats.hierarchyMs - loadStats.partitionMs - loadStats.customizeMs;
+    return true;
+}
+
+MapGraph::MapGraph() : current(std::make_shared<MapData>()) {}
+
+MapGraph::~MapGraph() = default;
+
+bool MapGraph::empty() const {
+    return snapshot()->empty();
+}
+
+bool MapGraph::loadMapFromFile(const std::string& filename) {
+    std::lock_guard lock(updateMutex);
+    std::shared_ptr<MapData> map = MapData::load(filename, snapshot()->getOptions(), builderPool());
+    if (!map) return false;
+    publish(std::move(map));
+    return true;
+}
+
+bool MapGraph::saveSnapshot(const std::string& filename) const {
+    return snapshot()->saveSnapshot(filename);
+}
+
+void MapGraph::publish(std::shared_ptr<MapData> map) {
+    map->epoch = ++publishedMaps;
+    // Queries still holding the old map keep it alive, the last one frees it
+    std::atomic_store(&current, std::shared_ptr<const MapData>(std::move(map)));
+    // Their answers can still land in the cache afterwards, the epoch keeps them from being returned
+    if (const auto cache = std::atomic_load(&resultCache)) cache->clear();
+    if (!rebuildingHierarchy && snapshot()->hierarchyPending()) {
+        rebuildingHierarchy = true;
+        hierarchyRebuild = std::async(std::launch::async, [this] { rebuildHierarchy(); }).share();
+    }
+}
+
+void MapGraph::rebuildHierarchy() {
+    while (true) {
+        const std::shared_ptr<const MapData> map = snapshot();
+        const std::shared_ptr<MapData> built = map->hierarchyPending() ? map->withHierarchy() : nullptr;
+        std::lock_guard lock(updateMutex);
+        // A map swapped in meanwhile has other weights or a hierarchy of its own, start over on it
+        if (snapshot() != map) continue;
+        if (built) publish(built);
+        rebuildingHierarchy = false;
+        return;
+    }
+}
+
+void MapGraph::waitForHierarchy() {
+    std::shared_future<void> rebuild;
+    {
+        std::lock_guard lock(updateMutex);
+        rebuild = hierarchyRebuild;
+    }
+    if (rebuild.valid()) rebuild.wait();
+}
+
+void MapGraph::updateOptions(const std::function<void(MapOptions&)>& change) {
+    std::lock_guard lock(updateMutex);
+    const std::shared_ptr<const MapData> map = snapshot();
+    MapOptions options = map->getOptions();
+    change(options);
+    publish(map->rebuild(options, builderPool()));
+}
+
 bool MapGraph::loadQueriesFromFile(const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
+    MappedFile file;
+    if (!file.open(filename)) {
         std::cerr << "Error opening queries file: " << filename << std::endl;
         return false;
     }
@@ -117,13 +487,13 @@ bool MapGraph::loadQueriesFromFile(const std::string& filename) {
     try {
         // Clear previous queries
         queries.clear();
+
+        TextScanner scanner(file.data(), file.data() + file.size());
         
         // Read the number of queries
-        int numQueries;
-        file >> numQueries;
-        
-        if (numQueries <= 0 || numQueries > 100000) { // Sanity check for query count
-            std::cerr << "Invalid number of queries: " << numQueries << std::endl;
+        int numQueries = 0;
+        if (!scanner.read(numQueries) || numQueries <= 0 || !scanner.canHold(numQueries, 5)) { // Sanity check for query count
+            std::cerr << "Invalid number of queries at " << scanner.location() << std::endl;
             return false;
         }
         
@@ -133,14 +503,12 @@ bool MapGraph::loadQueriesFromFile(const std::string& filename) {
         // Read query information
         for (int i = 0; i < numQueries; i++) {
             Query q{};
-            file >> q.startX >> q.startY >> q.endX >> q.endY >> q.R;
-            q.R/=1000; // Convert to km
-
             // Check for invalid query data
-            if (file.fail()) {
-                std::cerr << "Error reading query data at index " << i << std::endl;
+            if (!scanner.read(q.startX) || !scanner.read(q.startY) || !scanner.read(q.endX) || !scanner.read(q.endY) || !scanner.read(q.R)) {
+                std::cerr << "Error reading query data at index " << i << " (" << scanner.location() << ")" << std::endl;
                 return false;
             }
+            q.R/=1000; // Convert to km
             
             // Validate max speed
             if (q.R < 0) {
@@ -151,41 +519,310 @@ bool MapGraph::loadQueriesFromFile(const std::string& filename) {
             queries.push_back(q);
         }
         
-        file.close();
         return true;
     }
     catch (const std::exception& e) {
         std::cerr << "Exception during query loading: " << e.what() << std::endl;
-        file.close();
         return false;
     }
 }
 
-PathResult MapGraph::findShortestPath(double startX, double startY, double endX, double endY, double R) {
+std::shared_ptr<const MapData> MapGraph::snapshot() const {
+    return std::atomic_load(&current);
+}
+
+PathResult MapGraph::findShortestPath(double startX, double startY, double endX, double endY, double R) const {
+    // One workspace per thread, so the GUI thread and the batch worker never share labels
+    thread_local QueryWorkspace workspace;
+    return findShortestPath(startX, startY, endX, endY, R, workspace);
+}
+
+PathResult MapGraph::findShortestPath(double startX, double startY, double endX, double endY, double R, QueryWorkspace& workspace) const {
+    return findShortestPath(startX, startY, endX, endY, R, searchAlgorithm, workspace);
+}
+
+PathResult MapGraph::findShortestPath(double startX, double startY, double endX, double endY, double R,
+                                      const SearchAlgorithm algorithm, QueryWorkspace& workspace) const {
+    const std::shared_ptr<const MapData> map = snapshot();
+    return cachedShortestPath(*map, startX, startY, endX, endY, R, algorithm, queueType, workspace, -1);
+}
+
+PathResult MapGraph::findShortestPath(double startX, double startY, double endX, double endY, double R,
+                                      const double departure, QueryWorkspace& workspace) const {
+    const std::shared_ptr<const MapData> map = snapshot();
+    return cachedShortestPath(*map, startX, startY, endX, endY, R, searchAlgorithm, queueType, workspace, departure);
+}
+
+PathResult MapGraph::cachedShortestPath(const MapData& map, double startX, double startY, double endX, double endY,
+                                        double R, const SearchAlgorithm algorithm, const QueueType queue,
+                                        QueryWorkspace& workspace, const double departure) const {
+    const std::shared_ptr<ResultCache<CachedPath>> cache = std::atomic_load(&resultCache);
+    if (!cache) return map.findShortestPath(startX, startY, endX, endY, R, algorithm, queue, workspace, departure);
+
+    PhaseClock clock;
+    std::string key;
+    SeedWalks walks;
+    PathResult result;
+    if (findCached(*cache, map, {startX, startY, endX, endY, R}, algorithm, queue, departure, key, walks, result)) {
+        return result;
+    }
+    const double keyMs = clock.lap();
+    result = map.findShortestPath(startX, startY, endX, endY, R, algorithm, queue, workspace, departure);
+    result.stats.snapMs += keyMs;
+    result.stats.totalMs += keyMs;
+    cache->insert(key, map.getEpoch(), {result, std::move(walks)});
+    return result;
+}
+
+bool MapGraph::findCached(ResultCache<CachedPath>& cache, const MapData& map, const Query& query,
+                          const SearchAlgorithm algorithm, const QueueType queue, const double departure,
+                          std::string& key, SeedWalks& walks, PathResult& result) const {
+    PhaseClock clock;
+    const auto& [startX, startY, endX, endY, R] = query;
+    key = map.resultKey(startX, startY, endX, endY, R, algorithm, queue, walks, departure);
+    const auto reuse = [&](const CachedPath& cached) { return map.reuseResult(cached, walks, departure, result); };
+    if (!cache.find(key, map.getEpoch(), reuse)) return false;
+    // Only the lookup took time this time
+    const size_t startCandidates = result.stats.startCandidates, endCandidates = result.stats.endCandidates;
+    result.stats = QueryStats{};
+    result.stats.startCandidates = startCandidates;
+    result.stats.endCandidates = endCandidates;
+    result.stats.cacheHit = true;
+    result.stats.snapMs = result.stats.totalMs = clock.lap();
+    return true;
+}
+
+void MapGraph::setResultCache(const size_t capacity, const unsigned shards) {
+    std::atomic_store(&resultCache, capacity ? std::make_shared<ResultCache<CachedPath>>(capacity, shards) : nullptr);
+}
+
+ResultCacheStats MapGraph::getResultCacheStats() const {
+    const auto cache = std::atomic_load(&resultCache);
+    return cache ? cache->stats() : ResultCacheStats{};
+}
+
+PathResult MapData::findShortestPath(double startX, double startY, double endX, double endY, double R,
+                                     const SearchAlgorithm algorithm, const QueueType queueType,
+                                     QueryWorkspace& workspace, const double departure) const {
+    // The kernels time the snap, path and format phases, the search is the rest
+    PhaseClock clock;
+    PathResult result;
+    if (departure >= 0 && !profiles.empty()) {
+        if (algorithm == SearchAlgorithm::AStar || algorithm == SearchAlgorithm::Alt) {
+            // No arc is faster than its static time over the largest factor, and walking the
+            // straight line to the end is never faster than driving it
+            const double scale = std::min(potentialScale / profiles.maxFactor(), 60.0 / 5.0);
+            result = timeDependentKernel(startX, startY, endX, endY, R, departure, workspace, [&](const int node) {
+                const auto& [x, y] = nodePositions[node];
+                return scale * calculateDistance(x, y, endX, endY);
+            });
+        } else {
+            result = timeDependentKernel(startX, startY, endX, endY, R, departure, workspace, [](int) { return 0.0; });
+        }
+    } else {
+        result = runKernel(startX, startY, endX, endY, R, algorithm, queueType, workspace);
+    }
+    QueryStats& stats = result.stats;
+    stats.totalMs = clock.lap();
+    stats.searchMs = std::max(0.0, stats.totalMs - stats.snapMs - stats.pathMs - stats.formatMs);
+    return result;
+}
+
+std::vector<PathResult> MapData::findShortestPaths(const double startX, const double startY, const double R,
+                                                   const std::vector<std::pair<double, double>>& ends,
+                                                   const QueueType queueType, QueryWorkspace& workspace,
+                                                   const std::atomic_bool* cancel) const {
+    std::vector<PathResult> results(ends.size());
+    const auto search = [&](const auto& weights) {
+        switch (queueType) {
+        case QueueType::QuadHeap:
+            return oneToManyKernel(startX, startY, R, ends, workspace, weights, workspace.quadHeaps.forward, cancel, results);
+        case QueueType::Radix:
+            return oneToManyKernel(startX, startY, R, ends, workspace, weights, workspace.radixHeaps.forward, cancel, results);
+        default:
+            return oneToManyKernel(startX, startY, R, ends, workspace, weights, workspace.binaryHeaps.forward, cancel, results);
+        }
+    };
+    bool finished;
+    switch (options.weightType) {
+    case WeightType::Float:
+        finished = search(travelTimeFloat);
+        break;
+    case WeightType::FixedPoint:
+        finished = search(travelTimeFixed);
+        break;
+    default:
+        finished = search(graph.travelTime);
+    }
+    if (!finished) results.clear();
+    return results;
+}
+
+template <typename Weight, typename Queue>
+bool MapData::oneToManyKernel(const double startX, const double startY, const double R,
+                              const std::vector<std::pair<double, double>>& ends, QueryWorkspace& workspace,
+                              const FlatArray<Weight>& weights, Queue& queue, const std::atomic_bool* cancel,
+                              std::vector<PathResult>& results) const {
+    PhaseClock clock;
+    queue.prepare(nodePositions.size());
+    workspace.prepare(nodePositions.size());
+    SearchLabels& forward = workspace.forward;
+
+    const std::vector<std::pair<int, double>> startNodes = findNodesWithinRadius(startX, startY, R, forward);
+    for (const auto& [node, distance] : startNodes) queue.push(forward.time(node), node);
+
+    // The walking seeds of every end, grouped by node so a settled node finds its ends at once
+    struct EndSeed {
+        uint32_t end;
+        double distance; // km walked from the node to the end
+    };
+    std::unordered_map<int, std::vector<EndSeed>> seedsAt;
+    std::vector<int> meetingNode(ends.size(), -1);
+    std::vector<double> meetingWalk(ends.size(), 0);
+    size_t open = 0;
+    for (uint32_t j = 0; j < ends.size(); j++) {
+        PathResult& result = results[j];
+        result.travelTime = std::numeric_limits<double>::infinity();
+        result.stats.startCandidates = startNodes.size();
+        spatialIndex.forEachWithin(ends[j].first, ends[j].second, R, [&](const int node, const double distance) {
+            seedsAt[node].push_back({j, distance});
+            result.stats.endCandidates++;
+        });
+        if (startNodes.empty() || result.stats.endCandidates == 0) {
+            result.resultText = "Error: No reachable intersection within R";
+        } else {
+            open++;
+        }
+    }
+    const double snapMs = clock.lap();
+
+    // No unsettled node can improve an end once the queue's minimum reaches its best time, the
+    // search stops when that holds for the slowest end
+    double bound = std::numeric_limits<double>::infinity();
+    size_t settledNodes = 0, relaxedArcs = 0;
+    while (open > 0 && !queue.empty() && queue.top().first < bound) {
+        const auto [time, node] = queue.top();
+        queue.pop();
+        if (forward.settled(node)) continue;
+        forward.settle(node);
+        settledNodes++;
+        // A group can take as long as many single queries, so it looks at cancel on the way
+        if (cancel && settledNodes % 1024 == 0 && cancel->load()) return false;
+        relaxedArcs += graph.lastArc(node) - graph.firstArc(node);
+
+        if (const auto found = seedsAt.find(node); found != seedsAt.end()) {
+            bool improved = false;
+            for (const auto& [end, distance] : found->second) {
+                PathResult& result = results[end];
+                if (const double total = time + (distance / 5.0) * 60.0; total < result.travelTime) {
+                    result.travelTime = total;
+                    meetingNode[end] = node;
+                    meetingWalk[end] = distance;
+                    improved = true;
+                }
+            }
+            if (improved) {
+                bound = 0;
+                for (const PathResult& result : results) {
+                    if (result.resultText.empty()) bound = std::max(bound, result.travelTime);
+                }
+            }
+        }
+
+        for (uint32_t arc = graph.firstArc(node); arc < graph.lastArc(node); arc++) {
+            const int neighbor = graph.targets[arc];
+            if (const double newTime = time + toMinutes(weights[arc]); newTime < forward.time(neighbor)) {
+                forward.set(neighbor, newTime, forward.dist(node) + graph.distance[arc], node);
+                queue.push(newTime, neighbor);
+            }
+        }
+    }
+    const double searchMs = clock.lap();
+
+    // The path of every end is the forward tree's branch to its meeting node, followed by the walk
+    // that buildResult reads from a backward label
+    const double share = 1.0 / std::max<size_t>(ends.size(), 1);
+    for (uint32_t j = 0; j < ends.size(); j++) {
+        PathResult& result = results[j];
+        QueryStats& stats = result.stats;
+        stats.sharedSearch = true;
+        if (j == 0) {
+            stats.settledNodes = settledNodes;
+            stats.relaxedArcs = relaxedArcs;
+            stats.queuePushes = queue.pushes();
+            stats.queuePops = queue.pops();
+        }
+        if (result.resultText.empty()) {
+            if (meetingNode[j] == -1) {
+                result.resultText = "Error: No valid path found";
+            } else {
+                workspace.backward.reset();
+                workspace.backward.set(meetingNode[j], (meetingWalk[j] / 5.0) * 60.0, meetingWalk[j], -1);
+                buildResult(meetingNode[j], workspace, result);
+            }
+        }
+        stats.snapMs = snapMs * share;
+        stats.searchMs = searchMs * share;
+        stats.totalMs = stats.snapMs + stats.searchMs + stats.pathMs + stats.formatMs;
+    }
+    return true;
+}
+
+PathResult MapData::runKernel(const double startX, const double startY, const double endX, const double endY, const double R,
+                              const SearchAlgorithm algorithm, const QueueType queueType, QueryWorkspace& workspace) const {
+    if ((algorithm == SearchAlgorithm::Ch && !hierarchy.empty()) || (algorithm == SearchAlgorithm::Overlay && !overlay.empty())) {
+        return engineKernel(startX, startY, endX, endY, R, workspace, algorithm);
+    }
+    const auto search = [&](const auto& weights) {
+        if (algorithm == SearchAlgorithm::AStar || algorithm == SearchAlgorithm::Alt) return astarKernel(startX, startY, endX, endY, R, workspace, weights, algorithm);
+        switch (queueType) {
+        case QueueType::QuadHeap:
+            return dijkstraKernel(startX, startY, endX, endY, R, workspace, weights, workspace.quadHeaps);
+        case QueueType::Radix:
+            return dijkstraKernel(startX, startY, endX, endY, R, workspace, weights, workspace.radixHeaps);
+        default:
+            return dijkstraKernel(startX, startY, endX, endY, R, workspace, weights, workspace.binaryHeaps);
+        }
+    };
+    switch (options.weightType) {
+    case WeightType::Float:
+        return search(travelTimeFloat);
+    case WeightType::FixedPoint:
+        return search(travelTimeFixed);
+    default:
+        return search(graph.travelTime);
+    }
+}
+
+template <typename Weight, typename Queue>
+PathResult MapData::dijkstraKernel(const double startX, const double startY, const double endX, const double endY, const double R,
+                                    QueryWorkspace& workspace, const FlatArray<Weight>& weights, QueuePair<Queue>& queues) const {
+    PhaseClock clock;
     // Priority queue for Dijkstra's algorithm - (distance, node)
-    priorityQueue pqForward;
-    priorityQueue pqBackward;
+    Queue& pqForward = queues.forward;
+    Queue& pqBackward = queues.backward;
+    pqForward.prepare(nodePositions.size());
+    pqBackward.prepare(nodePositions.size());
 
-    // Initialize arrays for Dijkstra's algorithm
-    std::vector timeForward(nodePositions.size(), std::numeric_limits<double>::infinity());
-    std::vector timeBackward(nodePositions.size(), std::numeric_limits<double>::infinity());
-    std::vector distForward(nodePositions.size(), 0.0);
-    std::vector distBackward(nodePositions.size(), 0.0);
-    std::vector prevForward(nodePositions.size(), -1);
-    std::vector prevBackward(nodePositions.size(), -1);
-    std::vector visitedStart(nodePositions.size(), false);
-    std::vector visitedEnd(nodePositions.size(), false);
+    // Invalidate labels left over from the previous query
+    workspace.prepare(nodePositions.size());
+    SearchLabels& forward = workspace.forward;
+    SearchLabels& backward = workspace.backward;
 
     // Find the closest nodes to start and end coordinates
-    std::vector<std::pair<int, double>> startNodes = findNodesWithinRadius(startX, startY, R, pqForward, timeForward, distForward);
-    std::vector<std::pair<int, double>> endNodes = findNodesWithinRadius(endX, endY, R, pqBackward, timeBackward, distBackward);
+    std::vector<std::pair<int, double>> startNodes = findNodesWithinRadius(startX, startY, R, forward);
+    std::vector<std::pair<int, double>> endNodes = findNodesWithinRadius(endX, endY, R, backward);
+    for (const auto& [node, distance] : startNodes) pqForward.push(forward.time(node), node);
+    for (const auto& [node, distance] : endNodes) pqBackward.push(backward.time(node), node);
 
     PathResult result;
     result.travelTime = std::numeric_limits<double>::infinity();
+    result.stats.startCandidates = startNodes.size();
+    result.stats.endCandidates = endNodes.size();
+    result.stats.snapMs = clock.lap();
 
     if (startNodes.empty() || endNodes.empty()) {
         result.resultText = "Error: No reachable intersection within R";
-        MapVisualizer::instance()->reset();
         return result;
     }
 
@@ -198,32 +835,32 @@ PathResult MapGraph::findShortestPath(double startX, double startY, double endX,
         {
             auto [currTime, currNode] = pqForward.top();
             pqForward.pop();
-            if (visitedStart[currNode]) continue;
-            visitedStart[currNode] = true;
+            if (forward.settled(currNode)) continue;
+            forward.settle(currNode);
+            result.stats.settledNodes++;
+            result.stats.relaxedArcs += graph.lastArc(currNode) - graph.firstArc(currNode);
 
             // Check if this node has been visited by backward search
-            if (visitedEnd[currNode]) {
-                if (double totalTime = timeForward[currNode] + timeBackward[currNode]; totalTime < result.travelTime) {
+            if (backward.settled(currNode)) {
+                if (double totalTime = forward.time(currNode) + backward.time(currNode); totalTime < result.travelTime) {
                     meetingNode = currNode;
                     result.travelTime = totalTime;
                 }
             }
             // Check all neighbors
-            for (const auto& [neighbor, edge] : adjacencyList[currNode]) {
-                // Skip already visited nodes
-                double newTime = timeForward[currNode] + (edge.distance/edge.speed)*60;
+            for (uint32_t arc = graph.firstArc(currNode); arc < graph.lastArc(currNode); arc++) {
+                const int neighbor = graph.targets[arc];
+                double newTime = currTime + toMinutes(weights[arc]);
 
-                if (visitedEnd[neighbor] && newTime + timeBackward[neighbor] < result.travelTime) {
+                if (backward.settled(neighbor) && newTime + backward.time(neighbor) < result.travelTime) {
                     meetingNode = neighbor;
-                    result.travelTime = newTime + timeBackward[neighbor];
+                    result.travelTime = newTime + backward.time(neighbor);
                 }
 
                 // Relaxation step
-                if (newTime < timeForward[neighbor]) {
-                    timeForward[neighbor] = newTime;
-                    distForward[neighbor] = distForward[currNode] + edge.distance;
-                    prevForward[neighbor] = currNode;
-                    pqForward.emplace(newTime, neighbor);
+                if (newTime < forward.time(neighbor)) {
+                    forward.set(neighbor, newTime, forward.dist(currNode) + graph.distance[arc], currNode);
+                    pqForward.push(newTime, neighbor);
                 }
             }
 
@@ -232,72 +869,306 @@ PathResult MapGraph::findShortestPath(double startX, double startY, double endX,
             auto [currTime, currNode] = pqBackward.top();
             pqBackward.pop();
 
-            if (visitedEnd[currNode]) continue;
-            visitedEnd[currNode] = true;
+            if (backward.settled(currNode)) continue;
+            backward.settle(currNode);
+            result.stats.settledNodes++;
+            result.stats.relaxedArcs += graph.lastArc(currNode) - graph.firstArc(currNode);
 
             // Check if this node has been visited by forward search
-            if (visitedStart[currNode]) {
-                if (double totalTime = timeForward[currNode] + timeBackward[currNode]; totalTime < result.travelTime) {
+            if (forward.settled(currNode)) {
+                if (double totalTime = forward.time(currNode) + backward.time(currNode); totalTime < result.travelTime) {
                     meetingNode = currNode;
                     result.travelTime = totalTime;
                 }
             }
 
             // Check all neighbors
-            for (const auto& [neighbor, edge] : adjacencyList[currNode]) {
-                // Skip already visited nodes
-                double newTime = timeBackward[currNode] + (edge.distance/edge.speed)*60;
+            for (uint32_t arc = graph.firstArc(currNode); arc < graph.lastArc(currNode); arc++) {
+                const int neighbor = graph.targets[arc];
+                double newTime = currTime + toMinutes(weights[arc]);
 
-                if (visitedStart[neighbor] && newTime + timeForward[neighbor] < result.travelTime) {
+                if (forward.settled(neighbor) && newTime + forward.time(neighbor) < result.travelTime) {
                     meetingNode = neighbor;
-                    result.travelTime = newTime + timeForward[neighbor];
+                    result.travelTime = newTime + forward.time(neighbor);
                 }
 
                 // Relaxation step
-                if (newTime < timeBackward[neighbor]) {
-                    timeBackward[neighbor] = newTime;
-                    distBackward[neighbor] = distBackward[currNode] + edge.distance;
-                    prevBackward[neighbor] = currNode;
-                    pqBackward.emplace(newTime , neighbor);
+                if (newTime < backward.time(neighbor)) {
+                    backward.set(neighbor, newTime, backward.dist(currNode) + graph.distance[arc], currNode);
+                    pqBackward.push(newTime, neighbor);
                 }
             }
         }
         // Add a more efficient termination condition
-        if (timeForward[currNodeForward] + timeBackward[currNodeBackward] >= result.travelTime) break;
+        if (forward.time(currNodeForward) + backward.time(currNodeBackward) >= result.travelTime) break;
+    }
+    result.stats.queuePushes = pqForward.pushes() + pqBackward.pushes();
+    result.stats.queuePops = pqForward.pops() + pqBackward.pops();
+
+    if (meetingNode == -1) {
+        result.resultText = "Error: No valid path found";
+        return result;
+    }
+
+    buildResult(meetingNode, workspace, result);
+    return result;
+}
+
+template <typename Weight>
+PathResult MapData::astarKernel(const double startX, const double startY, const double endX, const double endY, const double R,
+                                 QueryWorkspace& workspace, const FlatArray<Weight>& weights,
+                                 const SearchAlgorithm algorithm) const {
+    PhaseClock clock;
+    workspace.prepare(nodePositions.size());
+    SearchLabels& forward = workspace.forward;
+    SearchLabels& backward = workspace.backward;
+
+    // Seeds with their walking times as labels, queued again below with potentials
+    priorityQueue walkQueue;
+    const std::vector<std::pair<int, double>> startNodes = findNodesWithinRadius(startX, startY, R, walkQueue, forward);
+    const std::vector<std::pair<int, double>> endNodes = findNodesWithinRadius(endX, endY, R, walkQueue, backward);
+
+    PathResult result;
+    result.travelTime = std::numeric_limits<double>::infinity();
+    result.stats.startCandidates = startNodes.size();
+    result.stats.endCandidates = endNodes.size();
+    result.stats.snapMs = clock.lap();
+
+    if (startNodes.empty() || endNodes.empty()) {
+        result.resultText = "Error: No reachable intersection within R";
+        return result;
+    }
+
+    if (algorithm == SearchAlgorithm::Alt && !landmarks.empty()) {
+        // Seeds enter with their walking times, so the bounds cover the walk too
+        std::vector<std::pair<int, double>> startSeeds, endSeeds;
+        for (const auto& [node, distance] : startNodes) startSeeds.emplace_back(node, forward.time(node));
+        for (const auto& [node, distance] : endNodes) endSeeds.emplace_back(node, backward.time(node));
+        Landmarks::SeedBounds toEnd, fromStart;
+        landmarks.boundSeeds(endSeeds, toEnd);
+        landmarks.boundSeeds(startSeeds, fromStart);
+        astarSearch(workspace, weights, startNodes, endNodes, [&](const int node) {
+            return 0.5 * (landmarks.lowerBound(node, toEnd) - landmarks.lowerBound(node, fromStart));
+        }, result);
+    } else {
+        astarSearch(workspace, weights, startNodes, endNodes, [&](const int node) {
+            const auto& [x, y] = nodePositions[node];
+            return 0.5 * potentialScale * (calculateDistance(x, y, endX, endY) - calculateDistance(x, y, startX, startY));
+        }, result);
+    }
+    return result;
+}
+
+// Bidirectional A* from seeded labels. potential(node) is the average of a bound
+// towards the end and minus a bound from the start; the forward search keys on
+// +potential and the backward one on -potential, so both see non-negative reduced
+// weights and a forward plus a backward key is a path length.
+template <typename Weight, typename Potential>
+void MapData::astarSearch(QueryWorkspace& workspace, const FlatArray<Weight>& weights,
+                           const std::vector<std::pair<int, double>>& startNodes,
+                           const std::vector<std::pair<int, double>>& endNodes, const Potential& potential,
+                           PathResult& result) const {
+    SearchLabels& forward = workspace.forward;
+    SearchLabels& backward = workspace.backward;
+
+    priorityQueue pqForward;
+    priorityQueue pqBackward;
+    for (const auto& [node, distance] : startNodes) pqForward.emplace(forward.time(node) + potential(node), node);
+    for (const auto& [node, distance] : endNodes) pqBackward.emplace(backward.time(node) - potential(node), node);
+    QueryStats& stats = result.stats;
+    stats.queuePushes += startNodes.size() + endNodes.size();
+
+    int meetingNode = -1;
+    // Keeps the best path through a node both searches have labelled
+    const auto meet = [&](const int node) {
+        if (const double totalTime = forward.time(node) + backward.time(node); totalTime < result.travelTime) {
+            meetingNode = node;
+            result.travelTime = totalTime;
+        }
+    };
+    // Smallest key still waiting, entries of settled nodes are dropped
+    const auto topKey = [&stats](priorityQueue& pq, const SearchLabels& labels) {
+        while (!pq.empty() && labels.settled(pq.top().second)) {
+            pq.pop();
+            stats.queuePops++;
+        }
+        return pq.empty() ? std::numeric_limits<double>::infinity() : pq.top().first;
+    };
+    const auto step = [&](priorityQueue& pq, SearchLabels& labels, const double sign) {
+        const int currNode = pq.top().second;
+        pq.pop();
+        labels.settle(currNode);
+        stats.queuePops++;
+        stats.settledNodes++;
+        stats.relaxedArcs += graph.lastArc(currNode) - graph.firstArc(currNode);
+        meet(currNode);
+
+        const double currTime = labels.time(currNode);
+        for (uint32_t arc = graph.firstArc(currNode); arc < graph.lastArc(currNode); arc++) {
+            const int neighbor = graph.targets[arc];
+            const double newTime = currTime + toMinutes(weights[arc]);
+            if (newTime < labels.time(neighbor)) {
+                labels.set(neighbor, newTime, labels.dist(currNode) + graph.distance[arc], currNode);
+                pq.emplace(newTime + sign * potential(neighbor), neighbor);
+                stats.queuePushes++;
+                meet(neighbor);
+            }
+        }
+    };
+
+    while (true) {
+        const double forwardKey = topKey(pqForward, forward);
+        const double backwardKey = topKey(pqBackward, backward);
+        // Every path not yet seen is at least as long as the two smallest keys
+        if (forwardKey + backwardKey >= result.travelTime) break;
+        if (forwardKey <= backwardKey) {
+            step(pqForward, forward, 1.0);
+        } else {
+            step(pqBackward, backward, -1.0);
+        }
+    }
+
+    if (meetingNode == -1) {
+        result.resultText = "Error: No valid path found";
+        return;
+    }
+
+    buildResult(meetingNode, workspace, result);
+}
+
+template <typename Potential>
+PathResult MapData::timeDependentKernel(const double startX, const double startY, const double endX, const double endY,
+                                        const double R, const double departure, QueryWorkspace& workspace,
+                                        const Potential& potential) const {
+    PhaseClock clock;
+    workspace.prepare(nodePositions.size());
+    SearchLabels& forward = workspace.forward;
+    // Only the end seeds' walks, read when a seed is settled and by buildResult
+    SearchLabels& backward = workspace.backward;
+
+    const std::vector<std::pair<int, double>> startNodes = findNodesWithinRadius(startX, startY, R, forward);
+    const std::vector<std::pair<int, double>> endNodes = findNodesWithinRadius(endX, endY, R, backward);
+
+    PathResult result;
+    result.travelTime = std::numeric_limits<double>::infinity();
+    QueryStats& stats = result.stats;
+    stats.startCandidates = startNodes.size();
+    stats.endCandidates = endNodes.size();
+    stats.snapMs = clock.lap();
+
+    if (startNodes.empty() || endNodes.empty()) {
+        result.resultText = "Error: No reachable intersection within R";
+        return result;
+    }
+
+    // Keyed on minutes since departure plus the potential
+    priorityQueue queue;
+    for (const auto& [node, distance] : startNodes) queue.emplace(forward.time(node) + potential(node), node);
+    stats.queuePushes += startNodes.size();
+
+    int meetingNode = -1;
+    while (!queue.empty() && queue.top().first < result.travelTime) {
+        const int node = queue.top().second;
+        queue.pop();
+        stats.queuePops++;
+        if (forward.settled(node)) continue;
+        forward.settle(node);
+        stats.settledNodes++;
+        stats.relaxedArcs += graph.lastArc(node) - graph.firstArc(node);
+
+        const double time = forward.time(node);
+        if (const double total = time + backward.time(node); total < result.travelTime) {
+            meetingNode = node;
+            result.travelTime = total;
+        }
+        const double at = departure + time;
+        for (uint32_t arc = graph.firstArc(node); arc < graph.lastArc(node); arc++) {
+            const int neighbor = graph.targets[arc];
+            const double newTime = time + profiles.travelMinutes(arc, graph.distance[arc], graph.speed[arc], at);
+            if (newTime < forward.time(neighbor)) {
+                forward.set(neighbor, newTime, forward.dist(node) + graph.distance[arc], node);
+                queue.emplace(newTime + potential(neighbor), neighbor);
+                stats.queuePushes++;
+            }
+        }
     }
 
     if (meetingNode == -1) {
         result.resultText = "Error: No valid path found";
         return result;
     }
+    buildResult(meetingNode, workspace, result);
+    return result;
+}
+
+PathResult MapData::engineKernel(const double startX, const double startY, const double endX, const double endY,
+                                  const double R, QueryWorkspace& workspace, const SearchAlgorithm algorithm) const {
+    PhaseClock clock;
+    workspace.prepare(nodePositions.size());
+
+    // Both engines keep their own queues, this one only collects the seeds
+    priorityQueue seedQueue;
+    const std::vector<std::pair<int, double>> startNodes = findNodesWithinRadius(startX, startY, R, seedQueue, workspace.forward);
+    const std::vector<std::pair<int, double>> endNodes = findNodesWithinRadius(endX, endY, R, seedQueue, workspace.backward);
+
+    PathResult result;
+    result.travelTime = std::numeric_limits<double>::infinity();
+    result.stats.startCandidates = startNodes.size();
+    result.stats.endCandidates = endNodes.size();
+    result.stats.snapMs = clock.lap();
+
+    if (startNodes.empty() || endNodes.empty()) {
+        result.resultText = "Error: No reachable intersection within R";
+        return result;
+    }
+    const bool found = algorithm == SearchAlgorithm::Ch
+                           ? hierarchy.search(startNodes, endNodes, workspace, result)
+                           : overlay.search(startNodes, endNodes, workspace, graph,
+                                            overlayMinutes.empty() ? graph.travelTime.data() : overlayMinutes.data(), result);
+    if (!found) {
+        result.resultText = "Error: No valid path found";
+        return result;
+    }
+    formatResult(result);
+    return result;
+}
+
+void MapData::buildResult(const int meetingNode, const QueryWorkspace& workspace, PathResult& result) const {
+    PhaseClock clock;
+    const SearchLabels& forward = workspace.forward;
+    const SearchLabels& backward = workspace.backward;
 
     // Reconstruct forward paths
     std::vector<int> forwardPath;
-    for (int at = meetingNode; at != -1; at = prevForward[at]) {
+    for (int at = meetingNode; at != -1; at = forward.prev(at)) {
         forwardPath.push_back(at);
     }
     std::reverse(forwardPath.begin(), forwardPath.end());
 
     // Reconstruct the backward path
     std::vector<int> backwardPath;
-    for (int at = prevBackward[meetingNode]; at != -1; at = prevBackward[at]) {
+    for (int at = backward.prev(meetingNode); at != -1; at = backward.prev(at)) {
         backwardPath.push_back(at);
     }
 
     result.path = forwardPath;
     result.path.insert(result.path.end(), backwardPath.begin(), backwardPath.end());
-    lastPath = result.path;
 
     // Calculate walking distance
-    result.walkingDistance = distForward[result.path[0]] + distBackward[result.path[result.path.size()-1]];
+    result.walkingDistance = forward.dist(result.path[0]) + backward.dist(result.path[result.path.size()-1]);
 
     // Calculate total distance using Dijkstra's results
-    result.totalDistance = distForward[meetingNode] + distBackward[meetingNode];
+    result.totalDistance = forward.dist(meetingNode) + backward.dist(meetingNode);
 
     // Calculate vehicle distance
     result.vehicleDistance = round((result.totalDistance - result.walkingDistance)*100)/100;
+    result.stats.pathMs = clock.lap();
 
-    // Format result string
+    formatResult(result);
+}
+
+void MapData::formatResult(PathResult& result) {
+    PhaseClock clock;
     std::stringstream ss;
     for (size_t i = 0; i < result.path.size(); i++) {
         ss << result.path[i];
@@ -312,12 +1183,753 @@ PathResult MapGraph::findShortestPath(double startX, double startY, double endX,
     ss << std::fixed << std::setprecision(2) << result.vehicleDistance << " km" << std::endl;
 
     result.resultText = ss.str();
+    result.stats.formatMs = clock.lap();
+}
 
-    MapVisualizer::instance()->setStartPoint(startX, startY);
-    MapVisualizer::instance()->setEndPoint(endX, endY);
+std::vector<PathResult> MapGraph::runQueries(const std::vector<Query>& batch, const BatchOptions& options, BatchStats* stats) {
+    const auto start = std::chrono::high_resolution_clock::now();
+    ThreadPool& workers = threadPool();
+
+    // A reload during the batch does not mix maps
+    const std::shared_ptr<const MapData> map = snapshot();
+    const SearchAlgorithm algorithm = searchAlgorithm;
+    const QueueType queue = queueType;
+    const double departure = options.departure;
+
+    std::vector<size_t> order = options.order == BatchOrder::Hilbert ? localityOrder(batch) : std::vector<size_t>{};
+    if (order.empty()) {
+        order.resize(batch.size());
+        for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    }
+
+    // Work units in order of their first query: a single query, or every query with the same
+    // start and R when they share one search
+    std::vector<size_t> unitStart{0};
+    std::vector<size_t> unitQueries;
+    unitQueries.reserve(batch.size());
+    const bool share = options.shareOrigins && algorithm == SearchAlgorithm::Dijkstra &&
+                       (departure < 0 || map->getSpeedProfiles().empty());
+    if (share) {
+        std::map<std::tuple<double, double, double>, std::vector<size_t>> origins;
+        std::vector<std::vector<size_t>*> groups;
+        for (const size_t i : order) {
+            auto [group, added] = origins.try_emplace({batch[i].startX, batch[i].startY, batch[i].R});
+            if (added) groups.push_back(&group->second);
+            group->second.push_back(i);
+        }
+        for (const std::vector<size_t>* group : groups) {
+            unitQueries.insert(unitQueries.end(), group->begin(), group->end());
+            unitStart.push_back(unitQueries.size());
+        }
+    } else {
+        unitQueries = order;
+        for (size_t i = 1; i <= batch.size(); i++) unitStart.push_back(i);
+    }
+
+    const std::shared_ptr<ResultCache<CachedPath>> cache = std::atomic_load(&resultCache);
+    std::vector<PathResult> results(batch.size());
+    std::atomic_size_t completed{0};
+    workers.parallelFor(unitStart.size() - 1, options.chunkSize, [&](const size_t begin, const size_t end, unsigned) {
+        thread_local QueryWorkspace workspace;
+        std::vector<size_t> missed;
+        std::vector<std::string> keys;
+        std::vector<SeedWalks> missedWalks;
+        std::vector<std::pair<size_t, size_t>> repeats; // query, index into missed
+        std::vector<std::pair<double, double>> ends;
+        for (size_t unit = begin; unit < end; unit++) {
+            if (options.cancel && options.cancel->load()) return;
+            const size_t first = unitStart[unit], last = unitStart[unit + 1];
+            // Each slot is written by exactly one worker, so the output keeps the input order
+            if (last - first == 1) {
+                const auto &[startX, startY, endX, endY, R] = batch[unitQueries[first]];
+                results[unitQueries[first]] = cachedShortestPath(*map, startX, startY, endX, endY, R, algorithm, queue,
+                                                                 workspace, departure);
+            } else {
+                // The members the cache cannot answer share the search, a repeated one is searched once
+                missed.clear();
+                keys.clear();
+                missedWalks.clear();
+                repeats.clear();
+                for (size_t k = first; k < last; k++) {
+                    const size_t i = unitQueries[k];
+                    std::string key;
+                    SeedWalks walks;
+                    if (cache && findCached(*cache, *map, batch[i], algorithm, queue, departure, key, walks, results[i])) {
+                        continue;
+                    }
+                    // The start walks are the same for the whole group, the end walks must match as well
+                    size_t seen = cache ? 0 : keys.size();
+                    while (seen < keys.size() && (keys[seen] != key || missedWalks[seen].end != walks.end)) seen++;
+                    if (seen != keys.size()) {
+                        repeats.emplace_back(i, seen);
+                        continue;
+                    }
+                    missed.push_back(i);
+                    keys.push_back(std::move(key));
+                    missedWalks.push_back(std::move(walks));
+                }
+                ends.clear();
+                for (const size_t i : missed) ends.emplace_back(batch[i].endX, batch[i].endY);
+                const Query& origin = batch[unitQueries[first]];
+                std::vector<PathResult> answers =
+                    map->findShortestPaths(origin.startX, origin.startY, origin.R, ends, queue, workspace, options.cancel);
+                if (answers.size() != missed.size()) return;
+                for (const auto& [i, k] : repeats) {
+                    // Answered like a cache hit on the entry inserted below
+                    results[i] = answers[k];
+                    results[i].stats = QueryStats{};
+                    results[i].stats.startCandidates = answers[k].stats.startCandidates;
+                    results[i].stats.endCandidates = answers[k].stats.endCandidates;
+                    results[i].stats.cacheHit = true;
+                }
+                for (size_t k = 0; k < missed.size(); k++) {
+                    if (cache) cache->insert(keys[k], map->getEpoch(), {answers[k], std::move(missedWalks[k])});
+                    results[missed[k]] = std::move(answers[k]);
+                }
+            }
+            const size_t done = completed.fetch_add(last - first) + last - first;
+            if (options.onProgress) options.onProgress(done);
+        }
+    });
+
+    if (stats) {
+        stats->threads = workers.size();
+        stats->queries = completed.load();
+        stats->elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        stats->queriesPerSecond = stats->elapsedMs > 0 ? stats->queries * 1000.0 / stats->elapsedMs : 0;
+
+        // A cancelled batch leaves unanswered slots, they never took any time
+        std::vector<const QueryStats*> answered;
+        stats->cacheHits = 0;
+        for (const PathResult& result : results) {
+            if (result.stats.totalMs > 0) answered.push_back(&result.stats);
+            stats->cacheHits += result.stats.cacheHit;
+        }
+        const auto distribution = [&](const auto& measure) {
+            std::vector<double> values;
+            values.reserve(answered.size());
+            for (const QueryStats* query : answered) values.push_back(static_cast<double>(measure(*query)));
+            return Percentiles::of(std::move(values));
+        };
+        stats->totalMs = distribution([](const QueryStats& query) { return query.totalMs; });
+        stats->snapMs = distribution([](const QueryStats& query) { return query.snapMs; });
+        stats->searchMs = distribution([](const QueryStats& query) { return query.searchMs; });
+        stats->pathMs = distribution([](const QueryStats& query) { return query.pathMs; });
+        stats->formatMs = distribution([](const QueryStats& query) { return query.formatMs; });
+        stats->candidates = distribution([](const QueryStats& query) { return query.startCandidates + query.endCandidates; });
+        stats->settledNodes = distribution([](const QueryStats& query) { return query.settledNodes; });
+        stats->relaxedArcs = distribution([](const QueryStats& query) { return query.relaxedArcs; });
+        stats->queuePushes = distribution([](const QueryStats& query) { return query.queuePushes; });
+        stats->queuePops = distribution([](const QueryStats& query) { return query.queuePops; });
+    }
+    return results;
+}
+
+std::vector<size_t> MapGraph::localityOrder(const std::vector<Query>& batch) {
+    // Grid over the bounding box of every start and end point
+    double minX = std::numeric_limits<double>::infinity(), minY = minX;
+    double maxX = -minX, maxY = -minX;
+    for (const auto& [startX, startY, endX, endY, R] : batch) {
+        minX = std::min({minX, startX, endX});
+        minY = std::min({minY, startY, endY});
+        maxX = std::max({maxX, startX, endX});
+        maxY = std::max({maxY, startY, endY});
+    }
+    const double cells = 65535;
+    const double scale = cells / std::max({maxX - minX, maxY - minY, 1e-12});
+    const auto cellIndex = [&](const double x, const double y) {
+        return hilbertIndex(static_cast<uint32_t>(std::clamp((x - minX) * scale, 0.0, cells)),
+                            static_cast<uint32_t>(std::clamp((y - minY) * scale, 0.0, cells)));
+    };
+
+    std::vector<std::pair<uint64_t, size_t>> keys(batch.size());
+    for (size_t i = 0; i < batch.size(); i++) {
+        const auto& [startX, startY, endX, endY, R] = batch[i];
+        keys[i] = {static_cast<uint64_t>(cellIndex(startX, startY)) << 32 | cellIndex(endX, endY), i};
+    }
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<size_t> order(batch.size());
+    for (size_t i = 0; i < keys.size(); i++) order[i] = keys[i].second;
+    return order;
+}
+
+Percentiles Percentiles::of(std::vector<double> values) {
+    Percentiles result;
+    if (values.empty()) return result;
+    std::sort(values.begin(), values.end());
+    // Nearest rank: the smallest value with at least p percent of the values at or below it
+    const auto rank = [&](const double p) {
+        const size_t index = static_cast<size_t>(std::ceil(p / 100 * values.size()));
+        return values[std::max<size_t>(index, 1) - 1];
+    };
+    result.p50 = rank(50);
+    result.p95 = rank(95);
+    result.p99 = rank(99);
     return result;
 }
 
+TravelMatrix MapGraph::travelMatrix(const std::vector<MatrixPoint>& sources, const std::vector<MatrixPoint>& targets,
+                                    BatchStats* stats) {
+    return snapshot()->travelMatrix(sources, targets, threadPool(), stats);
+}
+
+TravelMatrix MapData::travelMatrix(const std::vector<MatrixPoint>& sources, const std::vector<MatrixPoint>& targets,
+                                   ThreadPool& workers, BatchStats* stats) const {
+    const auto start = std::chrono::high_resolution_clock::now();
+    const size_t nodeCount = graph.nodeCount();
+
+    TravelMatrix matrix;
+    matrix.rows = sources.size();
+    matrix.cols = targets.size();
+    matrix.times.assign(matrix.rows * matrix.cols, std::numeric_limits<double>::infinity());
+    matrix.distances.assign(matrix.rows * matrix.cols, std::numeric_limits<double>::infinity());
+    std::vector<QueryWorkspace> workspaces(workers.size());
+
+    // Target side: the walking seeds of every target, or their upward search spaces in the hierarchy
+    std::vector<std::vector<std::pair<int, BucketEntry>>> reachedFrom(targets.size());
+    workers.parallelFor(targets.size(), 1, [&](const size_t begin, const size_t end, const unsigned worker) {
+        QueryWorkspace& workspace = workspaces[worker];
+        std::vector<int> reached;
+        for (size_t j = begin; j < end; j++) {
+            workspace.prepare(nodeCount);
+            priorityQueue seedQueue;
+            const auto seeds = findNodesWithinRadius(targets[j].x, targets[j].y, targets[j].R, seedQueue, workspace.backward);
+            reached.clear();
+            if (hierarchy.empty()) {
+                for (const auto& [node, distance] : seeds) reached.push_back(node);
+            } else {
+                hierarchy.upwardSearch(seeds, workspace.backward, reached);
+            }
+            for (const int node : reached) {
+                reachedFrom[j].push_back({node, {static_cast<uint32_t>(j), workspace.backward.time(node),
+                                                 workspace.backward.dist(node)}});
+            }
+        }
+    });
+
+    // Buckets per node, CSR style
+    std::vector<uint32_t> bucketStart(nodeCount + 1, 0);
+    for (const auto& entries : reachedFrom) {
+        for (const auto& [node, entry] : entries) bucketStart[node + 1]++;
+    }
+    size_t bucketNodes = 0;
+    for (size_t node = 0; node < nodeCount; node++) {
+        bucketNodes += bucketStart[node + 1] > 0;
+        bucketStart[node + 1] += bucketStart[node];
+    }
+    std::vector<BucketEntry> buckets(bucketStart.back());
+    {
+        std::vector<uint32_t> next(bucketStart.begin(), bucketStart.end() - 1);
+        for (auto& entries : reachedFrom) {
+            for (const auto& [node, entry] : entries) buckets[next[node]++] = entry;
+            entries = {};
+        }
+    }
+
+    // Source side: every node the search settles closes the targets waiting in its bucket
+    const auto scanBucket = [&](const int node, const SearchLabels& labels, const size_t row) {
+        for (uint32_t i = bucketStart[node]; i < bucketStart[node + 1]; i++) {
+            const BucketEntry& entry = buckets[i];
+            const size_t cell = row * matrix.cols + entry.target;
+            if (const double time = labels.time(node) + entry.time; time < matrix.times[cell]) {
+                matrix.times[cell] = time;
+                matrix.distances[cell] = labels.dist(node) + entry.distance;
+            }
+        }
+    };
+    const auto oneToAll = [&](const auto& weights, SearchLabels& labels, priorityQueue& queue, const size_t row) {
+        size_t open = bucketNodes;
+        while (!queue.empty() && open > 0) {
+            const auto [time, node] = queue.top();
+            queue.pop();
+            if (labels.settled(node)) continue;
+            labels.settle(node);
+            if (bucketStart[node] != bucketStart[node + 1]) {
+                scanBucket(node, labels, row);
+                open--;
+            }
+            for (uint32_t arc = graph.firstArc(node); arc < graph.lastArc(node); arc++) {
+                const int neighbor = graph.targets[arc];
+                if (const double newTime = time + toMinutes(weights[arc]); newTime < labels.time(neighbor)) {
+                    labels.set(neighbor, newTime, labels.dist(node) + graph.distance[arc], node);
+                    queue.emplace(newTime, neighbor);
+                }
+            }
+        }
+    };
+    workers.parallelFor(sources.size(), 1, [&](const size_t begin, const size_t end, const unsigned worker) {
+        QueryWorkspace& workspace = workspaces[worker];
+        std::vector<int> reached;
+        for (size_t i = begin; i < end; i++) {
+            workspace.prepare(nodeCount);
+            priorityQueue queue;
+            const auto seeds = findNodesWithinRadius(sources[i].x, sources[i].y, sources[i].R, queue, workspace.forward);
+            if (!hierarchy.empty()) {
+                hierarchy.upwardSearch(seeds, workspace.forward, reached);
+                for (const int node : reached) scanBucket(node, workspace.forward, i);
+            } else if (options.weightType == WeightType::Float) {
+                oneToAll(travelTimeFloat, workspace.forward, queue, i);
+            } else if (options.weightType == WeightType::FixedPoint) {
+                oneToAll(travelTimeFixed, workspace.forward, queue, i);
+            } else {
+                oneToAll(graph.travelTime, workspace.forward, queue, i);
+            }
+        }
+    });
+
+    if (stats) {
+        stats->threads = workers.size();
+        stats->queries = matrix.rows * matrix.cols;
+        stats->elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        stats->queriesPerSecond = stats->elapsedMs > 0 ? stats->queries * 1000.0 / stats->elapsedMs : 0;
+    }
+    return matrix;
+}
+
+bool MapGraph::loadMatrixPoints(const std::string& filename, std::vector<MatrixPoint>& points) {
+    MappedFile file;
+    if (!file.open(filename)) {
+        std::cerr << "Error opening points file: " << filename << std::endl;
+        return false;
+    }
+
+    points.clear();
+    TextScanner scanner(file.data(), file.data() + file.size());
+    int numPoints = 0;
+    if (!scanner.read(numPoints) || numPoints <= 0 || !scanner.canHold(numPoints, 3)) {
+        std::cerr << "Invalid number of points at " << scanner.location() << std::endl;
+        return false;
+    }
+    points.reserve(numPoints);
+    for (int i = 0; i < numPoints; i++) {
+        MatrixPoint point{};
+        if (!scanner.read(point.x) || !scanner.read(point.y) || !scanner.read(point.R)) {
+            std::cerr << "Error reading point data at index " << i << " (" << scanner.location() << ")" << std::endl;
+            return false;
+        }
+        point.R = std::max(point.R, 0.0) / 1000; // Convert to km
+        points.push_back(point);
+    }
+    return true;
+}
+
+Isochrone MapGraph::findReachableNodes(const double x, const double y, const double R, const double budget,
+                                       QueryWorkspace& workspace) const {
+    return snapshot()->findReachableNodes(x, y, R, budget, queueType, workspace);
+}
+
+Isochrone MapData::findReachableNodes(const double x, const double y, const double R, const double budget,
+                                      const QueueType queueType, QueryWorkspace& workspace) const {
+    workspace.prepare(nodePositions.size());
+    const auto seeds = findNodesWithinRadius(x, y, R, workspace.forward);
+
+    Isochrone isochrone;
+    const auto search = [&](const auto& weights) {
+        switch (queueType) {
+        case QueueType::QuadHeap:
+            return reachableKernel(budget, workspace.forward, seeds, weights, workspace.quadHeaps.forward, isochrone);
+        case QueueType::Radix:
+            return reachableKernel(budget, workspace.forward, seeds, weights, workspace.radixHeaps.forward, isochrone);
+        default:
+            return reachableKernel(budget, workspace.forward, seeds, weights, workspace.binaryHeaps.forward, isochrone);
+        }
+    };
+    switch (options.weightType) {
+    case WeightType::Float:
+        search(travelTimeFloat);
+        break;
+    case WeightType::FixedPoint:
+        search(travelTimeFixed);
+        break;
+    default:
+        search(graph.travelTime);
+    }
+    return isochrone;
+}
+
+template <typename Weight, typename Queue>
+void MapData::reachableKernel(const double budget, SearchLabels& labels, const std::vector<std::pair<int, double>>& seeds,
+                               const FlatArray<Weight>& weights, Queue& queue, Isochrone& isochrone) const {
+    queue.prepare(nodePositions.size());
+    for (const auto& [node, distance] : seeds) queue.push(labels.time(node), node);
+    // Keys come out in order, so the first one past the budget ends the search
+    while (!queue.empty() && queue.top().first <= budget) {
+        const auto [time, node] = queue.top();
+        queue.pop();
+        if (labels.settled(node)) continue;
+        labels.settle(node);
+        isochrone.nodes.push_back({node, time, labels.dist(node)});
+
+        for (uint32_t arc = graph.firstArc(node); arc < graph.lastArc(node); arc++) {
+            const int neighbor = graph.targets[arc];
+            if (const double newTime = time + toMinutes(weights[arc]); newTime < labels.time(neighbor)) {
+                labels.set(neighbor, newTime, labels.dist(node) + graph.distance[arc], node);
+                queue.push(newTime, neighbor);
+            }
+        }
+    }
+    isochrone.settledNodes = isochrone.nodes.size();
+}
+
+Isochrone MapGraph::findReachableNodesParallel(const double x, const double y, const double R, const double budget) {
+    return snapshot()->findReachableNodesParallel(x, y, R, budget, threadPool());
+}
+
+Isochrone MapData::findReachableNodesParallel(const double x, const double y, const double R, const double budget,
+                                              ThreadPool& pool) const {
+    QueryWorkspace workspace;
+    if (hierarchy.empty()) return findReachableNodes(x, y, R, budget, QueueType::Binary, workspace);
+
+    workspace.prepare(nodePositions.size());
+    priorityQueue seedQueue;
+    const auto seeds = findNodesWithinRadius(x, y, R, seedQueue, workspace.forward);
+    std::vector<int> reached;
+    hierarchy.upwardSearch(seeds, workspace.forward, reached);
+    hierarchy.downwardSweep(workspace.forward, pool);
+
+    Isochrone isochrone;
+    isochrone.settledNodes = graph.nodeCount();
+    for (int node = 0; node < static_cast<int>(graph.nodeCount()); node++) {
+        if (const double time = workspace.forward.time(node); time <= budget) {
+            isochrone.nodes.push_back({node, time, workspace.forward.dist(node)});
+        }
+    }
+    return isochrone;
+}
+
+ThreadPool& MapGraph::threadPool() {
+    std::lock_guard lock(poolMutex);
+    if (!pool) pool = std::make_unique<ThreadPool>(threadCount);
+    return *pool;
+}
+
+ThreadPool& MapGraph::builderPool() {
+    std::lock_guard lock(poolMutex);
+    if (!builders) builders = std::make_unique<ThreadPool>(threadCount);
+    return *builders;
+}
+
+void MapGraph::setWeightType(const WeightType type) {
+    updateOptions([type](MapOptions& options) { options.weightType = type; });
+}
+
+void MapGraph::setLandmarks(const unsigned count, const LandmarkSelection selection) {
+    updateOptions([count, selection](MapOptions& options) {
+        options.landmarkCount = count;
+        options.landmarkSelection = selection;
+    });
+}
+
+void MapGraph::setContractionHierarchy(const bool enabled) {
+    updateOptions([enabled](MapOptions& options) { options.hierarchy = enabled; });
+}
+
+void MapGraph::setMultilevelOverlay(const bool enabled) {
+    updateOptions([enabled](MapOptions& options) { options.overlay = enabled; });
+}
+
+void MapGraph::customizeOverlay() {
+    std::lock_guard lock(updateMutex);
+    publish(snapshot()->customizeOverlay(builderPool()));
+}
+
+std::shared_ptr<MapData> MapData::withSpeedProfiles(const std::vector<EdgeProfile>& edgeProfiles) const {
+    auto map = std::make_shared<MapData>(*this);
+    if (std::string error; !map->profiles.build(graph, edgeProfiles, error)) {
+        std::cerr << "Invalid speed profiles: " << error << std::endl;
+        return nullptr;
+    }
+    return map;
+}
+
+bool MapGraph::loadSpeedProfiles(const std::string& filename) {
+    MappedFile file;
+    if (!file.open(filename)) {
+        std::cerr << "Error opening speed profiles file: " << filename << std::endl;
+        return false;
+    }
+
+    TextScanner scanner(file.data(), file.data() + file.size());
+    int numProfiles = 0;
+    if (!scanner.read(numProfiles) || numProfiles < 0 || !scanner.canHold(numProfiles, 5)) {
+        std::cerr << "Invalid number of speed profiles at " << scanner.location() << std::endl;
+        return false;
+    }
+    std::vector<EdgeProfile> profiles(numProfiles);
+    for (auto& [from, to, points] : profiles) {
+        int count = 0;
+        if (!scanner.read(from) || !scanner.read(to) || !scanner.read(count) || count <= 0 || !scanner.canHold(count, 2)) {
+            std::cerr << "Error reading speed profile at " << scanner.location() << std::endl;
+            return false;
+        }
+        points.resize(count);
+        for (auto& [minute, factor] : points) {
+            if (!scanner.read(minute) || !scanner.read(factor)) {
+                std::cerr << "Error reading speed profile point at " << scanner.location() << std::endl;
+                return false;
+            }
+        }
+    }
+
+    return setSpeedProfiles(profiles);
+}
+
+bool MapGraph::setSpeedProfiles(const std::vector<EdgeProfile>& profiles) {
+    std::lock_guard lock(updateMutex);
+    std::shared_ptr<MapData> map = snapshot()->withSpeedProfiles(profiles);
+    if (!map) return false;
+    publish(std::move(map));
+    return true;
+}
+
+size_t MapGraph::updateSpeeds(const std::vector<SpeedUpdate>& updates) {
+    std::lock_guard lock(updateMutex);
+    size_t applied = 0;
+    publish(snapshot()->updateSpeeds(updates, builderPool(), applied));
+    return applied;
+}
+
+bool MapGraph::readSpeedUpdates(std::istream& in, const size_t maxCount, std::vector<SpeedUpdate>& updates) {
+    updates.clear();
+    SpeedUpdate update{};
+    while (updates.size() < maxCount && in >> update.from) {
+        if (!(in >> update.to >> update.speed)) {
+            std::cerr << "Error reading speed update " << updates.size() << " of the batch" << std::endl;
+            return false;
+        }
+        updates.push_back(update);
+    }
+    // A token that is not a number ends the stream as well, only a clean end of input is fine
+    if (updates.size() < maxCount && !in.eof()) {
+        std::cerr << "Error reading speed update " << updates.size() << " of the batch" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::shared_ptr<MapData> MapData::rebuild(const MapOptions& changed, ThreadPool& pool) const {
+    auto map = std::make_shared<MapData>(*this);
+    map->options = changed;
+    const bool weightsChanged = changed.weightType != options.weightType;
+    if (weightsChanged) map->buildReducedWeights();
+    if (weightsChanged || changed.landmarkCount != options.landmarkCount ||
+        changed.landmarkSelection != options.landmarkSelection) {
+        map->buildLandmarks(pool);
+    }
+    if (weightsChanged || changed.hierarchy != options.hierarchy) map->buildHierarchy();
+    if (changed.overlay != options.overlay) {
+        map->buildOverlay(pool);
+    } else if (weightsChanged) {
+        map->customizeCliques(pool);
+    }
+    return map;
+}
+
+std::shared_ptr<MapData> MapData::withHierarchy() const {
+    auto map = std::make_shared<MapData>(*this);
+    map->buildHierarchy();
+    return map;
+}
+
+std::shared_ptr<MapData> MapData::customizeOverlay(ThreadPool& pool) const {
+    auto map = std::make_shared<MapData>(*this);
+    map->customizeCliques(pool);
+    return map;
+}
+
+std::shared_ptr<MapData> MapData::updateSpeeds(const std::vector<SpeedUpdate>& updates, ThreadPool& pool,
+                                               size_t& applied) const {
+    auto map = std::make_shared<MapData>(*this);
+    if (map->arcSpeeds.empty()) {
+        for (const double speed : graph.speed) map->arcSpeeds[speed]++;
+    }
+    std::vector<double> speeds(graph.speed.begin(), graph.speed.end());
+    std::vector<double> minutes(graph.travelTime.begin(), graph.travelTime.end());
+    std::vector<uint32_t> changedArcs;
+    bool faster = false;
+    applied = 0;
+    const int nodeCount = static_cast<int>(graph.nodeCount());
+    for (const auto& [from, to, speed] : updates) {
+        if (from < 0 || from >= nodeCount || to < 0 || to >= nodeCount || !(speed > 0)) continue;
+        bool matched = false;
+        for (const auto& [tail, head] : {std::pair(from, to), std::pair(to, from)}) {
+            for (uint32_t arc = graph.firstArc(tail); arc < graph.lastArc(tail); arc++) {
+                if (graph.targets[arc] != head) continue;
+                matched = true;
+                if (--map->arcSpeeds[speeds[arc]] == 0) map->arcSpeeds.erase(speeds[arc]);
+                map->arcSpeeds[speed]++;
+                const double time = CsrGraph::travelMinutes(graph.distance[arc], speed);
+                faster = faster || time < minutes[arc];
+                speeds[arc] = speed;
+                minutes[arc] = time;
+                changedArcs.push_back(arc);
+            }
+        }
+        applied += matched;
+    }
+    if (changedArcs.empty()) return map;
+
+    map->graph.speed.assign(std::move(speeds));
+    map->graph.travelTime.assign(std::move(minutes));
+    map->max_speed = map->arcSpeeds.rbegin()->first;
+    map->patchReducedWeights(changedArcs);
+
+    if (faster && !landmarks.empty()) {
+        const auto start = std::chrono::high_resolution_clock::now();
+        const std::vector<double> reduced = map->reducedMinutes();
+        if (map->landmarks.refresh(map->graph, reduced.empty() ? map->graph.travelTime.data() : reduced.data(), changedArcs, pool)) {
+            map->loadStats.landmarkMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        }
+    }
+    // The shortcuts only hold for the old weights, MapGraph builds new ones off the update lock
+    map->hierarchy.clear();
+    map->loadStats.hierarchyMs = 0;
+    if (!overlay.empty()) map->customizeCliques(pool, changedArcs);
+    return map;
+}
+
+std::vector<double> MapData::reducedMinutes() const {
+    std::vector<double> minutes;
+    if (options.weightType == WeightType::Float) {
+        minutes.assign(travelTimeFloat.begin(), travelTimeFloat.end());
+    } else if (options.weightType == WeightType::FixedPoint) {
+        minutes.reserve(travelTimeFixed.size());
+        for (const uint32_t weight : travelTimeFixed) minutes.push_back(toMinutes(weight));
+    }
+    return minutes;
+}
+
+void MapData::buildHierarchy() {
+    const auto start = std::chrono::high_resolution_clock::now();
+    hierarchy.clear();
+    loadStats.hierarchyMs = 0;
+    if (!options.hierarchy || empty()) return;
+
+    const std::vector<double> reduced = reducedMinutes();
+    hierarchy.build(graph, reduced.empty() ? graph.travelTime.data() : reduced.data());
+    loadStats.hierarchyMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void MapData::buildOverlay(ThreadPool& pool) {
+    const auto start = std::chrono::high_resolution_clock::now();
+    overlay.clear();
+    loadStats.partitionMs = 0;
+    loadStats.overlayLevels = loadStats.overlayDroppedLevels = 0;
+    if (!options.overlay || empty()) {
+        loadStats.customizeMs = 0;
+        return;
+    }
+
+    overlay.partition(graph, nodePositions, pool);
+    loadStats.partitionMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    const MultilevelOverlay::Stats overlayStats = overlay.stats();
+    loadStats.overlayLevels = overlayStats.levels;
+    loadStats.overlayDroppedLevels = overlayStats.droppedLevels;
+    customizeCliques(pool);
+}
+
+void MapData::customizeCliques(ThreadPool& pool) {
+    const auto start = std::chrono::high_resolution_clock::now();
+    if (overlay.empty()) return;
+
+    overlayMinutes.assign(reducedMinutes());
+    overlay.customize(graph, overlayMinutes.empty() ? graph.travelTime.data() : overlayMinutes.data(), pool);
+    loadStats.customizeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void MapData::customizeCliques(ThreadPool& pool, const std::vector<uint32_t>& arcs) {
+    const auto start = std::chrono::high_resolution_clock::now();
+    if (overlay.empty()) return;
+
+    if (!overlayMinutes.empty()) {
+        std::vector<double> minutes(overlayMinutes.begin(), overlayMinutes.end());
+        for (const uint32_t arc : arcs) {
+            minutes[arc] = options.weightType == WeightType::Float ? travelTimeFloat[arc] : toMinutes(travelTimeFixed[arc]);
+        }
+        overlayMinutes.assign(std::move(minutes));
+    }
+    std::vector<int> nodes;
+    for (const uint32_t arc : arcs) {
+        nodes.push_back(graph.arcTail(arc));
+        nodes.push_back(graph.targets[arc]);
+    }
+    overlay.customize(graph, overlayMinutes.empty() ? graph.travelTime.data() : overlayMinutes.data(), nodes, pool);
+    loadStats.customizeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void MapData::buildLandmarks(ThreadPool& pool) {
+    const auto start = std::chrono::high_resolution_clock::now();
+    landmarks.clear();
+    loadStats.landmarkMs = 0;
+    if (options.landmarkCount == 0 || empty()) return;
+
+    // The bounds must hold for the weights the search adds up
+    const std::vector<double> reduced = reducedMinutes();
+    landmarks.build(graph, reduced.empty() ? graph.travelTime.data() : reduced.data(), options.landmarkCount,
+                    options.landmarkSelection, pool);
+    loadStats.landmarkMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void MapData::buildReducedWeights() {
+    travelTimeFloat.clear();
+    travelTimeFixed.clear();
+    if (options.weightType == WeightType::Float) {
+        travelTimeFloat.assign(std::vector<float>(graph.travelTime.begin(), graph.travelTime.end()));
+    } else if (options.weightType == WeightType::FixedPoint) {
+        std::vector<uint32_t> fixed(graph.arcCount());
+        for (size_t arc = 0; arc < fixed.size(); arc++) fixed[arc] = toFixedPoint(graph.travelTime[arc]);
+        travelTimeFixed.assign(std::move(fixed));
+    }
+
+    if (options.weightType == WeightType::Float) {
+        potentialScale = computePotentialScale(graph, nodePositions, travelTimeFloat, max_speed);
+    } else if (options.weightType == WeightType::FixedPoint) {
+        potentialScale = computePotentialScale(graph, nodePositions, travelTimeFixed, max_speed);
+    } else {
+        potentialScale = computePotentialScale(graph, nodePositions, graph.travelTime, max_speed);
+    }
+}
+
+void MapData::patchReducedWeights(const std::vector<uint32_t>& arcs) {
+    const auto lowerScale = [&](const uint32_t arc, const double minutes) {
+        // Same bound as computePotentialScale, a faster arc may lower it
+        const auto& [x, y] = nodePositions[graph.arcTail(arc)];
+        const auto& [targetX, targetY] = nodePositions[graph.targets[arc]];
+        const double length = std::sqrt((targetX - x) * (targetX - x) + (targetY - y) * (targetY - y));
+        if (length > 0) potentialScale = std::min(potentialScale, minutes / length * (1 - 1e-9));
+    };
+    if (options.weightType == WeightType::Float) {
+        std::vector<float> reduced(travelTimeFloat.begin(), travelTimeFloat.end());
+        for (const uint32_t arc : arcs) {
+            reduced[arc] = static_cast<float>(graph.travelTime[arc]);
+            lowerScale(arc, reduced[arc]);
+        }
+        travelTimeFloat.assign(std::move(reduced));
+    } else if (options.weightType == WeightType::FixedPoint) {
+        std::vector<uint32_t> reduced(travelTimeFixed.begin(), travelTimeFixed.end());
+        for (const uint32_t arc : arcs) {
+            reduced[arc] = toFixedPoint(graph.travelTime[arc]);
+            lowerScale(arc, toMinutes(reduced[arc]));
+        }
+        travelTimeFixed.assign(std::move(reduced));
+    } else {
+        for (const uint32_t arc : arcs) lowerScale(arc, graph.travelTime[arc]);
+    }
+    potentialScale = std::min(potentialScale, 60.0 / max_speed * (1 - 1e-9));
+}
+
+void MapGraph::setThreadCount(const unsigned threads) {
+    if (threads == threadCount && pool) return;
+    threadCount = threads;
+    pool.reset();
+    builders.reset();
+}
+
+unsigned MapGraph::getThreadCount() {
+    return threadPool().size();
+}
+
 std::string MapGraph::displayOutput(const std::vector<PathResult> &results) const {
 
     std::stringstream result;
@@ -338,24 +1950,109 @@ std::string MapGraph::displayOutput(const std::vector<PathResult> &results) cons
     return result.str();
 }
 
-inline std::vector<std::pair<int, double>> MapGraph::findNodesWithinRadius(const double x, const double y, const double R,
-    priorityQueue& pq, std::vector<double>& time, std::vector<double>& dist) const {
+std::vector<std::pair<int, double>> MapData::findNodesWithinRadius(const double x, const double y, const double R,
+    priorityQueue& pq, SearchLabels& labels) const {
+    std::vector<std::pair<int, double>> result = findNodesWithinRadius(x, y, R, labels);
+    for (const auto& [node, distance] : result) pq.emplace(labels.time(node), node);
+    return result;
+}
+
+std::vector<std::pair<int, double>> MapData::findNodesWithinRadius(const double x, const double y, const double R,
+    SearchLabels& labels) const {
     std::vector<std::pair<int, double>> result;
-    for (int i = 0; i < nodePositions.size(); ++i) {
-        if (double distance = calculateDistance(x, y, nodePositions[i].first, nodePositions[i].second); distance <= R) {
-            time[i] = (distance / 5.0) * 60.0;
-            dist[i] = distance;
-            pq.emplace(time[i], i);
-            result.emplace_back(i, distance);
-        }
-    }
+    spatialIndex.forEachWithin(x, y, R, [&](const int node, const double distance) {
+        labels.set(node, (distance / 5.0) * 60.0, distance, -1);
+        result.emplace_back(node, distance);
+    });
     return result;
 }
 
-double MapGraph::calculateDistance(const double x1, const double y1, const double x2, const double y2) {
+std::string MapData::resultKey(const double startX, const double startY, const double endX, const double endY,
+                               const double R, const SearchAlgorithm algorithm, const QueueType queueType,
+                               SeedWalks& walks, const double departure) const {
+    // Departures only matter to maps with profiles, the static answer is the same for all
+    const double moment = departure >= 0 && !profiles.empty() ? departure : -1;
+    std::string key;
+    const auto append = [&key](const auto value) { key.append(reinterpret_cast<const char*>(&value), sizeof(value)); };
+    append(R);
+    append(static_cast<uint8_t>(algorithm));
+    append(static_cast<uint8_t>(queueType));
+    append(moment);
+
+    // The grid reports the candidates cell by cell, sorting makes the order independent of the point
+    for (auto [x, y, candidates] : {std::tuple(startX, startY, &walks.start), std::tuple(endX, endY, &walks.end)}) {
+        candidates->clear();
+        spatialIndex.forEachWithin(x, y, R, [&](const int node, const double distance) { candidates->emplace_back(node, distance); });
+        std::sort(candidates->begin(), candidates->end());
+        append(static_cast<uint32_t>(candidates->size()));
+        for (const auto& candidate : *candidates) append(candidate.first);
+    }
+    return key;
+}
+
+bool MapData::reuseResult(const CachedPath& cached, const SeedWalks& walks, const double departure,
+                          PathResult& result) const {
+    // The same walks, or no path at all: unreachable ends and disconnected seed sets do not depend on them
+    if ((cached.walks.start == walks.start && cached.walks.end == walks.end) || cached.result.path.empty()) {
+        result = cached.result;
+        return true;
+    }
+    if (departure >= 0 && !profiles.empty()) return false;
+
+    // Every total changes by the extra walking of its two seeds, so the cached pair stays
+    // the best one if its extra walking is the least on both ends together
+    const auto change = [](const std::vector<std::pair<int, double>>& before, const std::vector<std::pair<int, double>>& after,
+                           const int chosen, double& least, double& chosenChange) {
+        least = std::numeric_limits<double>::infinity();
+        chosenChange = std::numeric_limits<double>::quiet_NaN();
+        for (size_t i = 0; i < after.size(); i++) {
+            const double extra = after[i].second - before[i].second;
+            least = std::min(least, extra);
+            if (after[i].first == chosen) chosenChange = extra;
+        }
+    };
+    double leastStart, leastEnd, startChange, endChange;
+    change(cached.walks.start, walks.start, cached.result.path.front(), leastStart, startChange);
+    change(cached.walks.end, walks.end, cached.result.path.back(), leastEnd, endChange);
+    if (!(startChange + endChange <= leastStart + leastEnd)) return false;
+
+    // The road part and its vehicle distance stay, walking is at 5 km/h like the seeds of the search
+    const double startWalk = walkTo(walks.start, cached.result.path.front());
+    const double endWalk = walkTo(walks.end, cached.result.path.back());
+    const double walkingDistance = startWalk + endWalk;
+    const double totalDistance = walkingDistance + cached.roadDistance;
+    const double travelTime = (startWalk / 5.0) * 60.0 + cached.roadTime + (endWalk / 5.0) * 60.0;
+    // The search adds the same numbers in another order, which can round the other way right at
+    // a boundary of the printed hundredths; such answers are searched again
+    const auto nearBoundary = [](const double value) {
+        const double hundredths = value * 100;
+        return std::fabs(hundredths - std::floor(hundredths) - 0.5) < 1e-6;
+    };
+    if (nearBoundary(travelTime) || nearBoundary(totalDistance) || nearBoundary(cached.roadDistance)) return false;
+
+    result = cached.result;
+    result.walkingDistance = walkingDistance;
+    result.totalDistance = totalDistance;
+    result.travelTime = travelTime;
+    formatResult(result);
+    return true;
+}
+
+double MapData::calculateDistance(const double x1, const double y1, const double x2, const double y2) {
     return std::sqrt(std::pow(x2 - x1, 2) + std::pow(y2 - y1, 2));
 }
 
 void MapGraph::clearLastPath() {
+    std::lock_guard lock(lastPathMutex);
     lastPath.clear();
+}
+
+std::vector<int> MapGraph::getLastPath() const {
+    std::lock_guard lock(lastPathMutex);
+    return lastPath;
+}
+
+void MapGraph::setLastPath(const std::vector<int>& path) {
+    std::lock_guard lock(lastPathMutex);
+    lastPath = path;
 }
\ No newline at end of file
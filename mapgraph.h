@@ -1,10 +1,25 @@
 #ifndef MAPGRAPH_H
 #define MAPGRAPH_H
 
-#include <qtclasshelpermacros.h>
+#include <atomic>
+#include <functional>
+#include <future>
+#include <iosfwd>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <string>
 #include <queue>
+#include "contractionhierarchy.h"
+#include "csrgraph.h"
+#include "flatarray.h"
+#include "landmarks.h"
+#include "multileveloverlay.h"
+#include "queryworkspace.h"
+#include "resultcache.h"
+#include "spatialgrid.h"
+#include "speedprofiles.h"
 #define priorityQueue std::priority_queue<std::pair<double, int>, std::vector<std::pair<double, int>>, std::greater<>>
 
 struct Node {
@@ -25,6 +40,63 @@ struct Query {
     double R;
 };
 
+// Origin or destination of a travel-time matrix, R in km as in Query
+struct MatrixPoint {
+    double x, y;
+    double R;
+};
+
+// New speed of the road between two nodes, applied to both directions
+struct SpeedUpdate {
+    int from;
+    int to;
+    double speed; // km/h
+};
+
+// Sources x targets, row major. Both include the walks at either end like PathResult;
+// infinity where no path exists or a point has no node within R.
+struct TravelMatrix {
+    size_t rows = 0;
+    size_t cols = 0;
+    std::vector<double> times;     // minutes
+    std::vector<double> distances; // km
+
+    [[nodiscard]] double time(const size_t row, const size_t col) const { return times[row * cols + col]; }
+    [[nodiscard]] double distance(const size_t row, const size_t col) const { return distances[row * cols + col]; }
+};
+
+// Node reached by a one-to-all search, time and distance include the walk to the first node
+struct ReachedNode {
+    int node;
+    double time;     // minutes
+    double distance; // km
+};
+
+// Nodes reachable within a time budget
+struct Isochrone {
+    std::vector<ReachedNode> nodes; // settle order for Dijkstra, node order for PHAST
+    size_t settledNodes = 0;        // labels the search finalized
+};
+
+// Work and phase times of one findShortestPath call, both search directions together
+struct QueryStats {
+    size_t startCandidates = 0; // nodes within R of the start
+    size_t endCandidates = 0;
+    size_t settledNodes = 0;
+    size_t relaxedArcs = 0; // arcs scanned from settled nodes, clique entries included
+    size_t queuePushes = 0;
+    size_t queuePops = 0;   // stale entries of lazy queues included
+    double snapMs = 0;      // walking-radius lookups and label reset
+    double searchMs = 0;    // everything not in another phase
+    double pathMs = 0;      // path reconstruction and unpacking
+    double formatMs = 0;    // resultText
+    double totalMs = 0;
+    bool cacheHit = false;  // answered from the result cache, the work counters are zero
+    // Answered by a one-to-many search shared with other queries from the same start. The work
+    // counters of that search are on the first of them, the phase times are split evenly.
+    bool sharedSearch = false;
+};
+
 struct PathResult {
     std::vector<int> path;
     double travelTime;
@@ -32,8 +104,293 @@ struct PathResult {
     double walkingDistance;
     double vehicleDistance;
     std::string resultText;
+    QueryStats stats;
+};
+
+// Walking distances in km to the candidate nodes of a MapData::resultKey, sorted by node
+struct SeedWalks {
+    std::vector<std::pair<int, double>> start;
+    std::vector<std::pair<int, double>> end;
+};
+
+// Result cache entry: an answer, the walks it was searched with and its road part, which
+// MapData::reuseResult adds to other walks
+struct CachedPath {
+    PathResult result;
+    SeedWalks walks;
+    double roadTime = 0;     // minutes
+    double roadDistance = 0; // km
+
+    CachedPath() = default;
+    CachedPath(PathResult result, SeedWalks walks);
+};
+
+// Point-to-point search run by findShortestPath
+enum class SearchAlgorithm {
+    Dijkstra, // bidirectional Dijkstra
+    AStar,    // bidirectional A*, straight-line distance over the top speed as potential
+    Alt,      // bidirectional A* on landmark bounds, runs as AStar while no landmarks are built
+    Ch,       // upward search in the contraction hierarchy, runs as Dijkstra while none is built
+    Overlay,  // bidirectional Dijkstra over the multilevel overlay, runs as Dijkstra while none is built
+};
+
+// Arc weight representation read by the search kernel. The reduced ones halve
+// the weight stream at the cost of precision in the reported travel time.
+enum class WeightType {
+    Double,     // exact minutes
+    Float,      // 32-bit float minutes
+    FixedPoint, // unsigned thousandths of a minute
+};
+
+// Priority queue of the Dijkstra kernels, see searchqueue.h
+enum class QueueType {
+    Binary,   // binary heap with lazy deletion
+    QuadHeap, // indexed 4-ary heap with decrease-key
+    Radix,    // monotone radix heap on the bits of the travel times
+};
+
+// Timings of the last loadMapFromFile call
+struct LoadStats {
+    double parseMs = 0;
+    double indexMs = 0;
+    double landmarkMs = 0;
+    double hierarchyMs = 0;
+    double partitionMs = 0;
+    double customizeMs = 0; // last overlay customization, also set by customizeOverlay
+    unsigned overlayLevels = 0;
+    unsigned overlayDroppedLevels = 0; // overlay levels left out, their cells had too many boundary nodes
+};
+
+// Order runQueries works through a batch in, the results always keep the input order
+enum class BatchOrder {
+    Input,   // as given
+    Hilbert, // along a Hilbert curve over the start points, then the end points
+};
+
+// Batch execution knobs
+struct BatchOptions {
+    size_t chunkSize = 4; // queries per stealable task
+    BatchOrder order = BatchOrder::Input;
+    // Queries with the same start point and R are answered by one MapData::findShortestPaths
+    // search. Only with SearchAlgorithm::Dijkstra and static speeds, the other engines answer
+    // single queries faster than a search that settles everything up to the farthest target.
+    // Opt-in: on the rare query whose best path is a walk through one node the bidirectional
+    // kernel can settle for a slower meeting node, so an answer would depend on its batch.
+    bool shareOrigins = false;
+    double departure = -1; // minutes after midnight for the speed profiles, negative = static speeds
+    std::function<void(size_t completed)> onProgress; // called from worker threads
+    // Stops the batch early; the queries it did not reach keep an empty resultText
+    const std::atomic_bool* cancel = nullptr;
+};
+
+// Nearest-rank percentiles of one per-query measure
+struct Percentiles {
+    double p50 = 0;
+    double p95 = 0;
+    double p99 = 0;
+
+    static Percentiles of(std::vector<double> values);
+};
+
+struct BatchStats {
+    unsigned threads = 0;
+    size_t queries = 0;
+    double elapsedMs = 0;
+    double queriesPerSecond = 0;
+
+    // Distributions of the QueryStats over the answered queries (runQueries only)
+    Percentiles totalMs;
+    Percentiles snapMs;
+    Percentiles searchMs;
+    Percentiles pathMs;
+    Percentiles formatMs;
+    Percentiles candidates; // start plus end
+    Percentiles settledNodes;
+    Percentiles relaxedArcs;
+    Percentiles queuePushes;
+    Percentiles queuePops;
+    size_t cacheHits = 0; // queries answered from the result cache
+};
+
+// Preprocessing a map is built with, MapData::getOptions() tells what a loaded map has
+struct MapOptions {
+    WeightType weightType = WeightType::Double;
+    unsigned landmarkCount = 0; // landmarks for SearchAlgorithm::Alt, 0 = none
+    LandmarkSelection landmarkSelection = LandmarkSelection::Avoid;
+    bool hierarchy = false; // contraction hierarchy for SearchAlgorithm::Ch
+    bool overlay = false;   // multilevel overlay for SearchAlgorithm::Overlay
+};
+
+class MappedFile;
+class ThreadPool;
+
+// One loaded map: the graph, its indexes and its preprocessing. It never changes
+// once MapGraph has published it, so any number of threads can query it; a reload
+// or a settings change builds a new one instead.
+class MapData {
+public:
+    MapData();
+    ~MapData();
+
+    // Accepts the text format and binary snapshots written by saveSnapshot, nullptr on errors.
+    // Tables stored in a snapshot are used when they match options, landmarkCount 0 then adopts
+    // the stored landmarks and a stored hierarchy is always kept.
+    static std::shared_ptr<MapData> load(const std::string& filename, const MapOptions& options, ThreadPool& pool);
+    // Copy built for other options, only the parts that depend on a changed option are redone
+    [[nodiscard]] std::shared_ptr<MapData> rebuild(const MapOptions& options, ThreadPool& pool) const;
+    // Copy with the overlay cliques recomputed from the arc weights, keeping the partition
+    [[nodiscard]] std::shared_ptr<MapData> customizeOverlay(ThreadPool& pool) const;
+    // Copy with daily speed profiles on the given roads (replacing any loaded before), the
+    // other roads keep their speed all day. nullptr on an unknown road or a malformed profile.
+    [[nodiscard]] std::shared_ptr<MapData> withSpeedProfiles(const std::vector<EdgeProfile>& profiles) const;
+    // Copy with new speeds on every arc between the two nodes of each update; only the per-arc
+    // arrays are copied, the rest is shared with this map. The overlay cells around the changed
+    // roads are customized again, and a landmark is recomputed when a faster road breaks its
+    // bounds (slower roads keep them valid). The hierarchy only holds for the weights it was
+    // built on and takes seconds to build again, so the copy drops it (see hierarchyPending).
+    // applied counts the updates that matched a road.
+    [[nodiscard]] std::shared_ptr<MapData> updateSpeeds(const std::vector<SpeedUpdate>& updates, ThreadPool& pool,
+                                                        size_t& applied) const;
+    // True while the hierarchy is enabled but not built for the current weights; hierarchy
+    // queries then run on the other kernels
+    [[nodiscard]] bool hierarchyPending() const { return options.hierarchy && hierarchy.empty() && !empty(); }
+    // Copy with the hierarchy built for the current weights
+    [[nodiscard]] std::shared_ptr<MapData> withHierarchy() const;
+    bool saveSnapshot(const std::string& filename) const;
+
+    [[nodiscard]] bool empty() const;
+    [[nodiscard]] const MapOptions& getOptions() const { return options; }
+    // Number MapGraph gave this map when it was published, 0 before
+    [[nodiscard]] uint64_t getEpoch() const { return epoch; }
+
+    // departure (minutes after midnight) runs the time-dependent search over the speed
+    // profiles: A* for AStar and Alt, Dijkstra otherwise, since the other engines are built
+    // for static weights. Negative, or no profiles loaded, runs the static search.
+    PathResult findShortestPath(double startX, double startY, double endX, double endY, double R, SearchAlgorithm algorithm,
+                                QueueType queueType, QueryWorkspace& workspace, double departure = -1) const;
+    // Paths from one start to every end point with the same R, results[j] answers ends[j] like
+    // findShortestPath with Dijkstra: a single forward search from the start's walking seeds that
+    // stops once no unsettled node can improve the answer of any end. Empty when cancel was set
+    // during the search.
+    std::vector<PathResult> findShortestPaths(double startX, double startY, double R,
+                                              const std::vector<std::pair<double, double>>& ends, QueueType queueType,
+                                              QueryWorkspace& workspace, const std::atomic_bool* cancel = nullptr) const;
+    TravelMatrix travelMatrix(const std::vector<MatrixPoint>& sources, const std::vector<MatrixPoint>& targets,
+                              ThreadPool& pool, BatchStats* stats = nullptr) const;
+    Isochrone findReachableNodes(double x, double y, double R, double budget, QueueType queueType,
+                                 QueryWorkspace& workspace) const;
+    Isochrone findReachableNodesParallel(double x, double y, double R, double budget, ThreadPool& pool) const;
+
+    std::vector<std::pair<int, double>> findNodesWithinRadius(double x, double y, double R, priorityQueue &pq, SearchLabels &labels) const;
+    // Labels the nodes within R like the overload above without queueing them
+    std::vector<std::pair<int, double>> findNodesWithinRadius(double x, double y, double R, SearchLabels &labels) const;
+    // What the road part of findShortestPath's answer depends on besides the map: R, the
+    // candidate nodes on both ends by id and the search settings that can change which of
+    // several equal paths is returned. The walks to the candidates are left out of the key
+    // and returned in walks, reuseResult adapts a cached answer to them.
+    [[nodiscard]] std::string resultKey(double startX, double startY, double endX, double endY, double R,
+                                        SearchAlgorithm algorithm, QueueType queueType, SeedWalks& walks,
+                                        double departure = -1) const;
+    // Answers from cached when its road part is still optimal for walks: the chosen pair of
+    // seeds must gain the least walking of any pair, then only its walking legs change. False
+    // when the search has to run again, always the case for other walks under time-dependent
+    // speeds, where walking longer shifts the road times as well.
+    bool reuseResult(const CachedPath& cached, const SeedWalks& walks, double departure, PathResult& result) const;
+
+    [[nodiscard]] const FlatArray<std::pair<double, double>>& getNodes() const {return nodePositions;}
+    [[nodiscard]] const FlatArray<std::pair<int,int>>& getEdges() const {return edges;}
+    [[nodiscard]] const SpatialGrid& getSpatialIndex() const { return spatialIndex; }
+    [[nodiscard]] const LoadStats& getLoadStats() const { return loadStats; }
+    [[nodiscard]] const Landmarks& getLandmarks() const { return landmarks; }
+    [[nodiscard]] const ContractionHierarchy& getContractionHierarchy() const { return hierarchy; }
+    [[nodiscard]] const MultilevelOverlay& getMultilevelOverlay() const { return overlay; }
+    [[nodiscard]] const SpeedProfiles& getSpeedProfiles() const { return profiles; }
+
+private:
+    friend class MapGraph; // sets epoch when publishing
+
+    MapOptions options;
+    uint64_t epoch = 0;
+    CsrGraph graph; // Both directions of every road, see csrgraph.h
+
+    // Reduced copies of graph.travelTime, only filled for options.weightType
+    FlatArray<float> travelTimeFloat;
+    FlatArray<uint32_t> travelTimeFixed;
+    double max_speed{};
+    std::map<double, size_t> arcSpeeds; // arcs per speed, counted by the first update so max_speed follows them
+
+    // Minutes per unit of straight-line distance that no arc undercuts, the A* potential factor
+    double potentialScale = 0;
+
+    // Tables built over the arc weights of options.weightType
+    Landmarks landmarks;
+    ContractionHierarchy hierarchy;
+
+    // The partition only depends on the roads, the cliques on the weights of options.weightType
+    MultilevelOverlay overlay;
+    FlatArray<double> overlayMinutes; // reducedMinutes() the cliques were built from
+
+    // Time-dependent factors on the base speeds, only read by searches with a departure time
+    SpeedProfiles profiles;
+
+    // For faster lookups
+    FlatArray<std::pair<int,int>> edges;
+    FlatArray<std::pair<double, double>> nodePositions; // node id -> (x, y)
+    SpatialGrid spatialIndex; // Answers the walking-radius lookups
+    LoadStats loadStats;
+
+    // Backing storage of the arrays above (and the CSR graph) when the map came from a snapshot
+    std::shared_ptr<const MappedFile> snapshotFile;
+
+    // Helper methods
+    bool loadText(const MappedFile& file, ThreadPool& pool);
+    bool loadSnapshot(std::shared_ptr<MappedFile> file, ThreadPool& pool);
+    void buildReducedWeights();
+    // Brings the reduced weights and the A* potential factor up to date with changed arcs
+    void patchReducedWeights(const std::vector<uint32_t>& arcs);
+    void buildLandmarks(ThreadPool& pool);
+    void buildHierarchy();
+    void buildOverlay(ThreadPool& pool);
+    void customizeCliques(ThreadPool& pool);
+    // Customizes only the overlay cells around arcs whose weights changed
+    void customizeCliques(ThreadPool& pool, const std::vector<uint32_t>& arcs);
+    [[nodiscard]] std::vector<double> reducedMinutes() const; // empty for Double, use graph.travelTime
+    PathResult runKernel(double startX, double startY, double endX, double endY, double R, SearchAlgorithm algorithm,
+                         QueueType queueType, QueryWorkspace& workspace) const;
+    template <typename Weight, typename Queue>
+    PathResult dijkstraKernel(double startX, double startY, double endX, double endY, double R, QueryWorkspace& workspace,
+                              const FlatArray<Weight>& weights, QueuePair<Queue>& queues) const;
+    // False when cancel was set before the search finished
+    template <typename Weight, typename Queue>
+    bool oneToManyKernel(double startX, double startY, double R, const std::vector<std::pair<double, double>>& ends,
+                         QueryWorkspace& workspace, const FlatArray<Weight>& weights, Queue& queue,
+                         const std::atomic_bool* cancel, std::vector<PathResult>& results) const;
+    template <typename Weight>
+    PathResult astarKernel(double startX, double startY, double endX, double endY, double R, QueryWorkspace& workspace,
+                           const FlatArray<Weight>& weights, SearchAlgorithm algorithm) const;
+    // Forward search from the start seeds with arcs timed at the moment they are entered, until
+    // no label can beat the best end seed. potential(node) bounds the minutes left to the end.
+    template <typename Potential>
+    PathResult timeDependentKernel(double startX, double startY, double endX, double endY, double R, double departure,
+                                   QueryWorkspace& workspace, const Potential& potential) const;
+    template <typename Weight, typename Queue>
+    void reachableKernel(double budget, SearchLabels& labels, const std::vector<std::pair<int, double>>& seeds,
+                         const FlatArray<Weight>& weights, Queue& queue, Isochrone& isochrone) const;
+    template <typename Weight, typename Potential>
+    void astarSearch(QueryWorkspace& workspace, const FlatArray<Weight>& weights,
+                     const std::vector<std::pair<int, double>>& startNodes, const std::vector<std::pair<int, double>>& endNodes,
+                     const Potential& potential, PathResult& result) const;
+    // Runs the preprocessed engine of algorithm (Ch or Overlay) between the walking-radius seeds
+    PathResult engineKernel(double startX, double startY, double endX, double endY, double R, QueryWorkspace& workspace,
+                            SearchAlgorithm algorithm) const;
+    void buildResult(int meetingNode, const QueryWorkspace& workspace, PathResult& result) const;
+    static void formatResult(PathResult& result);
+    static double calculateDistance(double x1, double y1, double x2, double y2) ;
 };
 
+// Holds the current MapData and swaps in a new one on every reload or settings
+// change. Each query pins the map it started on, so reloads never wait for
+// running queries and the old map is freed when its last query finishes.
 class MapGraph {
 public:
     // Singleton
@@ -43,40 +400,152 @@ public:
     ~MapGraph();
     void clearLastPath();
 
+    // The current map. Its nodes, roads, index and preprocessing are read through this
+    // pointer, which keeps them alive while another thread swaps in a new map; hold it
+    // for as long as the references it hands out are used.
+    [[nodiscard]] std::shared_ptr<const MapData> snapshot() const;
+
     [[nodiscard]] bool empty() const;
+    // Builds the new map next to the current one and swaps it in, from any thread. On errors
+    // the current map stays.
     bool loadMapFromFile(const std::string& filename);
+    bool saveSnapshot(const std::string& filename) const;
     bool loadQueriesFromFile(const std::string& filename);
-    PathResult findShortestPath(double startX, double startY, double endX, double endY, double R);
-    [[nodiscard]] std::string displayOutput(const std::vector<PathResult> &results) const;
+    PathResult findShortestPath(double startX, double startY, double endX, double endY, double R) const;
+    PathResult findShortestPath(double startX, double startY, double endX, double endY, double R, QueryWorkspace& workspace) const;
+    PathResult findShortestPath(double startX, double startY, double endX, double endY, double R, SearchAlgorithm algorithm,
+                                QueryWorkspace& workspace) const;
+    // Leaving at departure minutes after midnight, see MapData::findShortestPath
+    PathResult findShortestPath(double startX, double startY, double endX, double endY, double R, double departure,
+                                QueryWorkspace& workspace) const;
+
+    // Runs a batch on the thread pool, results[i] answers batch[i]. The whole batch runs on
+    // the map that was current when it started.
+    std::vector<PathResult> runQueries(const std::vector<Query>& batch, const BatchOptions& options = {}, BatchStats* stats = nullptr);
+    // Indexes of batch sorted so that queries starting close together are next to each other,
+    // and among those the ones ending close together. Each worker of runQueries then takes a
+    // run of neighbouring queries, whose searches touch the same part of the graph.
+    static std::vector<size_t> localityOrder(const std::vector<Query>& batch);
+    // Not thread-safe against running batches, set it between them
+    void setThreadCount(unsigned threads); // 0 = one per hardware thread
+    [[nodiscard]] unsigned getThreadCount(); // worker threads of the pool, starts it if needed
+
+    // Travel times between every source and target on the thread pool. With a contraction
+    // hierarchy built it runs the bucket many-to-many search, otherwise one Dijkstra per
+    // source until every target is settled. stats->queries counts the matrix cells.
+    TravelMatrix travelMatrix(const std::vector<MatrixPoint>& sources, const std::vector<MatrixPoint>& targets,
+                              BatchStats* stats = nullptr);
+    // "count" then "x y R" lines, R in metres like the query files
+    static bool loadMatrixPoints(const std::string& filename, std::vector<MatrixPoint>& points);
+
+    // Every node reachable from (x, y) within budget minutes, walking at most R km to the first
+    // node: the forward half of findShortestPath's Dijkstra, stopped at the budget.
+    Isochrone findReachableNodes(double x, double y, double R, double budget, QueryWorkspace& workspace) const;
+    // Same set from a PHAST sweep over the contraction hierarchy, large sweep levels split across
+    // the thread pool. It touches every node whatever the budget, so it only pays off when the
+    // budget covers much of the map. Runs findReachableNodes while no hierarchy is built.
+    Isochrone findReachableNodesParallel(double x, double y, double R, double budget);
+
+    // The setters below rebuild what depends on them into a new map and swap it in like
+    // loadMapFromFile, so they are safe while queries run.
+    void setWeightType(WeightType type);
+    [[nodiscard]] WeightType getWeightType() const { return snapshot()->getOptions().weightType; }
+    // Used by the overloads without an algorithm argument
+    void setSearchAlgorithm(const SearchAlgorithm algorithm) { searchAlgorithm = algorithm; }
+    [[nodiscard]] SearchAlgorithm getSearchAlgorithm() const { return searchAlgorithm; }
+    // Queue of the Dijkstra kernels (point-to-point and findReachableNodes)
+    void setQueueType(const QueueType type) { queueType = type; }
+    [[nodiscard]] QueueType getQueueType() const { return queueType; }
 
-    std::vector<std::pair<int, double>> findNodesWithinRadius(double x, double y, double R, std::priority_queue<std::pair<double, int>, std::vector<std::
-                                                              pair<double, int>>, std::greater<>> &pq, std::vector<double> &time, std::vector<double> &dist) const;
+    // Landmarks for SearchAlgorithm::Alt, built at load time (0 = none). Tables stored in a
+    // snapshot are used as they are when they match, count 0 then adopts the stored ones.
+    void setLandmarks(unsigned count, LandmarkSelection selection = LandmarkSelection::Avoid);
 
-    // Get nodes and edges
-    std::vector<std::pair<double, double>> getNodes(){return nodePositions;}
-    std::vector<std::pair<int,int>> getEdges(){return edges;}
+    // Contraction hierarchy for SearchAlgorithm::Ch, built at load time when enabled. A
+    // snapshot's hierarchy is used whenever it matches the weight type.
+    void setContractionHierarchy(bool enabled);
+
+    // Multilevel overlay for SearchAlgorithm::Overlay, partitioned and customized at load time
+    // when enabled.
+    void setMultilevelOverlay(bool enabled);
+    // Recomputes the overlay cliques from the current arc weights, keeping the partition
+    void customizeOverlay();
+    // Applies a batch of speed updates to a copy of the current map and swaps it in, see
+    // MapData::updateSpeeds. Queries running meanwhile finish on the old speeds. Returns the
+    // number of updates that matched a road. A hierarchy it drops is built again on a thread
+    // of its own, off the update lock, and swapped in once no newer map replaced the one it
+    // was built for.
+    size_t updateSpeeds(const std::vector<SpeedUpdate>& updates);
+    // Blocks until no hierarchy rebuild is running
+    void waitForHierarchy();
+    // Reads up to maxCount "from to speed" records, false on a malformed one. Fewer means
+    // the stream ended.
+    static bool readSpeedUpdates(std::istream& in, size_t maxCount, std::vector<SpeedUpdate>& updates);
+    // "count" then one "from to k minute1 factor1 ... minuteK factorK" line per road, swapped in
+    // like updateSpeeds. Profiles apply to searches given a departure time.
+    bool loadSpeedProfiles(const std::string& filename);
+    bool setSpeedProfiles(const std::vector<EdgeProfile>& profiles);
+    [[nodiscard]] std::string displayOutput(const std::vector<PathResult> &results) const;
     
     // Getters for visualization
-    [[nodiscard]] const std::vector<int>& getLastPath() const { return lastPath; }
+    [[nodiscard]] std::vector<int> getLastPath() const;
+    void setLastPath(const std::vector<int>& path);
     [[nodiscard]] const std::vector<Query>& getQueries() const { return queries; }
 
+    // Answers repeated queries from a sharded LRU cache of up to capacity results, keyed on
+    // MapData::resultKey; 0 turns it off. Entries of an older map are never returned.
+    void setResultCache(size_t capacity, unsigned shards = 16);
+    [[nodiscard]] ResultCacheStats getResultCacheStats() const;
+
 private:
-    std::vector<std::vector<std::pair<int, Edge>>> adjacencyList; // node -> [(neighbor, travel_time)]
-    double max_speed{};
+    // Read and replaced with std::atomic_load / std::atomic_store only
+    std::shared_ptr<const MapData> current;
+    // One reload or rebuild at a time, queries never take it
+    std::mutex updateMutex;
 
-    // For faster lookups
-    std::vector<std::pair<int,int>> edges;
-    std::vector<std::pair<double, double>> nodePositions; // node id -> (x, y)
+    std::atomic<SearchAlgorithm> searchAlgorithm{SearchAlgorithm::Dijkstra};
+    std::atomic<QueueType> queueType{QueueType::Binary};
+
+    uint64_t publishedMaps = 0; // under updateMutex
+    // Read and replaced with std::atomic_load / std::atomic_store only, empty while off
+    std::shared_ptr<ResultCache<CachedPath>> resultCache;
 
     std::vector<Query> queries;
     
     // For result tracking
+    mutable std::mutex lastPathMutex;
     std::vector<int> lastPath;
 
-    // Helper methods
-    static double calculateDistance(double x1, double y1, double x2, double y2) ;
+    std::mutex poolMutex; // guards creating the pools
+    std::unique_ptr<ThreadPool> pool;
+    // Reloads, rebuilds and speed updates run here, under updateMutex, so a batch
+    // on the query pool never waits for a whole map build to free it
+    std::unique_ptr<ThreadPool> builders;
+    unsigned threadCount = 0;
+
+    bool rebuildingHierarchy = false; // under updateMutex
+    // Last member, so destruction waits for the rebuild before anything it uses goes away
+    std::shared_future<void> hierarchyRebuild;
+
+    ThreadPool& threadPool();
+    ThreadPool& builderPool();
+    // Rebuilds the current map for changed options and swaps it in
+    void updateOptions(const std::function<void(MapOptions&)>& change);
+    // Numbers the map with the next epoch and makes it current, under updateMutex. Starts
+    // rebuildHierarchy when the map waits for a hierarchy.
+    void publish(std::shared_ptr<MapData> map);
+    // Builds the hierarchy of the current map until one is swapped in for the map it was
+    // built from, without holding updateMutex during the build
+    void rebuildHierarchy();
+    PathResult cachedShortestPath(const MapData& map, double startX, double startY, double endX, double endY, double R,
+                                  SearchAlgorithm algorithm, QueueType queue, QueryWorkspace& workspace,
+                                  double departure) const;
+    // Answers query from cache, false on a miss with key and walks set to the entry to store the answer as
+    bool findCached(ResultCache<CachedPath>& cache, const MapData& map, const Query& query, SearchAlgorithm algorithm,
+                    QueueType queue, double departure, std::string& key, SeedWalks& walks, PathResult& result) const;
 
-    Q_DISABLE_COPY(MapGraph);
+    MapGraph(const MapGraph&) = delete;
+    MapGraph& operator=(const MapGraph&) = delete;
 };
 
 #endif // MAPGRAPH_H
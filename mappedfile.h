@@ -0,0 +1,35 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    bool open(const std::string& filename);
+    void close();
+    // Hints that the view is read in random order (binary snapshots) rather than front to back
+    void adviseRandomAccess() const;
+
+    [[nodiscard]] bool isOpen() const { return opened; }
+    [[nodiscard]] const char* data() const { return view; }
+    [[nodiscard]] size_t size() const { return length; }
+
+private:
+    const char* view = nullptr;
+    size_t length = 0;
+    bool opened = false;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+};
+
+#endif // MAPPEDFILE_H
@@ -0,0 +1,1312 @@
+// Micro-benchmarks for the routing core over the TEST CASES corpus.
+//
+//   maproute-bench radius [casesRoot]
+//   maproute-bench load [casesRoot] [extra map files...]
+//   maproute-bench weights [casesRoot]
+//   maproute-bench search [casesRoot] [extra map/queries file pairs...]
+//   maproute-bench matrix [casesRoot] [extra map/queries file pairs...]
+//   maproute-bench isochrone [casesRoot] [extra map/queries file pairs...]
+//   maproute-bench queues [casesRoot] [extra map/queries file pairs...]
+//   maproute-bench suite [casesRoot] [--runs N] [--warmup N] [--threads N] [--search A]
+//   maproute-bench reload [casesRoot] [extra map/queries file pairs...]
+//   maproute-bench updates [casesRoot] [extra map/queries file pairs...]
+//   maproute-bench profiles [casesRoot] [extra map/queries file pairs...]
+//   maproute-bench cache [casesRoot] [extra map/queries file pairs...]
+//   maproute-bench order [casesRoot] [--runs N] [extra map/queries file pairs...]
+//   maproute-bench origins [casesRoot] [extra map/queries file pairs...]
+//
+// radius: compares the walking-radius lookup through the spatial grid with
+//         the linear scan over every node it replaced.
+// load:   compares loadMapFromFile with the iostream parser it replaced.
+// weights: runs every case with each search weight type and checks the
+//          results against the expected outputs to two decimals.
+// search: runs every query with bidirectional Dijkstra, A*, ALT (16 avoid
+//         landmarks), the contraction hierarchy and the multilevel overlay,
+//         checks they agree and compares the settled nodes. The overlay's prep
+//         time is its customization, the part a speed change repeats.
+// matrix: builds a travel-time matrix between the starts and the ends of up
+//         to 100 queries with one findShortestPath call per cell, with one
+//         Dijkstra per source and with the hierarchy's buckets. The two
+//         matrices must agree and never be slower than the single query,
+//         whose bidirectional Dijkstra settles for a slower meeting node on
+//         a few pairs.
+// isochrone: grows the reachable set from the first query's start up to 10%,
+//         50% and 100% of the farthest node's time, with Dijkstra and with
+//         the hierarchy's parallel PHAST sweep. Both must reach the same
+//         nodes in the same times.
+// queues: runs every query through the Dijkstra kernel with each priority
+//         queue, checks the travel times agree and reports the queue
+//         operations per query.
+// suite:  the regression suite. Loads every case, runs its query set
+//         through runQueries for the warm-up rounds and then N measured
+//         runs, checks the first measured run against the expected output
+//         and prints one JSON document: load time, best and median batch
+//         time, queries per second of the best run and the latency
+//         percentiles over all measured queries. Exits 1 on a wrong answer.
+// reload: runs query batches while another thread reloads the same map
+//         over and over, checks every batch against one run without reloads
+//         and compares the batch times with and without the reloads.
+// updates: applies batches of random speed updates to the loaded map
+//         (with the overlay, which every batch customizes again, and the
+//         contraction hierarchy, rebuilt in the background) while query
+//         batches run, reports the update latency, the batch times with and
+//         without updates and how long the hierarchy took to catch up after
+//         the last batch, and checks the overlay, the hierarchy and Dijkstra
+//         still agree on the updated map.
+// profiles: puts one of four daily speed shapes on every road, checks
+//         FIFO on a sample of arcs and that time-dependent A* and Dijkstra
+//         agree, and times them against static A*. An all-day factor of 1
+//         must reproduce the static travel times, and a road of speed 0 must
+//         take as long as without a profile.
+// cache:  runs every query four times in shuffled order without the result
+//         cache, with room for every query and with room for a quarter of
+//         them, then again after a speed update, and every query followed by
+//         a copy with a slightly moved start. Cached answers must print the
+//         same text as uncached ones, and none may survive the update.
+// order:  runs every batch in input order and in Hilbert order with
+//         Dijkstra and A*, best of N runs each, checks the answers agree and
+//         reports the mean distance between the starts of consecutive
+//         queries in each order.
+// origins: pairs the starts of up to 10 queries with the ends of up to 100
+//         queries each (keeping the start's R) and runs that batch with one
+//         Dijkstra per query and with one shared search per start. The shared
+//         travel times must match A* run per query; the bidirectional Dijkstra
+//         kernel misses a few answers whose best path is a walk through a
+//         single node, "dijkstra" counts where it agrees.
+
+#include "mapgraph.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct BenchCase {
+    std::string name;
+    std::string map;
+    std::string queries;
+    std::string expected;
+};
+
+std::vector<BenchCase> corpus(const std::string& root) {
+    std::vector<BenchCase> cases;
+    for (int i = 1; i <= 5; i++) {
+        const std::string n = std::to_string(i);
+        cases.push_back({"sample" + n, root + "/Sample Cases/Input/map" + n + ".txt",
+                         root + "/Sample Cases/Input/queries" + n + ".txt", root + "/Sample Cases/Output/output" + n + ".txt"});
+    }
+    cases.push_back({"medium", root + "/Medium Cases/Input/OLMap.txt", root + "/Medium Cases/Input/OLQueries.txt",
+                     root + "/Medium Cases/Output/OLOutput.txt"});
+    cases.push_back({"large", root + "/Large Cases/Input/SFMap.txt", root + "/Large Cases/Input/SFQueries.txt",
+                     root + "/Large Cases/Output/SFOutput.txt"});
+    return cases;
+}
+
+bool exists(const std::string& path) {
+    return std::ifstream(path).good();
+}
+
+double elapsedMs(const std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// The lookup findNodesWithinRadius used before the spatial index
+void linearScan(const std::vector<std::pair<double, double>>& nodes, const double x, const double y, const double R,
+                std::vector<int>& out) {
+    for (int i = 0; i < static_cast<int>(nodes.size()); ++i) {
+        if (std::sqrt(std::pow(nodes[i].first - x, 2) + std::pow(nodes[i].second - y, 2)) <= R) out.push_back(i);
+    }
+}
+
+// The iostream map parser loadMapFromFile used before the mmap scanner
+bool legacyLoad(const std::string& filename, std::vector<std::pair<double, double>>& positions,
+                std::vector<std::vector<std::pair<int, Edge>>>& adjacency) {
+    std::ifstream file(filename);
+    int numNodes = 0;
+    if (!(file >> numNodes)) return false;
+    positions.clear();
+    positions.reserve(numNodes);
+    for (int i = 0; i < numNodes; i++) {
+        Node node{};
+        file >> node.id >> node.x >> node.y;
+        positions.emplace_back(node.x, node.y);
+    }
+    int numEdges = 0;
+    file >> numEdges;
+    adjacency.assign(numNodes, {});
+    for (int i = 0; i < numEdges; i++) {
+        int source, destination;
+        Edge edge{};
+        file >> source >> destination >> edge.distance >> edge.speed;
+        if (file.fail()) return false;
+        adjacency[source].push_back({destination, edge});
+        adjacency[destination].push_back({source, edge});
+    }
+    return true;
+}
+
+int benchLoad(const std::string& root, const std::vector<std::string>& extraMaps) {
+    constexpr int repeats = 3;
+    std::vector<BenchCase> cases = corpus(root);
+    for (const std::string& map : extraMaps) cases.push_back({map, map, "", ""});
+
+    std::cout << std::left << std::setw(10) << "case" << std::right << std::setw(12) << "MB" << std::setw(14)
+              << "iostream ms" << std::setw(12) << "mmap ms" << std::setw(10) << "speedup" << std::endl;
+
+    for (const auto& bench : cases) {
+        if (!exists(bench.map)) {
+            std::cout << std::left << std::setw(10) << bench.name << " skipped (missing " << bench.map << ")" << std::endl;
+            continue;
+        }
+        std::ifstream sizeProbe(bench.map, std::ios::binary | std::ios::ate);
+        const double megabytes = static_cast<double>(sizeProbe.tellg()) / (1024.0 * 1024.0);
+
+        std::vector<std::pair<double, double>> positions;
+        std::vector<std::vector<std::pair<int, Edge>>> adjacency;
+        double legacyMs = 0, loadMs = 0;
+        for (int r = 0; r < repeats; r++) {
+            auto start = std::chrono::steady_clock::now();
+            if (!legacyLoad(bench.map, positions, adjacency)) return 1;
+            legacyMs += elapsedMs(start);
+
+            start = std::chrono::steady_clock::now();
+            if (!MapGraph::instance().loadMapFromFile(bench.map)) return 1;
+            loadMs += elapsedMs(start);
+        }
+        legacyMs /= repeats;
+        loadMs /= repeats;
+
+        if (MapGraph::instance().snapshot()->getNodes() != positions) {
+            std::cerr << bench.name << ": loaders disagree on the node coordinates" << std::endl;
+            return 1;
+        }
+
+        std::cout << std::left << std::setw(10) << bench.name << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(12) << megabytes << std::setprecision(3) << std::setw(14) << legacyMs << std::setw(12)
+                  << loadMs << std::setw(9) << std::setprecision(1) << legacyMs / std::max(loadMs, 1e-6) << "x"
+                  << std::defaultfloat << std::endl;
+    }
+    return 0;
+}
+
+// Splits an output file into one block of lines per query, dropping the timing trailer
+std::vector<std::vector<std::string>> readExpected(const std::string& filename) {
+    std::ifstream file(filename);
+    std::vector<std::vector<std::string>> blocks;
+    std::vector<std::string> block;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) {
+            if (!block.empty()) blocks.push_back(block);
+            block.clear();
+        } else {
+            block.push_back(line);
+        }
+    }
+    if (!block.empty()) blocks.push_back(block);
+    while (!blocks.empty() && blocks.back().size() == 1 && blocks.back()[0].find(" ms") != std::string::npos) {
+        blocks.pop_back();
+    }
+    return blocks;
+}
+
+// Compares one result with its expected block. Numbers may differ by one unit
+// in the second decimal (rounding), the path must match exactly.
+void compareResult(const std::string& resultText, const std::vector<std::string>& expected, bool& numbersMatch,
+                   bool& pathMatches) {
+    std::vector<std::string> lines;
+    std::istringstream in(resultText);
+    for (std::string line; std::getline(in, line);) lines.push_back(line);
+
+    numbersMatch = lines.size() == expected.size();
+    pathMatches = !lines.empty() && !expected.empty() && lines[0] == expected[0];
+    for (size_t i = 1; numbersMatch && i < lines.size(); i++) {
+        numbersMatch = std::fabs(std::strtod(lines[i].c_str(), nullptr) - std::strtod(expected[i].c_str(), nullptr)) <= 0.01 + 1e-9;
+    }
+}
+
+int benchWeights(const std::string& root) {
+    const std::pair<WeightType, const char*> types[] = {
+        {WeightType::Double, "double"}, {WeightType::Float, "float"}, {WeightType::FixedPoint, "fixed"}};
+
+    std::cout << std::left << std::setw(10) << "case" << std::setw(8) << "weights" << std::right << std::setw(10)
+              << "queries" << std::setw(12) << "2-decimal" << std::setw(12) << "same path" << std::setw(12)
+              << "query ms" << std::endl;
+
+    bool allMatch = true;
+    MapGraph& graph = MapGraph::instance();
+    for (const auto& [name, mapFile, queryFile, expectedFile] : corpus(root)) {
+        if (!exists(mapFile) || !exists(queryFile) || !exists(expectedFile)) {
+            std::cout << std::left << std::setw(10) << name << " skipped (missing input or expected output)" << std::endl;
+            continue;
+        }
+        if (!graph.loadMapFromFile(mapFile) || !graph.loadQueriesFromFile(queryFile)) return 1;
+        const auto expected = readExpected(expectedFile);
+
+        for (const auto& [type, typeName] : types) {
+            graph.setWeightType(type);
+            BatchStats stats;
+            const std::vector<PathResult> results = graph.runQueries(graph.getQueries(), {}, &stats);
+
+            size_t numbersOk = 0, pathsOk = 0;
+            for (size_t i = 0; i < results.size() && i < expected.size(); i++) {
+                bool numbersMatch, pathMatches;
+                compareResult(results[i].resultText, expected[i], numbersMatch, pathMatches);
+                numbersOk += numbersMatch;
+                pathsOk += pathMatches;
+            }
+            if (numbersOk != results.size()) allMatch = false;
+
+            std::cout << std::left << std::setw(10) << name << std::setw(8) << typeName << std::right << std::setw(10)
+                      << results.size() << std::setw(12) << numbersOk << std::setw(12) << pathsOk << std::fixed
+                      << std::setprecision(3) << std::setw(12) << stats.elapsedMs << std::defaultfloat << std::endl;
+        }
+        graph.setWeightType(WeightType::Double);
+    }
+    return allMatch ? 0 : 1;
+}
+
+int benchSearch(const std::string& root, const std::vector<std::string>& extraCases) {
+    constexpr unsigned landmarkCount = 16;
+    const std::pair<SearchAlgorithm, const char*> algorithms[] = {
+        {SearchAlgorithm::Dijkstra, "dijkstra"}, {SearchAlgorithm::AStar, "astar"}, {SearchAlgorithm::Alt, "alt"},
+        {SearchAlgorithm::Ch, "ch"}, {SearchAlgorithm::Overlay, "overlay"}};
+
+    std::vector<BenchCase> cases = corpus(root);
+    for (size_t i = 0; i + 1 < extraCases.size(); i += 2) {
+        cases.push_back({extraCases[i], extraCases[i], extraCases[i + 1], ""});
+    }
+
+    std::cout << std::left << std::setw(10) << "case" << std::setw(10) << "search" << std::right << std::setw(9)
+              << "queries" << std::setw(11) << "same time" << std::setw(11) << "same path" << std::setw(12) << "settled"
+              << std::setw(8) << "cut" << std::setw(10) << "long cut" << std::setw(12) << "query ms" << std::setw(10)
+              << "prep ms" << std::endl;
+
+    bool allAgree = true;
+    MapGraph& graph = MapGraph::instance();
+    graph.setLandmarks(landmarkCount, LandmarkSelection::Avoid);
+    graph.setContractionHierarchy(true);
+    graph.setMultilevelOverlay(true);
+    QueryWorkspace workspace;
+    for (const auto& bench : cases) {
+        if (!exists(bench.map) || !exists(bench.queries)) {
+            std::cout << std::left << std::setw(10) << bench.name << " skipped (missing input)" << std::endl;
+            continue;
+        }
+        if (!graph.loadMapFromFile(bench.map) || !graph.loadQueriesFromFile(bench.queries)) return 1;
+        const std::vector<Query>& queries = graph.getQueries();
+
+        // The quarter of the queries with the farthest apart end points
+        std::vector<size_t> order(queries.size());
+        for (size_t i = 0; i < order.size(); i++) order[i] = i;
+        std::sort(order.begin(), order.end(), [&](const size_t a, const size_t b) {
+            return std::hypot(queries[a].endX - queries[a].startX, queries[a].endY - queries[a].startY) >
+                   std::hypot(queries[b].endX - queries[b].startX, queries[b].endY - queries[b].startY);
+        });
+        order.resize(std::max<size_t>(1, queries.size() / 4));
+
+        std::vector<PathResult> reference;
+        size_t referenceSettled = 0, referenceLong = 0;
+        for (const auto& [algorithm, algorithmName] : algorithms) {
+            // Per query on one thread, so the times compare the searches and not the pool
+            std::vector<PathResult> results;
+            const auto start = std::chrono::steady_clock::now();
+            for (const auto& [startX, startY, endX, endY, R] : queries) {
+                results.push_back(graph.findShortestPath(startX, startY, endX, endY, R, algorithm, workspace));
+            }
+            const double queryMs = elapsedMs(start);
+
+            size_t settled = 0, longSettled = 0;
+            for (const PathResult& result : results) settled += result.stats.settledNodes;
+            for (const size_t i : order) longSettled += results[i].stats.settledNodes;
+            if (reference.empty()) {
+                reference = results;
+                referenceSettled = settled;
+                referenceLong = longSettled;
+            }
+
+            size_t sameTime = 0, samePath = 0;
+            for (size_t i = 0; i < queries.size(); i++) {
+                const double a = reference[i].travelTime, b = results[i].travelTime;
+                sameTime += a == b || std::fabs(a - b) <= 1e-9 * std::max(1.0, std::fabs(a));
+                samePath += reference[i].path == results[i].path;
+            }
+            if (sameTime != queries.size()) allAgree = false;
+
+            const auto cut = [](const size_t before, const size_t after) {
+                return before ? 100.0 * (1.0 - static_cast<double>(after) / before) : 0.0;
+            };
+            const LoadStats load = graph.snapshot()->getLoadStats();
+            const double prepMs = algorithm == SearchAlgorithm::Alt ? load.landmarkMs
+                                  : algorithm == SearchAlgorithm::Ch ? load.hierarchyMs
+                                  : algorithm == SearchAlgorithm::Overlay ? load.customizeMs : 0.0;
+            std::cout << std::left << std::setw(10) << bench.name << std::setw(10) << algorithmName << std::right
+                      << std::setw(9) << queries.size() << std::setw(11) << sameTime << std::setw(11) << samePath
+                      << std::setw(12) << settled << std::fixed << std::setprecision(1) << std::setw(7)
+                      << cut(referenceSettled, settled) << "%" << std::setw(9) << cut(referenceLong, longSettled) << "%"
+                      << std::setprecision(3) << std::setw(12) << queryMs << std::setw(10) << prepMs << std::defaultfloat
+                      << std::endl;
+        }
+    }
+    return allAgree ? 0 : 1;
+}
+
+int benchQueues(const std::string& root, const std::vector<std::string>& extraCases) {
+    const std::pair<QueueType, const char*> queues[] = {
+        {QueueType::Binary, "binary"}, {QueueType::QuadHeap, "4ary"}, {QueueType::Radix, "radix"}};
+
+    std::vector<BenchCase> cases = corpus(root);
+    for (size_t i = 0; i + 1 < extraCases.size(); i += 2) {
+        cases.push_back({extraCases[i], extraCases[i], extraCases[i + 1], ""});
+    }
+
+    std::cout << std::left << std::setw(10) << "case" << std::setw(8) << "queue" << std::right << std::setw(9)
+              << "queries" << std::setw(11) << "same time" << std::setw(11) << "same path" << std::setw(12)
+              << "pushes/q" << std::setw(10) << "pops/q" << std::setw(12) << "query ms" << std::endl;
+
+    bool allAgree = true;
+    MapGraph& graph = MapGraph::instance();
+    graph.setLandmarks(0);
+    graph.setMultilevelOverlay(false);
+    QueryWorkspace workspace;
+    for (const auto& bench : cases) {
+        if (!exists(bench.map) || !exists(bench.queries)) {
+            std::cout << std::left << std::setw(10) << bench.name << " skipped (missing input)" << std::endl;
+            continue;
+        }
+        if (!graph.loadMapFromFile(bench.map) || !graph.loadQueriesFromFile(bench.queries)) return 1;
+        const std::vector<Query>& queries = graph.getQueries();
+
+        std::vector<PathResult> reference;
+        for (const auto& [type, typeName] : queues) {
+            graph.setQueueType(type);
+            // Per query on one thread like the search mode
+            std::vector<PathResult> results;
+            const auto start = std::chrono::steady_clock::now();
+            for (const auto& [startX, startY, endX, endY, R] : queries) {
+                results.push_back(graph.findShortestPath(startX, startY, endX, endY, R, SearchAlgorithm::Dijkstra, workspace));
+            }
+            const double queryMs = elapsedMs(start);
+            if (reference.empty()) reference = results;
+
+            size_t sameTime = 0, samePath = 0, pushes = 0, pops = 0;
+            for (size_t i = 0; i < queries.size(); i++) {
+                const double a = reference[i].travelTime, b = results[i].travelTime;
+                sameTime += a == b || std::fabs(a - b) <= 1e-9 * std::max(1.0, std::fabs(a));
+                samePath += reference[i].path == results[i].path;
+                pushes += results[i].stats.queuePushes;
+                pops += results[i].stats.queuePops;
+            }
+            if (sameTime != queries.size()) allAgree = false;
+
+            const double count = std::max<size_t>(1, queries.size());
+            std::cout << std::left << std::setw(10) << bench.name << std::setw(8) << typeName << std::right << std::setw(9)
+                      << queries.size() << std::setw(11) << sameTime << std::setw(11) << samePath << std::fixed
+                      << std::setprecision(1) << std::setw(12) << pushes / count << std::setw(10) << pops / count
+                      << std::setprecision(3) << std::setw(12) << queryMs << std::defaultfloat << std::endl;
+        }
+    }
+    graph.setQueueType(QueueType::Binary);
+    return allAgree ? 0 : 1;
+}
+
+int benchSuite(const std::vector<std::string>& args) {
+    std::string root = "TEST CASES";
+    unsigned runs = 5, warmup = 1, threads = 0;
+    std::string searchName = "dijkstra";
+    const std::pair<const char*, SearchAlgorithm> algorithms[] = {
+        {"dijkstra", SearchAlgorithm::Dijkstra}, {"astar", SearchAlgorithm::AStar}, {"alt", SearchAlgorithm::Alt},
+        {"ch", SearchAlgorithm::Ch}, {"overlay", SearchAlgorithm::Overlay}};
+    SearchAlgorithm algorithm = SearchAlgorithm::Dijkstra;
+    for (size_t i = 0; i < args.size(); i++) {
+        const bool hasValue = i + 1 < args.size();
+        if (args[i] == "--runs" && hasValue) {
+            runs = std::max(1, std::atoi(args[++i].c_str()));
+        } else if (args[i] == "--warmup" && hasValue) {
+            warmup = std::max(0, std::atoi(args[++i].c_str()));
+        } else if (args[i] == "--threads" && hasValue) {
+            threads = std::max(0, std::atoi(args[++i].c_str()));
+        } else if (args[i] == "--search" && hasValue) {
+            searchName = args[++i];
+            const auto known = std::find_if(std::begin(algorithms), std::end(algorithms),
+                                            [&](const auto& entry) { return searchName == entry.first; });
+            if (known == std::end(algorithms)) {
+                std::cerr << "Unknown search: " << searchName << std::endl;
+                return 2;
+            }
+            algorithm = known->second;
+        } else if (args[i].rfind("--", 0) != 0) {
+            root = args[i];
+        } else {
+            std::cerr << "Unknown option: " << args[i] << std::endl;
+            return 2;
+        }
+    }
+
+    MapGraph& graph = MapGraph::instance();
+    graph.setThreadCount(threads);
+    graph.setSearchAlgorithm(algorithm);
+    graph.setLandmarks(algorithm == SearchAlgorithm::Alt ? 16 : 0);
+    graph.setContractionHierarchy(algorithm == SearchAlgorithm::Ch);
+    graph.setMultilevelOverlay(algorithm == SearchAlgorithm::Overlay);
+
+    bool allCorrect = true;
+    bool first = true;
+    std::ostringstream json;
+    json << std::fixed << std::setprecision(3);
+    for (const auto& [name, mapFile, queryFile, expectedFile] : corpus(root)) {
+        json << (first ? "" : ",\n") << "    {\"name\": \"" << name << "\"";
+        first = false;
+        if (!exists(mapFile) || !exists(queryFile) || !exists(expectedFile)) {
+            json << ", \"skipped\": \"missing input or expected output\"}";
+            continue;
+        }
+        if (!graph.loadMapFromFile(mapFile) || !graph.loadQueriesFromFile(queryFile)) return 1;
+        const LoadStats load = graph.snapshot()->getLoadStats();
+        const double prepMs = load.landmarkMs + load.hierarchyMs + load.partitionMs + load.customizeMs;
+        const auto expected = readExpected(expectedFile);
+        const std::vector<Query>& queries = graph.getQueries();
+
+        for (unsigned i = 0; i < warmup; i++) graph.runQueries(queries);
+
+        std::vector<double> batchMs, latencies;
+        size_t numbersOk = 0, pathsOk = 0;
+        for (unsigned run = 0; run < runs; run++) {
+            BatchStats stats;
+            const std::vector<PathResult> results = graph.runQueries(queries, {}, &stats);
+            batchMs.push_back(stats.elapsedMs);
+            for (const PathResult& result : results) latencies.push_back(result.stats.totalMs);
+            if (run > 0) continue;
+            for (size_t i = 0; i < results.size() && i < expected.size(); i++) {
+                bool numbersMatch, pathMatches;
+                compareResult(results[i].resultText, expected[i], numbersMatch, pathMatches);
+                numbersOk += numbersMatch;
+                pathsOk += pathMatches;
+            }
+        }
+        const bool correct = numbersOk == queries.size() && expected.size() == queries.size();
+        allCorrect = allCorrect && correct;
+
+        std::sort(batchMs.begin(), batchMs.end());
+        const Percentiles latency = Percentiles::of(latencies);
+        json << ", \"nodes\": " << graph.snapshot()->getNodes().size() << ", \"queries\": " << queries.size()
+             << ", \"correct\": " << (correct ? "true" : "false") << ", \"numbers_match\": " << numbersOk
+             << ", \"paths_match\": " << pathsOk << ", \"load_ms\": " << load.parseMs + load.indexMs
+             << ", \"prep_ms\": " << prepMs << ", \"best_ms\": " << batchMs.front()
+             << ", \"median_ms\": " << batchMs[batchMs.size() / 2] << ", \"queries_per_second\": "
+             << (batchMs.front() > 0 ? queries.size() * 1000.0 / batchMs.front() : 0.0) << ", \"latency_ms\": {\"p50\": "
+             << latency.p50 << ", \"p95\": " << latency.p95 << ", \"p99\": " << latency.p99 << "}}";
+    }
+
+    std::cout << "{\"search\": \"" << searchName << "\", \"runs\": " << runs << ", \"warmup\": " << warmup
+              << ", \"threads\": " << graph.getThreadCount() << ", \"all_correct\": " << (allCorrect ? "true" : "false")
+              << ",\n  \"cases\": [\n" << json.str() << "\n  ]}" << std::endl;
+    graph.setLandmarks(0);
+    graph.setContractionHierarchy(false);
+    graph.setMultilevelOverlay(false);
+    return allCorrect ? 0 : 1;
+}
+
+int benchMatrix(const std::string& root, const std::vector<std::string>& extraCases) {
+    constexpr size_t maxPoints = 100;
+    std::vector<BenchCase> cases = corpus(root);
+    for (size_t i = 0; i + 1 < extraCases.size(); i += 2) {
+        cases.push_back({extraCases[i], extraCases[i], extraCases[i + 1], ""});
+    }
+
+    std::cout << std::left << std::setw(10) << "case" << std::setw(10) << "method" << std::right << std::setw(9) << "cells"
+              << std::setw(11) << "same time" << std::setw(9) << "faster" << std::setw(12) << "matrix ms" << std::setw(10)
+              << "prep ms" << std::endl;
+
+    bool allAgree = true;
+    MapGraph& graph = MapGraph::instance();
+    graph.setLandmarks(0);
+    graph.setMultilevelOverlay(false);
+    for (const auto& bench : cases) {
+        if (!exists(bench.map) || !exists(bench.queries)) {
+            std::cout << std::left << std::setw(10) << bench.name << " skipped (missing input)" << std::endl;
+            continue;
+        }
+        graph.setContractionHierarchy(false);
+        if (!graph.loadMapFromFile(bench.map) || !graph.loadQueriesFromFile(bench.queries)) return 1;
+
+        // A query has one R for both ends, so every point takes the first query's
+        std::vector<MatrixPoint> sources, targets;
+        const double R = graph.getQueries().front().R;
+        for (const auto& [startX, startY, endX, endY, queryR] : graph.getQueries()) {
+            if (sources.size() == maxPoints) break;
+            sources.push_back({startX, startY, R});
+            targets.push_back({endX, endY, R});
+        }
+
+        // One query per cell, batched on the pool like the matrix
+        std::vector<Query> pairs;
+        for (const MatrixPoint& from : sources) {
+            for (const MatrixPoint& to : targets) pairs.push_back({from.x, from.y, to.x, to.y, R});
+        }
+        std::vector<TravelMatrix> matrices;
+        std::vector<double> times, prep;
+        BatchStats stats;
+        const std::vector<PathResult> results = graph.runQueries(pairs, {}, &stats);
+        TravelMatrix reference;
+        reference.rows = sources.size();
+        reference.cols = targets.size();
+        for (const PathResult& result : results) reference.times.push_back(result.travelTime);
+        matrices.push_back(reference);
+        times.push_back(stats.elapsedMs);
+        prep.push_back(0);
+
+        matrices.push_back(graph.travelMatrix(sources, targets, &stats));
+        times.push_back(stats.elapsedMs);
+        prep.push_back(0);
+
+        graph.setContractionHierarchy(true);
+        matrices.push_back(graph.travelMatrix(sources, targets, &stats));
+        times.push_back(stats.elapsedMs);
+        prep.push_back(graph.snapshot()->getLoadStats().hierarchyMs);
+
+        const auto same = [](const double a, const double b) {
+            return a == b || std::fabs(a - b) <= 1e-9 * std::max(1.0, std::fabs(a));
+        };
+        const char* methods[] = {"pairs", "dijkstra", "buckets"};
+        for (size_t m = 0; m < matrices.size(); m++) {
+            size_t sameTime = 0, faster = 0;
+            for (size_t i = 0; i < reference.times.size(); i++) {
+                const double a = reference.times[i], b = matrices[m].times[i];
+                if (same(a, b)) {
+                    sameTime++;
+                } else if (b < a) {
+                    faster++;
+                } else {
+                    allAgree = false;
+                }
+                if (m > 0 && !same(matrices[1].times[i], b)) allAgree = false;
+            }
+            std::cout << std::left << std::setw(10) << bench.name << std::setw(10) << methods[m] << std::right
+                      << std::setw(9) << reference.times.size() << std::setw(11) << sameTime << std::setw(9) << faster
+                      << std::fixed
+                      << std::setprecision(3) << std::setw(12) << times[m] << std::setw(10) << prep[m] << std::defaultfloat
+                      << std::endl;
+        }
+    }
+    graph.setContractionHierarchy(false);
+    return allAgree ? 0 : 1;
+}
+
+int benchIsochrone(const std::string& root, const std::vector<std::string>& extraCases) {
+    std::vector<BenchCase> cases = corpus(root);
+    for (size_t i = 0; i + 1 < extraCases.size(); i += 2) {
+        cases.push_back({extraCases[i], extraCases[i], extraCases[i + 1], ""});
+    }
+
+    std::cout << std::left << std::setw(10) << "case" << std::right << std::setw(8) << "budget" << std::setw(10) << "reached"
+              << std::setw(13) << "dijkstra ms" << std::setw(10) << "sweep ms" << std::setw(10) << "prep ms"
+              << std::setw(7) << "same" << std::endl;
+
+    bool allAgree = true;
+    MapGraph& graph = MapGraph::instance();
+    graph.setLandmarks(0);
+    graph.setMultilevelOverlay(false);
+    graph.setContractionHierarchy(true);
+    QueryWorkspace workspace;
+    for (const auto& bench : cases) {
+        if (!exists(bench.map) || !exists(bench.queries)) {
+            std::cout << std::left << std::setw(10) << bench.name << " skipped (missing input)" << std::endl;
+            continue;
+        }
+        if (!graph.loadMapFromFile(bench.map) || !graph.loadQueriesFromFile(bench.queries)) return 1;
+
+        const Query& origin = graph.getQueries().front();
+        double farthest = 0;
+        for (const ReachedNode& reached : graph.findReachableNodes(origin.startX, origin.startY, origin.R,
+                                                                   std::numeric_limits<double>::infinity(), workspace).nodes) {
+            farthest = std::max(farthest, reached.time);
+        }
+
+        for (const int percent : {10, 50, 100}) {
+            // Headroom for the farthest node, whose time the two sum up in a different order
+            const double budget = farthest * percent / 100 * (1 + 1e-9);
+            auto start = std::chrono::steady_clock::now();
+            const Isochrone dijkstra = graph.findReachableNodes(origin.startX, origin.startY, origin.R, budget, workspace);
+            const double dijkstraMs = elapsedMs(start);
+            start = std::chrono::steady_clock::now();
+            const Isochrone sweep = graph.findReachableNodesParallel(origin.startX, origin.startY, origin.R, budget);
+            const double sweepMs = elapsedMs(start);
+
+            // Compared by node, the two list them in different orders
+            std::vector<double> times(graph.snapshot()->getNodes().size(), -1);
+            for (const ReachedNode& reached : dijkstra.nodes) times[reached.node] = reached.time;
+            bool same = dijkstra.nodes.size() == sweep.nodes.size();
+            for (const ReachedNode& reached : sweep.nodes) {
+                same = same && std::fabs(times[reached.node] - reached.time) <= 1e-9 * std::max(1.0, reached.time);
+            }
+            allAgree = allAgree && same;
+            std::cout << std::left << std::setw(10) << bench.name << std::right << std::setw(7) << percent << "%"
+                      << std::setw(10) << dijkstra.nodes.size() << std::fixed << std::setprecision(3) << std::setw(13)
+                      << dijkstraMs << std::setw(10) << sweepMs << std::setw(10) << graph.snapshot()->getLoadStats().hierarchyMs
+                      << std::defaultfloat << std::setw(7) << (same ? "yes" : "NO") << std::endl;
+        }
+    }
+    graph.setContractionHierarchy(false);
+    return allAgree ? 0 : 1;
+}
+
+int benchReload(const std::string& root, const std::vector<std::string>& extraCases) {
+    constexpr int batches = 20;
+    std::vector<BenchCase> cases = corpus(root);
+    for (size_t i = 0; i + 1 < extraCases.size(); i += 2) {
+        cases.push_back({extraCases[i], extraCases[i], extraCases[i + 1], ""});
+    }
+
+    std::cout << std::left << std::setw(10) << "case" << std::right << std::setw(10) << "batches" << std::setw(10)
+              << "reloads" << std::setw(12) << "quiet ms" << std::setw(12) << "reload ms" << std::setw(10) << "same"
+              << std::endl;
+
+    bool allSame = true;
+    MapGraph& graph = MapGraph::instance();
+    for (const auto& bench : cases) {
+        if (!exists(bench.map) || !exists(bench.queries)) {
+            std::cout << std::left << std::setw(10) << bench.name << " skipped (missing input)" << std::endl;
+            continue;
+        }
+        if (!graph.loadMapFromFile(bench.map) || !graph.loadQueriesFromFile(bench.queries)) return 1;
+        const std::vector<Query> queries = graph.getQueries();
+        const std::vector<PathResult> reference = graph.runQueries(queries);
+        const auto sameAnswers = [&](const std::vector<PathResult>& results) {
+            for (size_t i = 0; i < results.size(); i++) {
+                if (results[i].resultText != reference[i].resultText) return false;
+            }
+            return true;
+        };
+
+        // A map pinned before a reload must stay usable after it
+        const std::shared_ptr<const MapData> pinned = graph.snapshot();
+        if (!graph.loadMapFromFile(bench.map)) return 1;
+        QueryWorkspace workspace;
+        const auto& [startX, startY, endX, endY, R] = queries.front();
+        bool same = pinned != graph.snapshot() &&
+                    pinned->findShortestPath(startX, startY, endX, endY, R, graph.getSearchAlgorithm(),
+                                             graph.getQueueType(), workspace).resultText == reference.front().resultText;
+
+        double quietMs = 0;
+        for (int b = 0; b < batches; b++) {
+            const auto start = std::chrono::steady_clock::now();
+            same = sameAnswers(graph.runQueries(queries)) && same;
+            quietMs += elapsedMs(start);
+        }
+
+        std::atomic_bool stop{false};
+        std::atomic_int reloads{0};
+        bool reloadFailed = false;
+        std::thread reloader([&] {
+            while (!stop) {
+                if (!graph.loadMapFromFile(bench.map)) {
+                    reloadFailed = true;
+                    return;
+                }
+                reloads++;
+            }
+        });
+        double reloadMs = 0;
+        for (int b = 0; b < batches; b++) {
+            const auto start = std::chrono::steady_clock::now();
+            same = sameAnswers(graph.runQueries(queries)) && same;
+            reloadMs += elapsedMs(start);
+        }
+        stop = true;
+        reloader.join();
+        if (reloadFailed) return 1;
+
+        allSame = allSame && same;
+        std::cout << std::left << std::setw(10) << bench.name << std::right << std::setw(10) << batches << std::setw(10)
+                  << reloads << std::fixed << std::setprecision(3) << std::setw(12) << quietMs / batches << std::setw(12)
+                  << reloadMs / batches << std::defaultfloat << std::setw(10) << (same ? "yes" : "NO") << std::endl;
+    }
+    return allSame ? 0 : 1;
+}
+
+int benchUpdates(const std::string& root, const std::vector<std::string>& extraCases) {
+    constexpr size_t updateCount = 20000;
+    constexpr size_t batchSize = 500;
+    constexpr double speeds[] = {10, 20, 30, 50, 80, 100, 120};
+    std::vector<BenchCase> cases = corpus(root);
+    for (size_t i = 0; i + 1 < extraCases.size(); i += 2) {
+        cases.push_back({extraCases[i], extraCases[i], extraCases[i + 1], ""});
+    }
+
+    std::cout << std::left << std::setw(10) << "case" << std::right << std::setw(10) << "updates" << std::setw(12)
+              << "update p50" << std::setw(12) << "update p99" << std::setw(12) << "quiet ms" << std::setw(12)
+              << "busy ms" << std::setw(10) << "ch ms" << std::setw(8) << "agree" << std::endl;
+
+    bool allAgree = true;
+    MapGraph& graph = MapGraph::instance();
+    graph.setLandmarks(0);
+    graph.setContractionHierarchy(true);
+    graph.setMultilevelOverlay(true);
+    for (const auto& bench : cases) {
+        if (!exists(bench.map) || !exists(bench.queries)) {
+            std::cout << std::left << std::setw(10) << bench.name << " skipped (missing input)" << std::endl;
+            continue;
+        }
+        if (!graph.loadMapFromFile(bench.map) || !graph.loadQueriesFromFile(bench.queries)) return 1;
+        const std::vector<Query> queries = graph.getQueries();
+        // Pinned, the updates below swap in new maps while it is read
+        const std::shared_ptr<const MapData> loaded = graph.snapshot();
+        const auto& edges = loaded->getEdges();
+
+        // Random roads and speeds, the same on every run
+        std::vector<std::vector<SpeedUpdate>> batches(updateCount / batchSize);
+        uint64_t state = 12345;
+        const auto next = [&state] {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            return state >> 33;
+        };
+        for (auto& batch : batches) {
+            for (size_t i = 0; i < batchSize; i++) {
+                const auto& [from, to] = edges[next() % edges.size()];
+                batch.push_back({from, to, speeds[next() % std::size(speeds)]});
+            }
+        }
+
+        double quietMs = 0;
+        int quietBatches = 0;
+        for (; quietBatches < 5; quietBatches++) {
+            const auto start = std::chrono::steady_clock::now();
+            graph.runQueries(queries);
+            quietMs += elapsedMs(start);
+        }
+
+        std::atomic_bool done{false};
+        std::vector<double> updateMs;
+        std::thread updater([&] {
+            for (const auto& batch : batches) {
+                const auto start = std::chrono::steady_clock::now();
+                graph.updateSpeeds(batch);
+                updateMs.push_back(elapsedMs(start));
+            }
+            done = true;
+        });
+        double busyMs = 0;
+        int busyBatches = 0;
+        while (!done) {
+            const auto start = std::chrono::steady_clock::now();
+            graph.runQueries(queries);
+            busyMs += elapsedMs(start);
+            busyBatches++;
+        }
+        updater.join();
+        const auto waitStart = std::chrono::steady_clock::now();
+        graph.waitForHierarchy();
+        const double hierarchyMs = elapsedMs(waitStart);
+
+        // The overlay runs on the customized cliques, the hierarchy on the rebuilt shortcuts,
+        // Dijkstra on the patched arcs
+        graph.setSearchAlgorithm(SearchAlgorithm::Overlay);
+        const std::vector<PathResult> overlay = graph.runQueries(queries);
+        graph.setSearchAlgorithm(SearchAlgorithm::Ch);
+        const std::vector<PathResult> hierarchy = graph.runQueries(queries);
+        graph.setSearchAlgorithm(SearchAlgorithm::Dijkstra);
+        const std::vector<PathResult> dijkstra = graph.runQueries(queries);
+        bool agree = !graph.snapshot()->getContractionHierarchy().empty();
+        for (size_t i = 0; i < queries.size(); i++) {
+            const double b = dijkstra[i].travelTime;
+            for (const double a : {overlay[i].travelTime, hierarchy[i].travelTime}) {
+                agree = agree && (a == b || std::fabs(a - b) <= 1e-9 * std::max(1.0, b));
+            }
+        }
+        allAgree = allAgree && agree;
+
+        const Percentiles latency = Percentiles::of(updateMs);
+        std::cout << std::left << std::setw(10) << bench.name << std::right << std::setw(10) << updateCount << std::fixed
+                  << std::setprecision(3) << std::setw(12) << latency.p50 << std::setw(12) << latency.p99 << std::setw(12)
+                  << quietMs / quietBatches << std::setw(12) << busyMs / std::max(busyBatches, 1) << std::setw(10)
+                  << hierarchyMs << std::defaultfloat
+                  << std::setw(8) << (agree ? "yes" : "NO") << std::endl;
+    }
+    graph.setContractionHierarchy(false);
+    graph.setMultilevelOverlay(false);
+    return allAgree ? 0 : 1;
+}
+
+int benchProfiles(const std::string& root, const std::vector<std::string>& extraCases) {
+    constexpr double departure = 8 * 60;
+    const std::vector<std::vector<ProfilePoint>> shapes = {
+        {{0, 1.0f}, {420, 1.0f}, {480, 0.4f}, {570, 0.9f}, {960, 0.9f}, {1050, 0.35f}, {1140, 1.0f}}, // two rush hours
+        {{0, 1.2f}, {360, 1.0f}, {480, 0.6f}, {600, 1.0f}, {1020, 0.5f}, {1200, 1.1f}},
+        {{300, 0.8f}, {900, 0.5f}},
+        {{0, 1.0f}},
+    };
+    std::vector<BenchCase> cases = corpus(root);
+    for (size_t i = 0; i + 1 < extraCases.size(); i += 2) {
+        cases.push_back({extraCases[i], extraCases[i], extraCases[i + 1], ""});
+    }
+
+    std::cout << std::left << std::setw(10) << "case" << std::right << std::setw(8) << "shapes" << std::setw(10)
+              << "bytes/arc" << std::setw(12) << "static ms" << std::setw(10) << "td ms" << std::setw(12) << "td A* ms"
+              << std::setw(6) << "fifo" << std::setw(7) << "agree" << std::setw(6) << "flat" << std::setw(9) << "stopped"
+              << std::endl;
+
+    bool allGood = true;
+    MapGraph& graph = MapGraph::instance();
+    graph.setSearchAlgorithm(SearchAlgorithm::AStar);
+    for (const auto& bench : cases) {
+        if (!exists(bench.map) || !exists(bench.queries)) {
+            std::cout << std::left << std::setw(10) << bench.name << " skipped (missing input)" << std::endl;
+            continue;
+        }
+        if (!graph.loadMapFromFile(bench.map) || !graph.loadQueriesFromFile(bench.queries)) return 1;
+        const std::vector<Query> queries = graph.getQueries();
+        const std::shared_ptr<const MapData> loaded = graph.snapshot();
+        const std::vector<std::pair<int, int>> edges(loaded->getEdges().begin(), loaded->getEdges().end());
+
+        BatchOptions timed;
+        timed.departure = departure;
+        const auto runTimed = [&](std::vector<PathResult>& results) {
+            const auto start = std::chrono::steady_clock::now();
+            results = graph.runQueries(queries, timed);
+            return elapsedMs(start);
+        };
+        const auto sameTimes = [](const std::vector<PathResult>& a, const std::vector<PathResult>& b) {
+            for (size_t i = 0; i < a.size(); i++) {
+                const double x = a[i].travelTime, y = b[i].travelTime;
+                if (x != y && std::fabs(x - y) > 1e-9 * std::max(1.0, y)) return false;
+            }
+            return true;
+        };
+
+        auto start = std::chrono::steady_clock::now();
+        const std::vector<PathResult> staticResults = graph.runQueries(queries);
+        const double staticMs = elapsedMs(start);
+
+        // A factor of 1 all day is the static map
+        std::vector<EdgeProfile> profiles;
+        for (const auto& [from, to] : edges) profiles.push_back({from, to, {{0, 1.0f}}});
+        if (!graph.setSpeedProfiles(profiles)) return 1;
+        std::vector<PathResult> flat;
+        runTimed(flat);
+        const bool flatSame = sameTimes(flat, staticResults);
+
+        uint64_t state = 99;
+        for (auto& profile : profiles) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            profile.points = shapes[(state >> 33) % shapes.size()];
+        }
+        if (!graph.setSpeedProfiles(profiles)) return 1;
+        const std::shared_ptr<const MapData> map = graph.snapshot();
+        const SpeedProfiles& speedProfiles = map->getSpeedProfiles();
+
+        // Entering later never means leaving earlier, and a stopped road is never crossed
+        bool fifo = true;
+        bool stopped = true;
+        const auto& edgeOffsets = map->getEdges();
+        for (size_t arc = 0; arc < std::min<size_t>(2 * edgeOffsets.size(), 2000); arc += 7) {
+            double previous = -1;
+            for (double at = 0; at < 2 * SpeedProfiles::dayMinutes; at += 3) {
+                const double arrival = at + speedProfiles.travelMinutes(static_cast<uint32_t>(arc), 1.0, 50.0, at);
+                fifo = fifo && arrival >= previous - 1e-9;
+                previous = arrival;
+            }
+            stopped = stopped && speedProfiles.travelMinutes(static_cast<uint32_t>(arc), 1.0, 0.0, departure) ==
+                                     CsrGraph::travelMinutes(1.0, 0.0);
+        }
+
+        std::vector<PathResult> astar, dijkstra;
+        const double astarMs = runTimed(astar);
+        graph.setSearchAlgorithm(SearchAlgorithm::Dijkstra);
+        const double dijkstraMs = runTimed(dijkstra);
+        graph.setSearchAlgorithm(SearchAlgorithm::AStar);
+        const bool agree = sameTimes(astar, dijkstra);
+        allGood = allGood && fifo && agree && flatSame && stopped;
+
+        std::cout << std::left << std::setw(10) << bench.name << std::right << std::setw(8) << speedProfiles.shapeCount()
+                  << std::fixed << std::setprecision(2) << std::setw(10)
+                  << static_cast<double>(speedProfiles.bytes()) / std::max<size_t>(2 * edges.size(), 1)
+                  << std::setprecision(3) << std::setw(12) << staticMs << std::setw(10) << dijkstraMs << std::setw(12)
+                  << astarMs << std::defaultfloat << std::setw(6) << (fifo ? "yes" : "NO") << std::setw(7)
+                  << (agree ? "yes" : "NO") << std::setw(6) << (flatSame ? "yes" : "NO") << std::setw(9)
+                  << (stopped ? "yes" : "NO") << std::endl;
+    }
+    graph.setSearchAlgorithm(SearchAlgorithm::Dijkstra);
+    return allGood ? 0 : 1;
+}
+
+int benchCache(const std::string& root, const std::vector<std::string>& extraCases) {
+    constexpr size_t repeats = 4;
+    std::vector<BenchCase> cases = corpus(root);
+    for (size_t i = 0; i + 1 < extraCases.size(); i += 2) {
+        cases.push_back({extraCases[i], extraCases[i], extraCases[i + 1], ""});
+    }
+
+    std::cout << std::left << std::setw(10) << "case" << std::right << std::setw(9) << "queries" << std::setw(12)
+              << "off ms" << std::setw(12) << "on ms" << std::setw(10) << "hit rate" << std::setw(12) << "small rate"
+              << std::setw(12) << "update rate" << std::setw(12) << "shared rate" << std::setw(12) << "moved rate"
+              << std::setw(6) << "same" << std::endl;
+
+    bool allSame = true;
+    MapGraph& graph = MapGraph::instance();
+    for (const auto& bench : cases) {
+        if (!exists(bench.map) || !exists(bench.queries)) {
+            std::cout << std::left << std::setw(10) << bench.name << " skipped (missing input)" << std::endl;
+            continue;
+        }
+        graph.setResultCache(0);
+        if (!graph.loadMapFromFile(bench.map) || !graph.loadQueriesFromFile(bench.queries)) return 1;
+        const std::vector<Query>& queries = graph.getQueries();
+
+        std::vector<Query> stream;
+        for (size_t r = 0; r < repeats; r++) stream.insert(stream.end(), queries.begin(), queries.end());
+        uint64_t state = 7;
+        for (size_t i = stream.size(); i > 1; i--) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            std::swap(stream[i - 1], stream[(state >> 33) % i]);
+        }
+
+        BatchStats stats;
+        BatchOptions options;
+        const auto runBatch = [&](const std::vector<Query>& batch, std::vector<PathResult>& results) {
+            const auto start = std::chrono::steady_clock::now();
+            results = graph.runQueries(batch, options, &stats);
+            return elapsedMs(start);
+        };
+        const auto run = [&](std::vector<PathResult>& results) { return runBatch(stream, results); };
+        const auto same = [](const std::vector<PathResult>& a, const std::vector<PathResult>& b) {
+            for (size_t i = 0; i < a.size(); i++) {
+                if (a[i].resultText != b[i].resultText) return false;
+            }
+            return true;
+        };
+
+        std::vector<PathResult> uncached, cached, small;
+        const double offMs = run(uncached);
+        graph.setResultCache(queries.size());
+        const double onMs = run(cached);
+        const double hitRate = graph.getResultCacheStats().hitRate();
+        graph.setResultCache(std::max<size_t>(1, queries.size() / 4));
+        run(small);
+        const double smallRate = graph.getResultCacheStats().hitRate();
+        bool identical = same(uncached, cached) && same(uncached, small);
+
+        // A start moved by a few metres mostly snaps to the same nodes with other walks, which
+        // a hit adds to the cached road part; the printed answer must not change
+        std::vector<Query> moved;
+        for (const Query& query : queries) {
+            moved.push_back(query);
+            for (const double shift : {0.0001, 0.001, 0.02, 0.05}) {
+                moved.push_back(query);
+                moved.back().startX += shift;
+                moved.back().startY -= 0.7 * shift;
+            }
+        }
+        std::vector<PathResult> movedUncached, movedCached;
+        graph.setResultCache(0);
+        runBatch(moved, movedUncached);
+        graph.setResultCache(moved.size());
+        runBatch(moved, movedCached);
+        const double movedRate = graph.getResultCacheStats().hitRate();
+        identical = identical && same(movedUncached, movedCached);
+
+        // Warm cache, then slower roads: nothing cached before may answer
+        graph.setResultCache(queries.size());
+        run(cached);
+        std::vector<SpeedUpdate> updates;
+        const std::shared_ptr<const MapData> loaded = graph.snapshot();
+        const auto& edges = loaded->getEdges();
+        for (size_t i = 0; i < edges.size(); i += 3) updates.push_back({edges[i].first, edges[i].second, 10});
+        graph.updateSpeeds(updates);
+        run(cached);
+        const double updateRate = static_cast<double>(stats.cacheHits) / stream.size();
+        graph.setResultCache(0);
+        run(uncached);
+        identical = identical && same(uncached, cached);
+
+        // Queries grouped by origin are looked up in the cache as well: with room for every answer, a
+        // second pass over the stream mostly hits
+        graph.setResultCache(std::max<size_t>(1024, 2 * queries.size()));
+        options.shareOrigins = true;
+        std::vector<PathResult> shared;
+        run(shared);
+        const ResultCacheStats warm = graph.getResultCacheStats();
+        run(shared);
+        const ResultCacheStats rerun = graph.getResultCacheStats();
+        const double sharedRate = static_cast<double>(rerun.hits - warm.hits) /
+                                  std::max<size_t>(1, rerun.hits + rerun.misses - warm.hits - warm.misses);
+        options.shareOrigins = false;
+
+        graph.setResultCache(0);
+
+        // Every query repeats, so a working cache answers most of the stream
+        const bool served = hitRate >= 0.5 && sharedRate >= 0.5;
+        allSame = allSame && identical && served;
+
+        std::cout << std::left << std::setw(10) << bench.name << std::right << std::setw(9) << stream.size()
+                  << std::fixed << std::setprecision(3) << std::setw(12) << offMs << std::setw(12) << onMs
+                  << std::setprecision(2) << std::setw(10) << hitRate << std::setw(12) << smallRate << std::setw(12)
+                  << updateRate << std::setw(12) << sharedRate << std::setw(12) << movedRate << std::defaultfloat
+                  << std::setw(6)
+                  << (identical ? "yes" : "NO") << (served ? "" : "  hit rate too low") << std::endl;
+    }
+    return allSame ? 0 : 1;
+}
+
+int benchOrder(const std::string& root, const std::vector<std::string>& args) {
+    int runs = 3;
+    std::vector<BenchCase> cases = corpus(root);
+    std::vector<std::string> extraCases;
+    for (size_t i = 0; i < args.size(); i++) {
+        if (args[i] == "--runs" && i + 1 < args.size()) runs = std::max(1, std::atoi(args[++i].c_str()));
+        else extraCases.push_back(args[i]);
+    }
+    for (size_t i = 0; i + 1 < extraCases.size(); i += 2) {
+        cases.push_back({extraCases[i], extraCases[i], extraCases[i + 1], ""});
+    }
+
+    std::cout << std::left << std::setw(10) << "case" << std::setw(10) << "search" << std::right << std::setw(9)
+              << "queries" << std::setw(12) << "input gap" << std::setw(12) << "curve gap" << std::setw(12) << "input ms"
+              << std::setw(12) << "curve ms" << std::setw(9) << "speedup" << std::setw(6) << "same" << std::endl;
+
+    bool allSame = true;
+    MapGraph& graph = MapGraph::instance();
+    for (const auto& bench : cases) {
+        if (!exists(bench.map) || !exists(bench.queries)) {
+            std::cout << std::left << std::setw(10) << bench.name << " skipped (missing input)" << std::endl;
+            continue;
+        }
+        if (!graph.loadMapFromFile(bench.map) || !graph.loadQueriesFromFile(bench.queries)) return 1;
+        const std::vector<Query> queries = graph.getQueries();
+
+        std::vector<size_t> inputOrder(queries.size());
+        for (size_t i = 0; i < inputOrder.size(); i++) inputOrder[i] = i;
+        const auto meanGap = [&](const std::vector<size_t>& order) {
+            double total = 0;
+            for (size_t i = 1; i < order.size(); i++) {
+                const Query& a = queries[order[i - 1]];
+                const Query& b = queries[order[i]];
+                total += std::hypot(a.startX - b.startX, a.startY - b.startY);
+            }
+            return order.size() > 1 ? total / (order.size() - 1) : 0;
+        };
+        const double inputGap = meanGap(inputOrder);
+        const double curveGap = meanGap(MapGraph::localityOrder(queries));
+
+        for (const auto& [name, algorithm] : {std::pair("dijkstra", SearchAlgorithm::Dijkstra), std::pair("astar", SearchAlgorithm::AStar)}) {
+            graph.setSearchAlgorithm(algorithm);
+            const auto best = [&](const BatchOrder order, std::vector<PathResult>& results) {
+                BatchOptions options;
+                options.order = order;
+                double bestMs = std::numeric_limits<double>::infinity();
+                for (int r = 0; r < runs; r++) {
+                    const auto start = std::chrono::steady_clock::now();
+                    results = graph.runQueries(queries, options);
+                    bestMs = std::min(bestMs, elapsedMs(start));
+                }
+                return bestMs;
+            };
+            std::vector<PathResult> input, curve;
+            const double inputMs = best(BatchOrder::Input, input);
+            const double curveMs = best(BatchOrder::Hilbert, curve);
+            bool same = input.size() == curve.size();
+            for (size_t i = 0; same && i < input.size(); i++) same = input[i].resultText == curve[i].resultText;
+            allSame = allSame && same;
+
+            std::cout << std::left << std::setw(10) << bench.name << std::setw(10) << name << std::right << std::setw(9)
+                      << queries.size() << std::fixed << std::setprecision(2) << std::setw(12) << inputGap << std::setw(12)
+                      << curveGap << std::setprecision(3) << std::setw(12) << inputMs << std::setw(12) << curveMs
+                      << std::setprecision(2) << std::setw(9) << inputMs / curveMs << std::defaultfloat << std::setw(6)
+                      << (same ? "yes" : "NO") << std::endl;
+        }
+    }
+    graph.setSearchAlgorithm(SearchAlgorithm::Dijkstra);
+    return allSame ? 0 : 1;
+}
+
+int benchOrigins(const std::string& root, const std::vector<std::string>& extraCases) {
+    constexpr size_t origins = 10, destinations = 100;
+    std::vector<BenchCase> cases = corpus(root);
+    for (size_t i = 0; i + 1 < extraCases.size(); i += 2) {
+        cases.push_back({extraCases[i], extraCases[i], extraCases[i + 1], ""});
+    }
+
+    std::cout << std::left << std::setw(10) << "case" << std::right << std::setw(9) << "queries" << std::setw(9)
+              << "starts" << std::setw(12) << "single ms" << std::setw(12) << "shared ms" << std::setw(9) << "speedup"
+              << std::setw(16) << "single settled" << std::setw(16) << "shared settled" << std::setw(10) << "dijkstra"
+              << std::setw(10) << "astar" << std::endl;
+
+    bool allSame = true;
+    MapGraph& graph = MapGraph::instance();
+    graph.setSearchAlgorithm(SearchAlgorithm::Dijkstra);
+    for (const auto& bench : cases) {
+        if (!exists(bench.map) || !exists(bench.queries)) {
+            std::cout << std::left << std::setw(10) << bench.name << " skipped (missing input)" << std::endl;
+            continue;
+        }
+        if (!graph.loadMapFromFile(bench.map) || !graph.loadQueriesFromFile(bench.queries)) return 1;
+        const std::vector<Query>& queries = graph.getQueries();
+
+        std::vector<Query> batch;
+        const size_t starts = std::min(origins, queries.size());
+        for (size_t i = 0; i < starts; i++) {
+            for (size_t j = 0; j < std::min(destinations, queries.size()); j++) {
+                batch.push_back({queries[i].startX, queries[i].startY, queries[j].endX, queries[j].endY, queries[i].R});
+            }
+        }
+
+        const auto run = [&](const bool share, std::vector<PathResult>& results) {
+            graph.setSearchAlgorithm(SearchAlgorithm::Dijkstra);
+            BatchOptions options;
+            options.shareOrigins = share;
+            const auto start = std::chrono::steady_clock::now();
+            results = graph.runQueries(batch, options);
+            return elapsedMs(start);
+        };
+        const auto settled = [](const std::vector<PathResult>& results) {
+            size_t total = 0;
+            for (const PathResult& result : results) total += result.stats.settledNodes;
+            return total;
+        };
+        const auto sameTimes = [&](const std::vector<PathResult>& a, const std::vector<PathResult>& b) {
+            size_t count = 0;
+            for (size_t i = 0; i < a.size(); i++) {
+                const double x = a[i].travelTime, y = b[i].travelTime;
+                count += x == y || std::fabs(x - y) <= 1e-9 * std::max(1.0, std::fabs(x));
+            }
+            return count;
+        };
+        std::vector<PathResult> single, shared;
+        const double singleMs = run(false, single);
+        const double sharedMs = run(true, shared);
+        graph.setSearchAlgorithm(SearchAlgorithm::AStar);
+        const std::vector<PathResult> astar = graph.runQueries(batch);
+        graph.setSearchAlgorithm(SearchAlgorithm::Dijkstra);
+        const size_t sameDijkstra = sameTimes(single, shared);
+        const size_t sameAstar = sameTimes(astar, shared);
+        allSame = allSame && sameAstar == batch.size();
+
+        std::cout << std::left << std::setw(10) << bench.name << std::right << std::setw(9) << batch.size() << std::setw(9)
+                  << starts << std::fixed << std::setprecision(3) << std::setw(12) << singleMs << std::setw(12) << sharedMs
+                  << std::setprecision(2) << std::setw(9) << singleMs / sharedMs << std::defaultfloat << std::setw(16)
+                  << settled(single) << std::setw(16) << settled(shared) << std::setw(10) << sameDijkstra
+                  << std::setw(10) << sameAstar << std::endl;
+    }
+    return allSame ? 0 : 1;
+}
+
+int benchRadius(const std::string& root) {
+    constexpr int repeats = 5;
+    std::cout << std::left << std::setw(10) << "case" << std::right << std::setw(10) << "nodes" << std::setw(10)
+              << "lookups" << std::setw(12) << "scan ms" << std::setw(12) << "grid ms" << std::setw(10) << "speedup"
+              << std::endl;
+
+    for (const auto& [name, mapFile, queryFile, expectedFile] : corpus(root)) {
+        if (!exists(mapFile) || !exists(queryFile)) {
+            std::cout << std::left << std::setw(10) << name << " skipped (missing " << (exists(mapFile) ? queryFile : mapFile)
+                      << ")" << std::endl;
+            continue;
+        }
+        MapGraph& graph = MapGraph::instance();
+        if (!graph.loadMapFromFile(mapFile) || !graph.loadQueriesFromFile(queryFile)) return 1;
+        const std::shared_ptr<const MapData> map = graph.snapshot();
+        const std::vector<std::pair<double, double>> nodes(map->getNodes().begin(), map->getNodes().end());
+        const SpatialGrid& grid = map->getSpatialIndex();
+
+        // Each query snaps both its endpoints
+        std::vector<std::pair<double, double>> points;
+        std::vector<double> radii;
+        for (const Query& q : graph.getQueries()) {
+            points.emplace_back(q.startX, q.startY);
+            points.emplace_back(q.endX, q.endY);
+            radii.push_back(q.R);
+            radii.push_back(q.R);
+        }
+
+        std::vector<int> scanHits, gridHits;
+        size_t checksum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < repeats; r++) {
+            for (size_t i = 0; i < points.size(); i++) {
+                scanHits.clear();
+                linearScan(nodes, points[i].first, points[i].second, radii[i], scanHits);
+                checksum += scanHits.size();
+            }
+        }
+        const double scanMs = elapsedMs(start) / repeats;
+
+        start = std::chrono::steady_clock::now();
+        for (int r = 0; r < repeats; r++) {
+            for (size_t i = 0; i < points.size(); i++) {
+                gridHits.clear();
+                grid.forEachWithin(points[i].first, points[i].second, radii[i],
+                                   [&](const int node, double) { gridHits.push_back(node); });
+                checksum -= gridHits.size();
+            }
+        }
+        const double gridMs = elapsedMs(start) / repeats;
+
+        // Both lookups must return the same node sets
+        for (size_t i = 0; i < points.size(); i++) {
+            scanHits.clear();
+            gridHits.clear();
+            linearScan(nodes, points[i].first, points[i].second, radii[i], scanHits);
+            grid.forEachWithin(points[i].first, points[i].second, radii[i],
+                               [&](const int node, double) { gridHits.push_back(node); });
+            std::sort(gridHits.begin(), gridHits.end());
+            if (scanHits != gridHits) {
+                std::cerr << name << ": spatial index disagrees with the linear scan at lookup " << i << std::endl;
+                return 1;
+            }
+        }
+        if (checksum != 0) return 1;
+
+        std::cout << std::left << std::setw(10) << name << std::right << std::setw(10) << nodes.size() << std::setw(10)
+                  << points.size() << std::fixed << std::setprecision(3) << std::setw(12) << scanMs << std::setw(12)
+                  << gridMs << std::setw(9) << std::setprecision(1) << scanMs / std::max(gridMs, 1e-6) << "x"
+                  << std::defaultfloat << std::endl;
+    }
+    return 0;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    const std::string mode = argc > 1 ? argv[1] : "radius";
+    const std::string root = argc > 2 ? argv[2] : "TEST CASES";
+
+    if (mode == "radius") return benchRadius(root);
+    if (mode == "load") return benchLoad(root, std::vector<std::string>(argv + std::min(argc, 3), argv + argc));
+    if (mode == "weights") return benchWeights(root);
+    if (mode == "search") return benchSearch(root, std::vector<std::string>(argv + std::min(argc, 3), argv + argc));
+    if (mode == "matrix") return benchMatrix(root, std::vector<std::string>(argv + std::min(argc, 3), argv + argc));
+    if (mode == "queues") return benchQueues(root, std::vector<std::string>(argv + std::min(argc, 3), argv + argc));
+    if (mode == "suite") return benchSuite(std::vector<std::string>(argv + std::min(argc, 2), argv + argc));
+    if (mode == "isochrone") return benchIsochrone(root, std::vector<std::string>(argv + std::min(argc, 3), argv + argc));
+    if (mode == "reload") return benchReload(root, std::vector<std::string>(argv + std::min(argc, 3), argv + argc));
+    if (mode == "updates") return benchUpdates(root, std::vector<std::string>(argv + std::min(argc, 3), argv + argc));
+    if (mode == "profiles") return benchProfiles(root, std::vector<std::string>(argv + std::min(argc, 3), argv + argc));
+    if (mode == "cache") return benchCache(root, std::vector<std::string>(argv + std::min(argc, 3), argv + argc));
+    if (mode == "order") return benchOrder(root, std::vector<std::string>(argv + std::min(argc, 3), argv + argc));
+    if (mode == "origins") return benchOrigins(root, std::vector<std::string>(argv + std::min(argc, 3), argv + argc));
+
+    std::cerr << "Usage: maproute-bench radius [casesRoot]\n"
+                 "       maproute-bench load [casesRoot] [extra map files...]\n"
+                 "       maproute-bench weights [casesRoot]\n"
+                 "       maproute-bench search [casesRoot] [extra map/queries file pairs...]\n"
+                 "       maproute-bench matrix [casesRoot] [extra map/queries file pairs...]\n"
+                 "       maproute-bench isochrone [casesRoot] [extra map/queries file pairs...]\n"
+                 "       maproute-bench queues [casesRoot] [extra map/queries file pairs...]\n"
+                 "       maproute-bench suite [casesRoot] [--runs N] [--warmup N] [--threads N] [--search A]\n"
+                 "       maproute-bench reload [casesRoot] [extra map/queries file pairs...]\n"
+                 "       maproute-bench updates [casesRoot] [extra map/queries file pairs...]\n"
+                 "       maproute-bench profiles [casesRoot] [extra map/queries file pairs...]\n"
+                 "       maproute-bench cache [casesRoot] [extra map/queries file pairs...]\n"
+                 "       maproute-bench order [casesRoot] [--runs N] [extra map/queries file pairs...]\n"
+                 "       maproute-bench origins [casesRoot] [extra map/queries file pairs...]" << std::endl;
+    return 2;
+}
@@ -0,0 +1,513 @@
+// Headless batch runner: loads a map and a query file, answers every query
+// and writes the results in the same format as TEST CASES/*/Output.
+//
+//   maproute-cli <map> <queries> <output> [--threads N] [--weights double|float|fixed]
+//                [--search dijkstra|astar|alt|ch|overlay] [--landmarks K] [--landmark-selection farthest|avoid] [--ch]
+//                [--queue binary|4ary|radix] [--stats <csv>] [--updates <file|-> [--update-batch N]]
+//                [--profiles <file> --depart HH:MM] [--cache N] [--order input|hilbert] [--share-origins]
+//   maproute-cli --convert <map> <snapshot> [--landmarks K] [--landmark-selection farthest|avoid] [--ch]
+//                [--search overlay]
+//   maproute-cli --matrix <map> <sources> <targets> <output> [--threads N] [--weights T] [--ch]
+//   maproute-cli --isochrone <map> <x> <y> <R> <minutes> <output> [--threads N] [--weights T] [--ch]
+//
+// A JSON object with the timing breakdown is printed on stdout, for a query
+// batch with the p50/p95/p99 of the per-query work and phase times; --stats
+// writes those per query as CSV, one row per query in input order. --convert
+// writes a binary snapshot that loads without parsing; any command taking
+// a map accepts either format. Landmark tables built for --landmarks are
+// stored in the snapshot and reused by later runs with the same settings,
+// and so is the contraction hierarchy built for --ch. The overlay of
+// --search overlay keeps its partition, and its cliques for the same weights.
+//
+// --matrix reads two point files ("count", then "x y R" lines with R in
+// metres) and writes "rows cols", the travel times in minutes (one row per
+// source), a blank line and the distances in km; -1 marks a missing path.
+// With --ch the matrix comes from the bucket many-to-many search.
+//
+// --isochrone writes every node reachable from (x, y) within the budget,
+// walking at most R metres: "count", then "node minutes km" lines by node
+// id. With --ch it comes from the parallel PHAST sweep.
+//
+// --updates reads "from to speed" records (km/h, "-" for stdin) and applies
+// them to the loaded map in batches of --update-batch records before any of
+// the modes runs, so --convert can also write an updated snapshot.
+//
+// --profiles loads daily speed profiles ("count", then "from to k minute1
+// factor1 ... minuteK factorK" per road) and --depart answers the query
+// batch with the time-dependent search, every query leaving at that time.
+//
+// --cache keeps up to N answers in the result cache, so a query that snaps to
+// the same candidate nodes as an earlier one is not searched again. The JSON
+// then reports the cache hits, misses and evictions.
+//
+// --order hilbert works through the batch sorted along a Hilbert curve over
+// the start and end points, so each worker answers neighbouring queries one
+// after the other; the output keeps the input order.
+//
+// --share-origins answers the queries with the same start and R with one
+// one-to-many Dijkstra search (dijkstra search only).
+
+#include "mapgraph.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct CliOptions {
+    std::string mapFile;
+    std::string queriesFile;
+    std::string outputFile;
+    std::string targetsFile; // --matrix
+    std::string statsFile;
+    std::string updatesFile;
+    size_t updateBatch = 1000;
+    std::string profilesFile;
+    double departure = -1; // minutes after midnight
+    size_t cacheSize = 0;
+    BatchOrder order = BatchOrder::Input;
+    bool shareOrigins = false;
+    double x = 0, y = 0, R = 0, budget = 0; // --isochrone, R in km
+    unsigned threads = 0;
+    WeightType weights = WeightType::Double;
+    SearchAlgorithm search = SearchAlgorithm::Dijkstra;
+    QueueType queue = QueueType::Binary;
+    int landmarks = -1; // -1 = default for the search
+    LandmarkSelection landmarkSelection = LandmarkSelection::Avoid;
+    bool hierarchy = false;
+    bool convert = false;
+    bool matrix = false;
+    bool isochrone = false;
+};
+
+void printUsage() {
+    std::cerr << "Usage: maproute-cli <map> <queries> <output> [--threads N] [--weights double|float|fixed]\n"
+                 "                   [--search dijkstra|astar|alt|ch|overlay] [--landmarks K] [--landmark-selection farthest|avoid] [--ch]\n"
+                 "                   [--queue binary|4ary|radix] [--stats <csv>] [--updates <file|-> [--update-batch N]]\n"
+                 "                   [--profiles <file> --depart HH:MM] [--cache N] [--order input|hilbert]\n"
+                 "                   [--share-origins]\n"
+                 "       maproute-cli --convert <map> <snapshot> [--landmarks K] [--landmark-selection farthest|avoid] [--ch]\n"
+                 "                   [--search overlay]\n"
+                 "       maproute-cli --matrix <map> <sources> <targets> <output> [--threads N] [--weights T] [--ch]\n"
+                 "       maproute-cli --isochrone <map> <x> <y> <R> <minutes> <output> [--threads N] [--weights T] [--ch]\n"
+                 "  --threads N   worker threads for the query batch (default: one per hardware thread)\n"
+                 "  --weights T   arc weight type of the search kernel (default: double)\n"
+                 "  --search A    point-to-point search: bidirectional Dijkstra, A*, ALT, contraction hierarchy\n"
+                 "                or multilevel overlay (default: dijkstra)\n"
+                 "  --queue Q     priority queue of the Dijkstra kernels (default: binary)\n"
+                 "  --stats F     write the work and phase times of every query to F as CSV\n"
+                 "  --updates F   apply the \"from to speed\" records of F (- for stdin) after loading the map\n"
+                 "  --update-batch N\n"
+                 "                speed updates published together (default: 1000)\n"
+                 "  --profiles F  daily speed profiles of the roads in F\n"
+                 "  --depart T    departure time (HH:MM or minutes after midnight) of every query, uses the profiles\n"
+                 "  --cache N     answer repeated queries from a cache of N results (default: off)\n"
+                 "  --order O     order the batch is worked through in, the output keeps the input order\n"
+                 "                (default: input)\n"
+                 "  --share-origins\n"
+                 "                one search for all queries with the same start and R (dijkstra only)\n"
+                 "  --landmarks K landmarks built at load time (default: the snapshot's, else 16 for alt and 0 otherwise)\n"
+                 "  --landmark-selection S\n"
+                 "                how landmarks are picked (default: avoid)\n"
+                 "  --ch          build the contraction hierarchy at load time (implied by --search ch)\n"
+                 "  --convert     write the map as a binary snapshot\n"
+                 "  --matrix      write the travel-time matrix between two point files\n"
+                 "  --isochrone   write the nodes reachable within a time budget, R in metres"
+              << std::endl;
+}
+
+// Whole-string integer, false on an empty value or trailing characters
+bool parseInteger(const char* text, long& value) {
+    char* end = nullptr;
+    errno = 0;
+    value = std::strtol(text, &end, 10);
+    return end != text && *end == '\0' && errno == 0;
+}
+
+bool parseArguments(const int argc, char* argv[], CliOptions& options) {
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            long threads = 0;
+            if (!parseInteger(argv[++i], threads) || threads < 0) return false;
+            options.threads = static_cast<unsigned>(threads);
+        } else if (arg == "--weights" && i + 1 < argc) {
+            const std::string type = argv[++i];
+            if (type == "double") options.weights = WeightType::Double;
+            else if (type == "float") options.weights = WeightType::Float;
+            else if (type == "fixed") options.weights = WeightType::FixedPoint;
+            else return false;
+        } else if (arg == "--search" && i + 1 < argc) {
+            const std::string algorithm = argv[++i];
+            if (algorithm == "dijkstra") options.search = SearchAlgorithm::Dijkstra;
+            else if (algorithm == "astar") options.search = SearchAlgorithm::AStar;
+            else if (algorithm == "alt") options.search = SearchAlgorithm::Alt;
+            else if (algorithm == "ch") options.search = SearchAlgorithm::Ch;
+            else if (algorithm == "overlay") options.search = SearchAlgorithm::Overlay;
+            else return false;
+        } else if (arg == "--queue" && i + 1 < argc) {
+            const std::string queue = argv[++i];
+            if (queue == "binary") options.queue = QueueType::Binary;
+            else if (queue == "4ary") options.queue = QueueType::QuadHeap;
+            else if (queue == "radix") options.queue = QueueType::Radix;
+            else return false;
+        } else if (arg == "--order" && i + 1 < argc) {
+            const std::string order = argv[++i];
+            if (order == "input") options.order = BatchOrder::Input;
+            else if (order == "hilbert") options.order = BatchOrder::Hilbert;
+            else return false;
+        } else if (arg == "--share-origins") {
+            options.shareOrigins = true;
+        } else if (arg == "--stats" && i + 1 < argc) {
+            options.statsFile = argv[++i];
+        } else if (arg == "--updates" && i + 1 < argc) {
+            options.updatesFile = argv[++i];
+        } else if (arg == "--profiles" && i + 1 < argc) {
+            options.profilesFile = argv[++i];
+        } else if (arg == "--depart" && i + 1 < argc) {
+            const char* text = argv[++i];
+            char* end = nullptr;
+            options.departure = std::strtod(text, &end);
+            if (end != text && *end == ':') options.departure = options.departure * 60 + std::strtod(end + 1, &end);
+            if (end == text || *end != '\0' || !(options.departure >= 0)) return false;
+        } else if (arg == "--cache" && i + 1 < argc) {
+            long entries = 0;
+            if (!parseInteger(argv[++i], entries) || entries < 0) return false;
+            options.cacheSize = static_cast<size_t>(entries);
+        } else if (arg == "--update-batch" && i + 1 < argc) {
+            long batch = 0;
+            if (!parseInteger(argv[++i], batch) || batch <= 0) return false;
+            options.updateBatch = static_cast<size_t>(batch);
+        } else if (arg == "--landmarks" && i + 1 < argc) {
+            long landmarks = 0;
+            if (!parseInteger(argv[++i], landmarks) || landmarks < 0) return false;
+            options.landmarks = static_cast<int>(landmarks);
+        } else if (arg == "--landmark-selection" && i + 1 < argc) {
+            const std::string selection = argv[++i];
+            if (selection == "farthest") options.landmarkSelection = LandmarkSelection::Farthest;
+            else if (selection == "avoid") options.landmarkSelection = LandmarkSelection::Avoid;
+            else return false;
+        } else if (arg == "--ch") {
+            options.hierarchy = true;
+        } else if (arg == "--convert") {
+            options.convert = true;
+        } else if (arg == "--matrix") {
+            options.matrix = true;
+        } else if (arg == "--isochrone") {
+            options.isochrone = true;
+        } else if (arg == "-h" || arg == "--help" || arg.rfind("--", 0) == 0) {
+            return false;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (options.convert) {
+        if (positional.size() != 2) return false;
+        options.mapFile = positional[0];
+        options.outputFile = positional[1];
+        return true;
+    }
+    if (options.matrix) {
+        if (positional.size() != 4) return false;
+        options.mapFile = positional[0];
+        options.queriesFile = positional[1];
+        options.targetsFile = positional[2];
+        options.outputFile = positional[3];
+        return true;
+    }
+    if (options.isochrone) {
+        if (positional.size() != 6) return false;
+        char* end = nullptr;
+        double* fields[] = {&options.x, &options.y, &options.R, &options.budget};
+        for (size_t i = 0; i < 4; i++) {
+            *fields[i] = std::strtod(positional[i + 1].c_str(), &end);
+            if (*end != '\0') return false;
+        }
+        if (options.R < 0 || options.budget < 0) return false;
+        options.R /= 1000; // Convert to km
+        options.mapFile = positional[0];
+        options.outputFile = positional[5];
+        return true;
+    }
+    if (positional.size() != 3) return false;
+    options.mapFile = positional[0];
+    options.queriesFile = positional[1];
+    options.outputFile = positional[2];
+    return true;
+}
+
+// "name": {"p50": .., "p95": .., "p99": ..}
+void writePercentiles(std::ostream& out, const char* name, const Percentiles& values) {
+    out << "\"" << name << "\": {\"p50\": " << values.p50 << ", \"p95\": " << values.p95 << ", \"p99\": " << values.p99 << "}";
+}
+
+bool writeQueryStats(const std::string& filename, const std::vector<PathResult>& results) {
+    std::ofstream out(filename);
+    if (!out.is_open()) {
+        std::cerr << "Error opening stats file: " << filename << std::endl;
+        return false;
+    }
+    out << "query,start_candidates,end_candidates,settled_nodes,relaxed_arcs,queue_pushes,queue_pops,"
+           "snap_ms,search_ms,path_ms,format_ms,total_ms,cache_hit\n" << std::fixed << std::setprecision(4);
+    for (size_t i = 0; i < results.size(); i++) {
+        const QueryStats& query = results[i].stats;
+        out << i + 1 << "," << query.startCandidates << "," << query.endCandidates << "," << query.settledNodes << ","
+            << query.relaxedArcs << "," << query.queuePushes << "," << query.queuePops << "," << query.snapMs << ","
+            << query.searchMs << "," << query.pathMs << "," << query.formatMs << "," << query.totalMs << ","
+            << query.cacheHit << "\n";
+    }
+    out.close();
+    if (out.fail()) {
+        std::cerr << "Error writing stats file: " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+double elapsedMs(const std::chrono::high_resolution_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+int runMatrix(MapGraph& graph, const CliOptions& options, const double mapMs) {
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<MatrixPoint> sources, targets;
+    if (!MapGraph::loadMatrixPoints(options.queriesFile, sources) || !MapGraph::loadMatrixPoints(options.targetsFile, targets)) {
+        return 1;
+    }
+    const double pointsLoadMs = elapsedMs(start);
+
+    BatchStats stats;
+    const TravelMatrix matrix = graph.travelMatrix(sources, targets, &stats);
+
+    start = std::chrono::high_resolution_clock::now();
+    std::ofstream out(options.outputFile);
+    if (!out.is_open()) {
+        std::cerr << "Error opening output file: " << options.outputFile << std::endl;
+        return 1;
+    }
+    out << matrix.rows << " " << matrix.cols << "\n" << std::fixed << std::setprecision(2);
+    for (const std::vector<double>* values : {&matrix.times, &matrix.distances}) {
+        for (size_t row = 0; row < matrix.rows; row++) {
+            for (size_t col = 0; col < matrix.cols; col++) {
+                const double value = (*values)[row * matrix.cols + col];
+                out << (col ? " " : "") << (value == std::numeric_limits<double>::infinity() ? -1.0 : value);
+            }
+            out << "\n";
+        }
+        if (values == &matrix.times) out << "\n";
+    }
+    out.close();
+    if (out.fail()) {
+        std::cerr << "Error writing output file: " << options.outputFile << std::endl;
+        return 1;
+    }
+    const double writeMs = elapsedMs(start);
+
+    const LoadStats load = graph.snapshot()->getLoadStats();
+    std::cout << std::fixed << std::setprecision(3)
+              << "{\"sources\": " << matrix.rows
+              << ", \"targets\": " << matrix.cols
+              << ", \"threads\": " << stats.threads
+              << ", \"load_ms\": " << load.parseMs
+              << ", \"hierarchy_ms\": " << load.hierarchyMs
+              << ", \"points_load_ms\": " << pointsLoadMs
+              << ", \"matrix_ms\": " << stats.elapsedMs
+              << ", \"write_ms\": " << writeMs
+              << ", \"total_ms\": " << mapMs + pointsLoadMs + stats.elapsedMs + writeMs
+              << ", \"cells_per_second\": " << stats.queriesPerSecond << "}" << std::endl;
+    return 0;
+}
+
+int runIsochrone(MapGraph& graph, const CliOptions& options, const double mapMs) {
+    auto start = std::chrono::high_resolution_clock::now();
+    Isochrone isochrone;
+    if (options.hierarchy) {
+        isochrone = graph.findReachableNodesParallel(options.x, options.y, options.R, options.budget);
+    } else {
+        QueryWorkspace workspace;
+        isochrone = graph.findReachableNodes(options.x, options.y, options.R, options.budget, workspace);
+    }
+    const double searchMs = elapsedMs(start);
+
+    start = std::chrono::high_resolution_clock::now();
+    std::vector<ReachedNode> nodes = isochrone.nodes;
+    std::sort(nodes.begin(), nodes.end(), [](const ReachedNode& a, const ReachedNode& b) { return a.node < b.node; });
+    std::ofstream out(options.outputFile);
+    if (!out.is_open()) {
+        std::cerr << "Error opening output file: " << options.outputFile << std::endl;
+        return 1;
+    }
+    out << nodes.size() << "\n" << std::fixed << std::setprecision(2);
+    for (const auto& [node, time, distance] : nodes) out << node << " " << time << " " << distance << "\n";
+    out.close();
+    if (out.fail()) {
+        std::cerr << "Error writing output file: " << options.outputFile << std::endl;
+        return 1;
+    }
+    const double writeMs = elapsedMs(start);
+
+    const LoadStats load = graph.snapshot()->getLoadStats();
+    std::cout << std::fixed << std::setprecision(3)
+              << "{\"reached_nodes\": " << nodes.size()
+              << ", \"settled_nodes\": " << isochrone.settledNodes
+              << ", \"load_ms\": " << load.parseMs
+              << ", \"hierarchy_ms\": " << load.hierarchyMs
+              << ", \"search_ms\": " << searchMs
+              << ", \"write_ms\": " << writeMs
+              << ", \"total_ms\": " << mapMs + searchMs + writeMs << "}" << std::endl;
+    return 0;
+}
+
+// Streams the update records into the map batch by batch, prints one JSON line per batch on stderr
+bool applyUpdates(MapGraph& graph, const CliOptions& options) {
+    std::ifstream file;
+    if (options.updatesFile != "-") {
+        file.open(options.updatesFile);
+        if (!file.is_open()) {
+            std::cerr << "Error opening updates file: " << options.updatesFile << std::endl;
+            return false;
+        }
+    }
+    std::istream& in = options.updatesFile == "-" ? std::cin : file;
+
+    std::vector<SpeedUpdate> updates;
+    size_t batch = 0;
+    while (true) {
+        if (!MapGraph::readSpeedUpdates(in, options.updateBatch, updates)) return false;
+        if (updates.empty()) {
+            // The modes below run on the final speeds, with the hierarchy built for them
+            graph.waitForHierarchy();
+            return true;
+        }
+        const auto start = std::chrono::high_resolution_clock::now();
+        const size_t applied = graph.updateSpeeds(updates);
+        std::cerr << std::fixed << std::setprecision(3) << "{\"update_batch\": " << batch++
+                  << ", \"updates\": " << updates.size() << ", \"applied\": " << applied
+                  << ", \"update_ms\": " << elapsedMs(start) << "}" << std::endl;
+    }
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    CliOptions options;
+    if (!parseArguments(argc, argv, options)) {
+        printUsage();
+        return 2;
+    }
+
+    MapGraph& graph = MapGraph::instance();
+    graph.setThreadCount(options.threads);
+    graph.setWeightType(options.weights);
+    graph.setSearchAlgorithm(options.search);
+    graph.setQueueType(options.queue);
+    graph.setResultCache(options.cacheSize);
+    graph.setLandmarks(std::max(options.landmarks, 0), options.landmarkSelection);
+    graph.setContractionHierarchy(options.hierarchy || options.search == SearchAlgorithm::Ch);
+    graph.setMultilevelOverlay(options.search == SearchAlgorithm::Overlay);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    if (!graph.loadMapFromFile(options.mapFile)) return 1;
+    // ALT without a count uses the snapshot's tables, or builds a default set
+    if (options.landmarks < 0 && options.search == SearchAlgorithm::Alt && graph.snapshot()->getLandmarks().empty()) {
+        graph.setLandmarks(16, options.landmarkSelection);
+    }
+    const double mapMs = elapsedMs(start);
+    if (!options.updatesFile.empty() && !applyUpdates(graph, options)) return 1;
+    if (!options.profilesFile.empty() && !graph.loadSpeedProfiles(options.profilesFile)) return 1;
+
+    if (options.convert) {
+        start = std::chrono::high_resolution_clock::now();
+        if (!graph.saveSnapshot(options.outputFile)) return 1;
+        std::cout << std::fixed << std::setprecision(3) << "{\"load_ms\": " << mapMs
+                  << ", \"write_ms\": " << elapsedMs(start) << "}" << std::endl;
+        return 0;
+    }
+
+    if (options.matrix) return runMatrix(graph, options, mapMs);
+    if (options.isochrone) return runIsochrone(graph, options, mapMs);
+
+    start = std::chrono::high_resolution_clock::now();
+    if (!graph.loadQueriesFromFile(options.queriesFile)) return 1;
+    const double queriesLoadMs = elapsedMs(start);
+
+    BatchStats stats;
+    BatchOptions batch;
+    batch.departure = options.departure;
+    batch.order = options.order;
+    batch.shareOrigins = options.shareOrigins;
+    const std::vector<PathResult> results = graph.runQueries(graph.getQueries(), batch, &stats);
+
+    start = std::chrono::high_resolution_clock::now();
+    std::ofstream out(options.outputFile);
+    if (!out.is_open()) {
+        std::cerr << "Error opening output file: " << options.outputFile << std::endl;
+        return 1;
+    }
+    size_t settledNodes = 0, queuePushes = 0, queuePops = 0;
+    for (const auto& res : results) {
+        out << res.resultText << "\n";
+        settledNodes += res.stats.settledNodes;
+        queuePushes += res.stats.queuePushes;
+        queuePops += res.stats.queuePops;
+    }
+    const double writeMs = elapsedMs(start);
+
+    // Same trailer as the GUI: query time, then total time including I/O
+    const double totalMs = mapMs + queriesLoadMs + stats.elapsedMs + writeMs;
+    out << static_cast<long long>(stats.elapsedMs) << " ms\n\n";
+    out << static_cast<long long>(totalMs) << " ms\n";
+    out.close();
+    if (out.fail()) {
+        std::cerr << "Error writing output file: " << options.outputFile << std::endl;
+        return 1;
+    }
+    if (!options.statsFile.empty() && !writeQueryStats(options.statsFile, results)) return 1;
+
+    const LoadStats load = graph.snapshot()->getLoadStats();
+    std::cout << std::fixed << std::setprecision(3)
+              << "{\"queries\": " << results.size()
+              << ", \"threads\": " << stats.threads
+              << ", \"load_ms\": " << load.parseMs
+              << ", \"index_build_ms\": " << load.indexMs
+              << ", \"landmark_ms\": " << load.landmarkMs
+              << ", \"hierarchy_ms\": " << load.hierarchyMs
+              << ", \"partition_ms\": " << load.partitionMs
+              << ", \"customize_ms\": " << load.customizeMs
+              << ", \"overlay_levels\": " << load.overlayLevels
+              << ", \"overlay_dropped_levels\": " << load.overlayDroppedLevels
+              << ", \"queries_load_ms\": " << queriesLoadMs
+              << ", \"settled_nodes\": " << settledNodes
+              << ", \"queue_pushes\": " << queuePushes
+              << ", \"queue_pops\": " << queuePops
+              << ", \"query_ms\": " << stats.elapsedMs
+              << ", \"write_ms\": " << writeMs
+              << ", \"total_ms\": " << totalMs
+              << ", \"queries_per_second\": " << stats.queriesPerSecond;
+    if (options.cacheSize > 0) {
+        const ResultCacheStats cache = graph.getResultCacheStats();
+        std::cout << ", \"cache\": {\"hits\": " << cache.hits << ", \"misses\": " << cache.misses
+                  << ", \"hit_rate\": " << cache.hitRate() << ", \"evictions\": " << cache.evictions
+                  << ", \"entries\": " << cache.entries << ", \"capacity\": " << cache.capacity << "}";
+    }
+    std::cout << ", \"per_query\": {";
+    const std::pair<const char*, const Percentiles*> distributions[] = {
+        {"total_ms", &stats.totalMs}, {"snap_ms", &stats.snapMs}, {"search_ms", &stats.searchMs},
+        {"path_ms", &stats.pathMs}, {"format_ms", &stats.formatMs}, {"candidates", &stats.candidates},
+        {"settled_nodes", &stats.settledNodes}, {"relaxed_arcs", &stats.relaxedArcs},
+        {"queue_pushes", &stats.queuePushes}, {"queue_pops", &stats.queuePops}};
+    for (const auto& [name, values] : distributions) {
+        if (values != &stats.totalMs) std::cout << ", ";
+        writePercentiles(std::cout, name, *values);
+    }
+    std::cout << "}}" << std::endl;
+    return 0;
+}
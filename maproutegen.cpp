@@ -0,0 +1,326 @@
+// Synthetic road network generator for scale tests. Writes a map in the text
+// format of TEST CASES/*/Input and a matching query file.
+//
+//   maproute-gen <map> <queries> [--nodes N | --grid W H] [--queries Q] [--radius M]
+//                [--seed S] [--spacing KM] [--jitter F] [--drop F] [--diagonals F] [--snapshot <file>]
+//
+// The network is a W x H grid with perturbed node positions: every 8th line
+// is an arterial and every 32nd a highway, the rest are local streets. A
+// share of the local streets is dropped (never below degree 2 at either end)
+// and a share of the cells gets a diagonal, which keeps the graph planar.
+// Lengths are the straight-line distance with a small detour factor.
+//
+// Every random choice is a hash of the seed and the element, so the edges
+// are enumerated twice (count, then write) and never held in memory; 50M
+// edges take only the W x H degree bytes. --snapshot also writes the map as
+// a binary snapshot. A JSON summary is printed on stdout.
+
+#include "mapgraph.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct GenOptions {
+    std::string mapFile;
+    std::string queriesFile;
+    std::string snapshotFile;
+    long long width = 1000;
+    long long height = 1000;
+    long long queries = 1000;
+    double radius = 300; // metres, like the query files
+    uint64_t seed = 1;
+    double spacing = 0.1; // km between grid lines
+    double jitter = 0.3;  // node offset, share of the spacing
+    double drop = 0.1;    // share of local streets removed
+    double diagonals = 0.05;
+};
+
+// Random streams, one per kind of choice
+enum Stream : uint64_t { JitterX = 1, JitterY, Speed, Drop, Diagonal, Detour, QueryPoint };
+
+uint64_t mix(uint64_t x) {
+    // splitmix64 finalizer
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// Uniform in [0, 1), the same for the same seed, stream and index
+double uniform(const uint64_t seed, const Stream stream, const uint64_t index) {
+    return static_cast<double>(mix(seed ^ mix(stream * 0x100000001b3ULL ^ mix(index))) >> 11) * 0x1.0p-53;
+}
+
+class RoadGrid {
+public:
+    explicit RoadGrid(const GenOptions& options) : options(options), width(options.width), height(options.height) {}
+
+    [[nodiscard]] long long nodeCount() const { return width * height; }
+    [[nodiscard]] std::pair<double, double> position(const long long node) const {
+        const long long row = node / width, col = node % width;
+        return {(col + options.jitter * (uniform(options.seed, JitterX, node) - 0.5)) * options.spacing,
+                (row + options.jitter * (uniform(options.seed, JitterY, node) - 0.5)) * options.spacing};
+    }
+
+    // Calls emit(from, to, km, speed) for every road, in the same order on every call
+    template <typename Emit>
+    void forEachRoad(const Emit& emit) {
+        degree.assign(static_cast<size_t>(nodeCount()), 0);
+        for (long long row = 0; row < height; row++) {
+            for (long long col = 0; col < width; col++) {
+                degree[row * width + col] = (col > 0) + (col + 1 < width) + (row > 0) + (row + 1 < height);
+            }
+        }
+        for (long long row = 0; row < height; row++) {
+            for (long long col = 0; col < width; col++) {
+                const long long node = row * width + col;
+                if (col + 1 < width) road(node, node + 1, row, 0, emit);
+                if (row + 1 < height) road(node, node + width, col, 1, emit);
+                if (row + 1 < height && col + 1 < width && uniform(options.seed, Diagonal, node) < options.diagonals) {
+                    // One diagonal per cell, so no two roads cross
+                    if (uniform(options.seed, Diagonal, ~node) < 0.5) {
+                        emit(node, node + width + 1, length(node, node + width + 1, node), 30);
+                    } else {
+                        emit(node + 1, node + width, length(node + 1, node + width, node), 30);
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    // Road from -> to on grid line `line`, direction 0 = along a row, 1 = along a column
+    template <typename Emit>
+    void road(const long long from, const long long to, const long long line, const int direction, const Emit& emit) {
+        const uint64_t index = static_cast<uint64_t>(from) * 2 + direction;
+        const double pick = uniform(options.seed, Speed, index);
+        int speed;
+        if (line % 32 == 0) {
+            speed = pick < 0.5 ? 100 : 120; // highway
+        } else if (line % 8 == 0) {
+            speed = pick < 0.5 ? 60 : 80; // arterial
+        } else {
+            speed = 20 + 10 * static_cast<int>(pick * 4); // local street, 20 to 50
+            if (uniform(options.seed, Drop, index) < options.drop && degree[from] > 2 && degree[to] > 2) {
+                degree[from]--;
+                degree[to]--;
+                return;
+            }
+        }
+        emit(from, to, length(from, to, index), speed);
+    }
+
+    [[nodiscard]] double length(const long long from, const long long to, const uint64_t index) const {
+        const auto [x1, y1] = position(from);
+        const auto [x2, y2] = position(to);
+        return std::hypot(x2 - x1, y2 - y1) * (1.0 + 0.15 * uniform(options.seed, Detour, index));
+    }
+
+    const GenOptions& options;
+    long long width;
+    long long height;
+    std::vector<uint8_t> degree; // grid roads left at each node, a dropped road needs 3 at both ends
+};
+
+// Collects formatted lines and hands them to the stream in large blocks
+class LineWriter {
+public:
+    explicit LineWriter(std::ofstream& out) : out(out) { buffer.reserve(blockSize + 256); }
+    ~LineWriter() { flush(); }
+
+    template <typename... Args>
+    void line(const char* format, Args... args) {
+        char text[160];
+        const int length = std::snprintf(text, sizeof text, format, args...);
+        buffer.append(text, static_cast<size_t>(std::min<int>(length, sizeof text - 1)));
+        if (buffer.size() >= blockSize) flush();
+    }
+    void flush() {
+        out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        buffer.clear();
+    }
+
+private:
+    static constexpr size_t blockSize = 1 << 20;
+    std::ofstream& out;
+    std::string buffer;
+};
+
+void printUsage() {
+    std::cerr << "Usage: maproute-gen <map> <queries> [--nodes N | --grid W H] [--queries Q] [--radius M]\n"
+                 "                    [--seed S] [--spacing KM] [--jitter F] [--drop F] [--diagonals F] [--snapshot <file>]\n"
+                 "  --nodes N      about N nodes as a square grid (default: 1000 x 1000)\n"
+                 "  --grid W H     grid of W columns and H rows\n"
+                 "  --queries Q    queries between random points of the map (default: 1000)\n"
+                 "  --radius M     walking radius of every query in metres (default: 300)\n"
+                 "  --seed S       random seed (default: 1)\n"
+                 "  --spacing KM   distance between grid lines (default: 0.1)\n"
+                 "  --jitter F     node offset as a share of the spacing (default: 0.3)\n"
+                 "  --drop F       share of local streets removed (default: 0.1)\n"
+                 "  --diagonals F  share of grid cells with a diagonal road (default: 0.05)\n"
+                 "  --snapshot F   also write the map as a binary snapshot"
+              << std::endl;
+}
+
+// Whole-string numbers, false on an empty value or trailing characters
+bool parseValue(const char* text, double& value) {
+    char* end = nullptr;
+    value = std::strtod(text, &end);
+    return end != text && *end == '\0';
+}
+
+bool parseValue(const char* text, long long& value) {
+    char* end = nullptr;
+    errno = 0;
+    value = std::strtoll(text, &end, 10);
+    return end != text && *end == '\0' && errno == 0;
+}
+
+bool parseValue(const char* text, uint64_t& value) {
+    char* end = nullptr;
+    errno = 0;
+    value = std::strtoull(text, &end, 10);
+    return end != text && *end == '\0' && errno == 0;
+}
+
+bool parseArguments(const int argc, char* argv[], GenOptions& options) {
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--nodes" && hasValue) {
+            double nodes = 0;
+            if (!parseValue(argv[++i], nodes) || nodes < 4) return false;
+            options.width = options.height = static_cast<long long>(std::ceil(std::sqrt(nodes)));
+        } else if (arg == "--grid" && i + 2 < argc) {
+            if (!parseValue(argv[++i], options.width) || !parseValue(argv[++i], options.height)) return false;
+        } else if (arg == "--queries" && hasValue) {
+            if (!parseValue(argv[++i], options.queries)) return false;
+        } else if (arg == "--radius" && hasValue) {
+            if (!parseValue(argv[++i], options.radius)) return false;
+        } else if (arg == "--seed" && hasValue) {
+            if (!parseValue(argv[++i], options.seed)) return false;
+        } else if (arg == "--spacing" && hasValue) {
+            if (!parseValue(argv[++i], options.spacing)) return false;
+        } else if (arg == "--jitter" && hasValue) {
+            if (!parseValue(argv[++i], options.jitter)) return false;
+        } else if (arg == "--drop" && hasValue) {
+            if (!parseValue(argv[++i], options.drop)) return false;
+        } else if (arg == "--diagonals" && hasValue) {
+            if (!parseValue(argv[++i], options.diagonals)) return false;
+        } else if (arg == "--snapshot" && hasValue) {
+            options.snapshotFile = argv[++i];
+        } else if (arg.rfind("--", 0) == 0) {
+            return false;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.size() != 2) return false;
+    options.mapFile = positional[0];
+    options.queriesFile = positional[1];
+    // Node ids are ints in the engine
+    return options.width >= 2 && options.height >= 2 && options.width * options.height <= std::numeric_limits<int>::max() &&
+           options.queries > 0 && options.radius >= 0 && options.spacing > 0 && options.jitter >= 0 && options.jitter < 1;
+}
+
+double elapsedMs(const std::chrono::high_resolution_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    GenOptions options;
+    if (!parseArguments(argc, argv, options)) {
+        printUsage();
+        return 2;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    RoadGrid grid(options);
+    long long edgeCount = 0;
+    grid.forEachRoad([&](long long, long long, double, int) { edgeCount++; });
+    // Every road is two arcs with 32-bit offsets in the CSR graph
+    if (2 * edgeCount > std::numeric_limits<uint32_t>::max()) {
+        std::cerr << "Too many roads for the engine: " << edgeCount << std::endl;
+        return 1;
+    }
+
+    std::ofstream map(options.mapFile, std::ios::binary);
+    if (!map.is_open()) {
+        std::cerr << "Error opening map file: " << options.mapFile << std::endl;
+        return 1;
+    }
+    {
+        LineWriter writer(map);
+        writer.line("%lld\n", grid.nodeCount());
+        for (long long node = 0; node < grid.nodeCount(); node++) {
+            const auto [x, y] = grid.position(node);
+            writer.line("%lld %.4f %.4f\n", node, x, y);
+        }
+        writer.line("%lld\n", edgeCount);
+        grid.forEachRoad([&](const long long from, const long long to, const double km, const int speed) {
+            writer.line("%lld %lld %.4f %d\n", from, to, km, speed);
+        });
+    }
+    map.close();
+    if (map.fail()) {
+        std::cerr << "Error writing map file: " << options.mapFile << std::endl;
+        return 1;
+    }
+    const double mapMs = elapsedMs(start);
+
+    start = std::chrono::high_resolution_clock::now();
+    std::ofstream queries(options.queriesFile, std::ios::binary);
+    if (!queries.is_open()) {
+        std::cerr << "Error opening queries file: " << options.queriesFile << std::endl;
+        return 1;
+    }
+    {
+        LineWriter writer(queries);
+        writer.line("%lld\n", options.queries);
+        const double maxX = (options.width - 1) * options.spacing, maxY = (options.height - 1) * options.spacing;
+        for (long long i = 0; i < options.queries; i++) {
+            const uint64_t index = static_cast<uint64_t>(i) * 4;
+            writer.line("%.4f %.4f %.4f %.4f %g\n", maxX * uniform(options.seed, QueryPoint, index),
+                        maxY * uniform(options.seed, QueryPoint, index + 1), maxX * uniform(options.seed, QueryPoint, index + 2),
+                        maxY * uniform(options.seed, QueryPoint, index + 3), options.radius);
+        }
+    }
+    queries.close();
+    if (queries.fail()) {
+        std::cerr << "Error writing queries file: " << options.queriesFile << std::endl;
+        return 1;
+    }
+    const double queriesMs = elapsedMs(start);
+
+    double snapshotMs = 0;
+    if (!options.snapshotFile.empty()) {
+        start = std::chrono::high_resolution_clock::now();
+        MapGraph& graph = MapGraph::instance();
+        if (!graph.loadMapFromFile(options.mapFile) || !graph.saveSnapshot(options.snapshotFile)) return 1;
+        snapshotMs = elapsedMs(start);
+    }
+
+    std::cout << std::fixed << std::setprecision(3)
+              << "{\"nodes\": " << grid.nodeCount()
+              << ", \"edges\": " << edgeCount
+              << ", \"queries\": " << options.queries
+              << ", \"map_ms\": " << mapMs
+              << ", \"queries_ms\": " << queriesMs
+              << ", \"snapshot_ms\": " << snapshotMs << "}" << std::endl;
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include "mapsnapshot.h"
+#include <cstring>
+#include <fstream>
+
+namespace MapSnapshot {
+
+namespace {
+
+constexpr char magic[8] = {'M', 'R', 'G', 'R', 'A', 'P', 'H', '\0'};
+constexpr uint32_t byteOrderMark = 0x01020304;
+constexpr uint64_t payloadAlignment = 64;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t sectionCount;
+    uint32_t reserved;
+};
+
+struct TableEntry {
+    uint32_t id;
+    uint32_t elementSize;
+    uint64_t offset;
+    uint64_t count;
+};
+
+uint64_t alignUp(const uint64_t value) {
+    return (value + payloadAlignment - 1) / payloadAlignment * payloadAlignment;
+}
+
+}
+
+bool isSnapshot(const char* data, const size_t size) {
+    return size >= sizeof(Header) && std::memcmp(data, magic, sizeof(magic)) == 0;
+}
+
+bool Writer::write(const std::string& filename, std::string& error) const {
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        error = "cannot open " + filename + " for writing";
+        return false;
+    }
+
+    Header header{};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.byteOrder = byteOrderMark;
+    header.sectionCount = static_cast<uint32_t>(sections.size());
+
+    // Lay the payloads out after the table, each on its own cache line
+    std::vector<TableEntry> table;
+    uint64_t offset = alignUp(sizeof(Header) + sections.size() * sizeof(TableEntry));
+    for (const Pending& section : sections) {
+        table.push_back({static_cast<uint32_t>(section.id), section.elementSize, offset, section.count});
+        offset = alignUp(offset + section.elementSize * section.count);
+    }
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(table.data()), static_cast<std::streamsize>(table.size() * sizeof(TableEntry)));
+
+    static constexpr char padding[payloadAlignment] = {};
+    uint64_t written = sizeof(Header) + table.size() * sizeof(TableEntry);
+    for (size_t i = 0; i < sections.size(); i++) {
+        out.write(padding, static_cast<std::streamsize>(table[i].offset - written));
+        const uint64_t bytes = sections[i].elementSize * sections[i].count;
+        out.write(static_cast<const char*>(sections[i].data), static_cast<std::streamsize>(bytes));
+        written = table[i].offset + bytes;
+    }
+    out.write(padding, static_cast<std::streamsize>(alignUp(written) - written));
+
+    out.close();
+    if (out.fail()) {
+        error = "error writing " + filename;
+        return false;
+    }
+    return true;
+}
+
+bool Reader::open(std::shared_ptr<const MappedFile> file, std::string& error) {
+    mapping.reset();
+    if (!file || !isSnapshot(file->data(), file->size())) {
+        error = "not a map snapshot";
+        return false;
+    }
+
+    Header header{};
+    std::memcpy(&header, file->data(), sizeof(header));
+    if (header.byteOrder != byteOrderMark) {
+        error = "snapshot was written on a machine with a different byte order";
+        return false;
+    }
+    if (header.version != version) {
+        error = "unsupported snapshot version " + std::to_string(header.version) + " (expected " +
+                std::to_string(version) + ")";
+        return false;
+    }
+
+    const uint64_t tableEnd = sizeof(Header) + static_cast<uint64_t>(header.sectionCount) * sizeof(TableEntry);
+    if (tableEnd > file->size()) {
+        error = "truncated snapshot section table";
+        return false;
+    }
+    const auto* table = reinterpret_cast<const TableEntry*>(file->data() + sizeof(Header));
+    for (uint32_t i = 0; i < header.sectionCount; i++) {
+        const TableEntry& entry = table[i];
+        if (entry.elementSize == 0 || entry.offset > file->size() ||
+            entry.count > (file->size() - entry.offset) / entry.elementSize) {
+            error = "snapshot section " + std::to_string(entry.id) + " lies outside the file";
+            return false;
+        }
+    }
+
+    mapping = std::move(file);
+    return true;
+}
+
+bool Reader::find(const Section id, const size_t elementSize, const size_t alignment, const void*& data,
+                  size_t& count) const {
+    if (!mapping) return false;
+    Header header{};
+    std::memcpy(&header, mapping->data(), sizeof(header));
+    const auto* table = reinterpret_cast<const TableEntry*>(mapping->data() + sizeof(Header));
+    for (uint32_t i = 0; i < header.sectionCount; i++) {
+        if (table[i].id != static_cast<uint32_t>(id)) continue;
+        if (table[i].elementSize != elementSize || table[i].offset % alignment != 0) return false;
+        data = mapping->data() + table[i].offset;
+        count = static_cast<size_t>(table[i].count);
+        return true;
+    }
+    return false;
+}
+
+}
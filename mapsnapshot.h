@@ -0,0 +1,115 @@
+#ifndef MAPSNAPSHOT_H
+#define MAPSNAPSHOT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "flatarray.h"
+#include "mappedfile.h"
+
+// Versioned binary snapshot of a loaded map. The file is a header, a table
+// of typed sections and the section payloads, each aligned to a cache line,
+// so a reader can use every array in place straight from the mapping.
+//
+//   header  | magic "MRGRAPH", version, byte order mark, section count
+//   table   | (id, element size, offset, element count) per section
+//   payload | raw arrays
+namespace MapSnapshot {
+
+constexpr uint32_t version = 2;
+
+enum class Section : uint32_t {
+    Meta = 1,              // SnapshotMeta
+    Coordinates = 2,       // (x, y) per node
+    EdgeList = 3,          // (u, v) per undirected edge, file order
+    AdjacencyOffsets = 4,  // CSR row offsets, nodeCount + 1 entries
+    AdjacencyTargets = 5,  // CSR neighbour per directed arc
+    AdjacencyDistance = 6, // km per directed arc
+    AdjacencySpeed = 7,    // km/h per directed arc
+    GridLayout = 8,        // SpatialGrid::Layout
+    GridCells = 9,         // SpatialGrid cell offsets
+    GridPoints = 10,       // SpatialGrid points in cell order
+    AdjacencyTime = 11,    // minutes per directed arc (since version 2)
+    LandmarkMeta = 12,     // LandmarkMeta, optional like the two below
+    LandmarkNodes = 13,    // node id per landmark
+    LandmarkTable = 14,    // minutes, node major: nodeCount x landmark count
+    HierarchyMeta = 15,    // HierarchyMeta, optional like the two below
+    HierarchyOffsets = 16, // contraction hierarchy row offsets, nodeCount + 1 entries
+    HierarchyArcs = 17,    // ContractionHierarchy::Arc per upward arc
+    OverlayMeta = 18,      // OverlayMeta, optional like the two below
+    OverlayCells = 19,     // multilevel overlay level 1 cell per node
+    OverlayCliques = 20,   // minutes, the cliques of every overlay level end to end
+};
+
+struct Meta {
+    uint64_t nodeCount;
+    uint64_t edgeCount;
+    double maxSpeed;
+};
+
+struct LandmarkMeta {
+    uint32_t count;      // landmarks in the table, fewer than requested on small maps
+    uint32_t selection;  // LandmarkSelection
+    uint32_t weightType; // WeightType the table was built over
+    uint32_t requested;  // landmark count the table was built for, 0 in older snapshots
+};
+
+struct HierarchyMeta {
+    uint32_t weightType; // WeightType the hierarchy was built over
+    uint32_t reserved;
+};
+
+struct OverlayMeta {
+    uint32_t weightType; // WeightType the cliques were customized over
+    uint32_t reserved;
+};
+
+// True if the buffer starts with a snapshot header
+bool isSnapshot(const char* data, size_t size);
+
+class Writer {
+public:
+    template <typename T>
+    void add(Section id, const T* data, const size_t count) {
+        sections.push_back({id, static_cast<uint32_t>(sizeof(T)), data, count});
+    }
+    template <typename T>
+    void add(const Section id, const FlatArray<T>& values) { add(id, values.data(), values.size()); }
+
+    bool write(const std::string& filename, std::string& error) const;
+
+private:
+    struct Pending {
+        Section id;
+        uint32_t elementSize;
+        const void* data;
+        size_t count;
+    };
+    std::vector<Pending> sections;
+};
+
+class Reader {
+public:
+    bool open(std::shared_ptr<const MappedFile> file, std::string& error);
+
+    // Views a section in place; false if it is missing or has the wrong element type
+    template <typename T>
+    bool get(const Section id, FlatArray<T>& out) const {
+        const void* data = nullptr;
+        size_t count = 0;
+        if (!find(id, sizeof(T), alignof(T), data, count)) return false;
+        out.view(static_cast<const T*>(data), count);
+        return true;
+    }
+
+private:
+    bool find(Section id, size_t elementSize, size_t alignment, const void*& data, size_t& count) const;
+
+    std::shared_ptr<const MappedFile> mapping;
+};
+
+}
+
+#endif // MAPSNAPSHOT_H
@@ -57,13 +57,15 @@ void MapVisualizer::paintEvent(QPaintEvent *event) {
     painter.save();  // Save the original painter state
     painter.scale(scaleFactor, scaleFactor);  // Zoom based on user input
 
-    const std::vector<std::pair<double, double>> nodes = MapGraph::instance().getNodes();
+    // Pinned for the whole paint, a reload may swap the map meanwhile
+    const std::shared_ptr<const MapData> map = MapGraph::instance().snapshot();
+    const auto& nodes = map->getNodes();
     
     // Draw edges with theme-appropriate thickness
     const double edgeThickness = 1/scaleFactor;
     painter.setPen(QPen(edgeColor, edgeThickness));
     
-    for (const auto&[edgeStart, edgeEnd] : MapGraph::instance().getEdges()) {
+    for (const auto&[edgeStart, edgeEnd] : map->getEdges()) {
         const auto&[sourceX, sourceY] = nodes[edgeStart];
         const auto&[destX, destY] = nodes[edgeEnd];
         
@@ -253,7 +255,8 @@ QPointF MapVisualizer::inverseTransformCoordinates(const int pixelX, const int p
 }
 
 void MapVisualizer::calculateGraphBounds() {
-    if (MapGraph::instance().getNodes().empty()) {
+    const std::shared_ptr<const MapData> map = MapGraph::instance().snapshot();
+    if (map->getNodes().empty()) {
         graphBounds = QRectF(0, 0, 1, 1);
         return;
     }
@@ -263,7 +266,7 @@ void MapVisualizer::calculateGraphBounds() {
     double maxX = std::numeric_limits<double>::lowest();
     double maxY = std::numeric_limits<double>::lowest();
     
-    for (const auto&[x, y] : MapGraph::instance().getNodes()) {
+    for (const auto&[x, y] : map->getNodes()) {
         minX = qMin(minX, x);
         minY = qMin(minY, y);
         maxX = qMax(maxX, x);
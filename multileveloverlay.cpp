@@ -0,0 +1,549 @@
+#include "multileveloverlay.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <queue>
+
+#include "bitops.h"
+#include "mapgraph.h"
+#include "threadpool.h"
+
+namespace {
+
+using TimeQueue = std::priority_queue<std::pair<double, int>, std::vector<std::pair<double, int>>, std::greater<>>;
+
+constexpr double unreached = std::numeric_limits<double>::infinity();
+// Nodes per level 1 cell the bisection aims for
+constexpr size_t leafCellSize = 128;
+// Average boundary nodes per cell above which a level is not built
+constexpr size_t maxCellBoundary = 256;
+
+// Cheapest of the parallel arcs from -> to
+uint32_t roadArc(const CsrGraph& graph, const double* arcMinutes, const int from, const int to) {
+    uint32_t best = graph.lastArc(from);
+    for (uint32_t arc = graph.firstArc(from); arc < graph.lastArc(from); arc++) {
+        if (graph.targets[arc] == to && (best == graph.lastArc(from) || arcMinutes[arc] < arcMinutes[best])) best = arc;
+    }
+    return best;
+}
+
+}
+
+void MultilevelOverlay::partition(const CsrGraph& graph, const FlatArray<std::pair<double, double>>& positions,
+                                  ThreadPool& pool) {
+    clear();
+    const size_t nodeCount = graph.nodeCount();
+    if (nodeCount == 0) return;
+
+    const unsigned depth = depthFor(nodeCount);
+
+    // order[bounds[i] .. bounds[i + 1]) are the nodes of cell i at the current depth,
+    // the children of cell i are 2i and 2i + 1
+    std::vector<int> order(nodeCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::vector<size_t> bounds{0, nodeCount};
+    std::vector<uint32_t> cell(nodeCount, 0);
+    std::vector<char> upper(nodeCount, 0);
+
+    for (unsigned round = 0; round < depth; round++) {
+        const size_t cellCount = bounds.size() - 1;
+        std::vector<size_t> middle(cellCount);
+        pool.parallelFor(cellCount, 1, [&](const size_t begin, const size_t end, unsigned) {
+            for (size_t i = begin; i < end; i++) {
+                const size_t first = bounds[i], last = bounds[i + 1], mid = first + (last - first) / 2;
+                middle[i] = mid;
+                if (last - first < 2) continue;
+
+                // Median split along one axis, returns the number of roads it cuts inside the cell
+                const auto split = [&](const bool alongY) {
+                    std::nth_element(order.begin() + first, order.begin() + mid, order.begin() + last,
+                                     [&](const int a, const int b) {
+                                         const double ka = alongY ? positions[a].second : positions[a].first;
+                                         const double kb = alongY ? positions[b].second : positions[b].first;
+                                         return ka < kb || (ka == kb && a < b);
+                                     });
+                    for (size_t k = first; k < last; k++) upper[order[k]] = k >= mid;
+                    size_t cut = 0;
+                    for (size_t k = first; k < mid; k++) {
+                        const int node = order[k];
+                        for (uint32_t arc = graph.firstArc(node); arc < graph.lastArc(node); arc++) {
+                            const int target = graph.targets[arc];
+                            if (cell[target] == i && upper[target]) cut++;
+                        }
+                    }
+                    return cut;
+                };
+                if (split(false) < split(true)) split(false);
+            }
+        });
+
+        std::vector<size_t> nextBounds(2 * cellCount + 1);
+        for (size_t i = 0; i < cellCount; i++) {
+            nextBounds[2 * i] = bounds[i];
+            nextBounds[2 * i + 1] = middle[i];
+        }
+        nextBounds.back() = nodeCount;
+        bounds = std::move(nextBounds);
+        // Separate pass, the splits above read the cells of neighbours in other cells
+        pool.parallelFor(bounds.size() - 1, 64, [&](const size_t begin, const size_t end, unsigned) {
+            for (size_t i = begin; i < end; i++) {
+                for (size_t k = bounds[i]; k < bounds[i + 1]; k++) cell[order[k]] = static_cast<uint32_t>(i);
+            }
+        });
+    }
+    buildLevels(graph, std::move(cell), depth);
+}
+
+bool MultilevelOverlay::attach(const CsrGraph& graph, FlatArray<uint32_t> cells) {
+    clear();
+    const unsigned depth = depthFor(graph.nodeCount());
+    if (cells.size() != graph.nodeCount() ||
+        !std::all_of(cells.begin(), cells.end(), [depth](const uint32_t cell) { return cell < (uint32_t{1} << depth); })) {
+        return false;
+    }
+    if (!cells.empty()) buildLevels(graph, std::move(cells), depth);
+    return true;
+}
+
+bool MultilevelOverlay::attachCliques(const FlatArray<double>& cliques) {
+    size_t offset = 0;
+    for (const Level& level : levels) offset += level.clique.size();
+    if (offset != cliques.size()) return false;
+    offset = 0;
+    for (Level& level : levels) {
+        const size_t size = level.clique.size();
+        level.clique.view(cliques.data() + offset, size);
+        offset += size;
+    }
+    return true;
+}
+
+std::vector<double> MultilevelOverlay::cliques() const {
+    std::vector<double> all;
+    for (const Level& level : levels) all.insert(all.end(), level.clique.begin(), level.clique.end());
+    return all;
+}
+
+unsigned MultilevelOverlay::depthFor(const size_t nodeCount) {
+    unsigned depth = 1;
+    while ((nodeCount >> depth) > leafCellSize && depth < 31) depth++;
+    return depth;
+}
+
+void MultilevelOverlay::buildLevels(const CsrGraph& graph, FlatArray<uint32_t> cells, const unsigned depth) {
+    // Nodes grouped by leaf cell in id order, so a stored partition rebuilds the same lists
+    const size_t nodeCount = graph.nodeCount();
+    std::vector<size_t> bounds((size_t{1} << depth) + 1, 0);
+    for (const uint32_t cell : cells) bounds[cell + 1]++;
+    for (size_t c = 1; c < bounds.size(); c++) bounds[c] += bounds[c - 1];
+    std::vector<int> order(nodeCount);
+    std::vector<uint32_t> position(nodeCount);
+    std::vector<size_t> next(bounds.begin(), bounds.end() - 1);
+    for (int node = 0; node < static_cast<int>(nodeCount); node++) {
+        position[node] = static_cast<uint32_t>(next[cells[node]]++);
+        order[position[node]] = node;
+    }
+    leafCell = std::move(cells);
+    leafNodes.assign(std::move(order));
+    leafStart.assign(std::move(bounds));
+    leafPosition.assign(std::move(position));
+
+    // Level l (from 0) groups the leaves 16^l at a time. A level of fewer than 16 cells would
+    // cost more to customize than it saves a query, so the top level keeps at least that many.
+    size_t levelCount = depth >= 2 * bitsPerLevel ? depth / bitsPerLevel : 1;
+
+    // Highest level whose cell every node leaves through one of its roads, -1 if none
+    std::vector<int> topLevel(nodeCount, -1);
+    std::vector<size_t> boundaryCount(levelCount, 0);
+    for (int node = 0; node < static_cast<int>(nodeCount); node++) {
+        for (uint32_t arc = graph.firstArc(node); arc < graph.lastArc(node); arc++) {
+            const uint32_t differ = leafCell[node] ^ leafCell[graph.targets[arc]];
+            if (differ == 0) continue;
+            const int highest = highestBit(differ);
+            topLevel[node] = std::max(topLevel[node], std::min(highest / static_cast<int>(bitsPerLevel),
+                                                               static_cast<int>(levelCount) - 1));
+        }
+        for (int l = 0; l <= topLevel[node]; l++) boundaryCount[l]++;
+    }
+    // Customizing a cell costs about its boundary size cubed, levels whose cells average
+    // more boundary nodes than maxCellBoundary are left out (grids cut badly, roads do not)
+    size_t kept = 1;
+    while (kept < levelCount && boundaryCount[kept] <= maxCellBoundary * (size_t{1} << (depth - bitsPerLevel * kept))) kept++;
+    droppedLevels = static_cast<unsigned>(levelCount - kept);
+    levelCount = kept;
+    levels.resize(levelCount);
+    for (int& top : topLevel) top = std::min(top, static_cast<int>(levelCount) - 1);
+
+    for (size_t l = 0; l < levelCount; l++) {
+        Level& level = levels[l];
+        level.cellCount = size_t{1} << (depth - bitsPerLevel * l);
+        std::vector<uint32_t> boundaryStart(level.cellCount + 1, 0);
+        for (int node = 0; node < static_cast<int>(nodeCount); node++) {
+            if (topLevel[node] >= static_cast<int>(l)) boundaryStart[cellOf(node, l) + 1]++;
+        }
+        for (size_t c = 0; c < level.cellCount; c++) boundaryStart[c + 1] += boundaryStart[c];
+
+        std::vector<int> boundaryNodes(boundaryStart.back());
+        std::vector<int> boundaryIndex(nodeCount, -1);
+        std::vector<uint32_t> next(boundaryStart.begin(), boundaryStart.end() - 1);
+        for (int node = 0; node < static_cast<int>(nodeCount); node++) {
+            if (topLevel[node] < static_cast<int>(l)) continue;
+            const uint32_t c = cellOf(node, l);
+            boundaryIndex[node] = static_cast<int>(next[c] - boundaryStart[c]);
+            boundaryNodes[next[c]++] = node;
+        }
+
+        std::vector<size_t> cliqueStart(level.cellCount + 1, 0);
+        for (size_t c = 0; c < level.cellCount; c++) {
+            const size_t size = boundaryStart[c + 1] - boundaryStart[c];
+            cliqueStart[c + 1] = cliqueStart[c] + size * size;
+        }
+        level.clique.assign(std::vector<double>(cliqueStart.back(), unreached));
+        level.boundaryStart.assign(std::move(boundaryStart));
+        level.boundaryNodes.assign(std::move(boundaryNodes));
+        level.boundaryIndex.assign(std::move(boundaryIndex));
+        level.cliqueStart.assign(std::move(cliqueStart));
+    }
+}
+
+void MultilevelOverlay::customize(const CsrGraph& graph, const double* arcMinutes, ThreadPool& pool) {
+    if (empty()) return;
+
+    // Each level reads the cliques of the one below, so the levels run one after another
+    std::vector<uint32_t> cells;
+    for (size_t l = 0; l < levels.size(); l++) {
+        cells.resize(levels[l].cellCount);
+        std::iota(cells.begin(), cells.end(), 0);
+        customizeLevel(graph, arcMinutes, l, cells, pool);
+    }
+}
+
+void MultilevelOverlay::customize(const CsrGraph& graph, const double* arcMinutes, const std::vector<int>& nodes,
+                                  ThreadPool& pool) {
+    if (empty()) return;
+
+    // A cell whose clique can change holds a changed arc or one of its subcells does,
+    // and both hold the arc's end nodes
+    std::vector<uint32_t> cells;
+    for (size_t l = 0; l < levels.size(); l++) {
+        cells.clear();
+        for (const int node : nodes) cells.push_back(cellOf(node, l));
+        std::sort(cells.begin(), cells.end());
+        cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+        customizeLevel(graph, arcMinutes, l, cells, pool);
+    }
+}
+
+void MultilevelOverlay::customizeLevel(const CsrGraph& graph, const double* arcMinutes, const size_t level,
+                                       const std::vector<uint32_t>& cells, ThreadPool& pool) {
+    // Copies of the overlay share the old cliques, so the level gets a new array
+    std::vector<double> clique(levels[level].clique.begin(), levels[level].clique.end());
+    std::vector<CellGraph> scratch(pool.size());
+    pool.parallelFor(cells.size(), 1, [&](const size_t begin, const size_t end, const unsigned worker) {
+        for (size_t i = begin; i < end; i++) customizeCell(graph, arcMinutes, level, cells[i], clique.data(), scratch[worker]);
+    });
+    levels[level].clique.assign(std::move(clique));
+}
+
+void MultilevelOverlay::clear() {
+    leafCell.clear();
+    leafNodes.clear();
+    leafStart.clear();
+    leafPosition.clear();
+    levels.clear();
+    droppedLevels = 0;
+}
+
+MultilevelOverlay::Stats MultilevelOverlay::stats() const {
+    Stats stats;
+    stats.levels = static_cast<unsigned>(levels.size());
+    stats.droppedLevels = droppedLevels;
+    for (const Level& level : levels) {
+        stats.cells += level.cellCount;
+        stats.boundaryNodes += level.boundaryNodes.size();
+        stats.cliqueEntries += level.clique.size();
+    }
+    return stats;
+}
+
+size_t MultilevelOverlay::searchLevel(const int node, const std::vector<std::vector<uint32_t>>& seedCells) const {
+    // A cell holding a seed contains the cells below it, so the seedless levels are a prefix
+    size_t level = 0;
+    while (level < levels.size() && !std::binary_search(seedCells[level].begin(), seedCells[level].end(), cellOf(node, level))) {
+        level++;
+    }
+    return level;
+}
+
+int MultilevelOverlay::localIndex(const size_t level, const uint32_t cell, const int node) const {
+    if (level == 0) return static_cast<int>(leafPosition[node] - leafStart[cell]);
+    const Level& below = levels[level - 1];
+    return static_cast<int>(below.boundaryStart[cellOf(node, level - 1)] + below.boundaryIndex[node] -
+                            below.boundaryStart[cell << bitsPerLevel]);
+}
+
+void MultilevelOverlay::loadCell(const CsrGraph& graph, const double* arcMinutes, const size_t level, const uint32_t cell,
+                                 CellGraph& cellGraph) const {
+    cellGraph.level = level;
+    cellGraph.cell = cell;
+    if (level == 0) {
+        cellGraph.nodes.assign(leafNodes.begin() + leafStart[cell], leafNodes.begin() + leafStart[cell + 1]);
+    } else {
+        // The subcells of a cell are numbered consecutively, so are their boundary nodes
+        const Level& below = levels[level - 1];
+        const size_t firstSub = std::min<size_t>(size_t{cell} << bitsPerLevel, below.cellCount);
+        const size_t lastSub = std::min<size_t>(size_t{cell + 1} << bitsPerLevel, below.cellCount);
+        cellGraph.nodes.assign(below.boundaryNodes.begin() + below.boundaryStart[firstSub],
+                               below.boundaryNodes.begin() + below.boundaryStart[lastSub]);
+    }
+
+    // Level 1 cells keep their inner roads, higher ones the roads between their subcells
+    cellGraph.roadStart.assign(1, 0);
+    cellGraph.roads.clear();
+    for (const int node : cellGraph.nodes) {
+        for (uint32_t arc = graph.firstArc(node); arc < graph.lastArc(node); arc++) {
+            const int target = graph.targets[arc];
+            if (cellOf(target, level) != cell || (level > 0 && cellOf(target, level - 1) == cellOf(node, level - 1))) {
+                continue;
+            }
+            cellGraph.roads.emplace_back(localIndex(level, cell, target), arcMinutes[arc]);
+        }
+        cellGraph.roadStart.push_back(static_cast<uint32_t>(cellGraph.roads.size()));
+    }
+}
+
+template <typename OnSettle>
+void MultilevelOverlay::searchCell(CellGraph& cellGraph, const int source, const OnSettle& onSettle) const {
+    const size_t size = cellGraph.nodes.size();
+    cellGraph.time.assign(size, unreached);
+    cellGraph.prev.assign(size, -1);
+    cellGraph.time[source] = 0;
+    // Decrease-key heap: a clique lowers many times at once, each node stays queued once
+    QuadHeap& queue = cellGraph.queue;
+    queue.prepare(size);
+    queue.push(0.0, source);
+
+    const auto relax = [&](const int local, const int target, const double newTime) {
+        if (newTime < cellGraph.time[target]) {
+            cellGraph.time[target] = newTime;
+            cellGraph.prev[target] = local;
+            queue.push(newTime, target);
+        }
+    };
+    const size_t level = cellGraph.level;
+    while (!queue.empty()) {
+        const auto [time, local] = queue.top();
+        queue.pop();
+        if (onSettle(local)) return;
+
+        for (uint32_t road = cellGraph.roadStart[local]; road < cellGraph.roadStart[local + 1]; road++) {
+            relax(local, cellGraph.roads[road].first, time + cellGraph.roads[road].second);
+        }
+        if (level == 0) continue;
+
+        // Higher cells also take the cliques of their subcells. A node reached through its
+        // subcell's clique only leaves it, the clique already holds the rest.
+        const int node = cellGraph.nodes[local];
+        const Level& below = levels[level - 1];
+        const uint32_t sub = cellOf(node, level - 1);
+        if (const int prev = cellGraph.prev[local]; prev != -1 && cellOf(cellGraph.nodes[prev], level - 1) == sub) continue;
+        const uint32_t first = below.boundaryStart[sub];
+        const size_t subSize = below.boundaryStart[sub + 1] - first;
+        const double* row = below.clique.data() + below.cliqueStart[sub] + below.boundaryIndex[node] * subSize;
+        const int base = static_cast<int>(first - below.boundaryStart[cellGraph.cell << bitsPerLevel]);
+        for (size_t j = 0; j < subSize; j++) {
+            if (row[j] != unreached) relax(local, base + static_cast<int>(j), time + row[j]);
+        }
+    }
+}
+
+void MultilevelOverlay::customizeCell(const CsrGraph& graph, const double* arcMinutes, const size_t level,
+                                      const uint32_t cell, double* levelClique, CellGraph& cellGraph) const {
+    const Level& current = levels[level];
+    const uint32_t first = current.boundaryStart[cell];
+    const size_t size = current.boundaryStart[cell + 1] - first;
+    if (size == 0) return;
+    double* clique = levelClique + current.cliqueStart[cell];
+
+    loadCell(graph, arcMinutes, level, cell, cellGraph);
+    std::vector<int> targets(size);
+    for (size_t j = 0; j < size; j++) targets[j] = localIndex(level, cell, current.boundaryNodes[first + j]);
+    for (size_t i = 0; i < size; i++) {
+        // Stops once every boundary node of the cell is settled
+        size_t remaining = size;
+        searchCell(cellGraph, targets[i], [&](const int local) {
+            return current.boundaryIndex[cellGraph.nodes[local]] >= 0 && --remaining == 0;
+        });
+        for (size_t j = 0; j < size; j++) clique[i * size + j] = cellGraph.time[targets[j]];
+    }
+}
+
+void MultilevelOverlay::unpack(const CsrGraph& graph, const double* arcMinutes, const int from, const int to,
+                               const size_t level, CellGraph& cellGraph, std::vector<int>& path) const {
+    const uint32_t cell = cellOf(from, level);
+    loadCell(graph, arcMinutes, level, cell, cellGraph);
+    const int target = localIndex(level, cell, to);
+    searchCell(cellGraph, localIndex(level, cell, from), [target](const int local) { return local == target; });
+    std::vector<int> chain;
+    for (int at = target; at != -1; at = cellGraph.prev[at]) chain.push_back(cellGraph.nodes[at]);
+    std::reverse(chain.begin(), chain.end());
+
+    // The cell graph is reused by the recursion, so the chain is copied out first
+    for (size_t i = 1; i < chain.size(); i++) {
+        if (level > 0 && cellOf(chain[i - 1], level - 1) == cellOf(chain[i], level - 1)) {
+            unpack(graph, arcMinutes, chain[i - 1], chain[i], level - 1, cellGraph, path);
+        } else {
+            path.push_back(chain[i]);
+        }
+    }
+}
+
+bool MultilevelOverlay::search(const std::vector<std::pair<int, double>>& startNodes,
+                               const std::vector<std::pair<int, double>>& endNodes, QueryWorkspace& workspace,
+                               const CsrGraph& graph, const double* arcMinutes, PathResult& result) const {
+    SearchLabels& forward = workspace.forward;
+    SearchLabels& backward = workspace.backward;
+
+    // Cells holding a seed of either side, per level. Both directions search the same
+    // overlay graph, which keeps the two halves of the bidirectional search symmetric.
+    std::vector<std::vector<uint32_t>> seedCells(levels.size());
+    for (size_t l = 0; l < levels.size(); l++) {
+        for (const auto& seeds : {&startNodes, &endNodes}) {
+            for (const auto& [node, distance] : *seeds) seedCells[l].push_back(cellOf(node, l));
+        }
+        std::sort(seedCells[l].begin(), seedCells[l].end());
+        seedCells[l].erase(std::unique(seedCells[l].begin(), seedCells[l].end()), seedCells[l].end());
+    }
+
+    TimeQueue pqForward;
+    TimeQueue pqBackward;
+    for (const auto& [node, distance] : startNodes) pqForward.emplace(forward.time(node), node);
+    for (const auto& [node, distance] : endNodes) pqBackward.emplace(backward.time(node), node);
+    QueryStats& stats = result.stats;
+    stats.queuePushes += startNodes.size() + endNodes.size();
+
+    double best = unreached;
+    int meetingNode = -1;
+    const auto topKey = [&stats](TimeQueue& pq, const SearchLabels& labels) {
+        while (!pq.empty() && labels.settled(pq.top().second)) {
+            pq.pop();
+            stats.queuePops++;
+        }
+        return pq.empty() ? unreached : pq.top().first;
+    };
+    const auto step = [&](TimeQueue& pq, SearchLabels& labels, const SearchLabels& other) {
+        const int node = pq.top().second;
+        pq.pop();
+        labels.settle(node);
+        stats.queuePops++;
+        stats.settledNodes++;
+
+        const double time = labels.time(node);
+        const auto relax = [&](const int target, const double newTime, const double newDist) {
+            stats.relaxedArcs++;
+            if (newTime < labels.time(target)) {
+                labels.set(target, newTime, newDist, node);
+                pq.emplace(newTime, target);
+                stats.queuePushes++;
+                if (const double total = newTime + other.time(target); total < best) {
+                    best = total;
+                    meetingNode = target;
+                }
+            }
+        };
+        if (const double total = time + other.time(node); total < best) {
+            best = total;
+            meetingNode = node;
+        }
+
+        const size_t level = searchLevel(node, seedCells);
+        if (level == 0) {
+            for (uint32_t arc = graph.firstArc(node); arc < graph.lastArc(node); arc++) {
+                relax(graph.targets[arc], time + arcMinutes[arc], labels.dist(node) + graph.distance[arc]);
+            }
+            return;
+        }
+        // Outside every seed's cell only boundary nodes are reached: the clique crosses the
+        // cell, the roads leaving it lead on. A node the clique reached only leaves the cell,
+        // since a second clique hop is never shorter. Distances are summed again after unpacking.
+        const Level& current = levels[level - 1];
+        const uint32_t cell = cellOf(node, level - 1);
+        if (const int prev = labels.prev(node); prev == -1 || cellOf(prev, level - 1) != cell) {
+            const uint32_t first = current.boundaryStart[cell];
+            const size_t size = current.boundaryStart[cell + 1] - first;
+            const double* row = current.clique.data() + current.cliqueStart[cell] + current.boundaryIndex[node] * size;
+            for (size_t j = 0; j < size; j++) {
+                if (row[j] != unreached) relax(current.boundaryNodes[first + j], time + row[j], labels.dist(node));
+            }
+        }
+        for (uint32_t arc = graph.firstArc(node); arc < graph.lastArc(node); arc++) {
+            const int target = graph.targets[arc];
+            if (cellOf(target, level - 1) != cell) relax(target, time + arcMinutes[arc], labels.dist(node));
+        }
+    };
+
+    while (true) {
+        const double forwardKey = topKey(pqForward, forward);
+        const double backwardKey = topKey(pqBackward, backward);
+        if (forwardKey == unreached || backwardKey == unreached || forwardKey + backwardKey >= best) break;
+        if (forwardKey <= backwardKey) {
+            step(pqForward, forward, backward);
+        } else {
+            step(pqBackward, backward, forward);
+        }
+    }
+    if (meetingNode == -1) return false;
+    const auto unpackStart = std::chrono::high_resolution_clock::now();
+
+    // Overlay hops (from, to, clique level + 1 or 0 for a road) in travel order. A hop
+    // was relaxed at the level of the node it left, in either direction.
+    struct Hop {
+        int from;
+        int to;
+        size_t level;
+    };
+    const auto hopLevel = [&](const int relaxed, const int reached) {
+        const size_t level = searchLevel(relaxed, seedCells);
+        return level > 0 && cellOf(relaxed, level - 1) == cellOf(reached, level - 1) ? level : 0;
+    };
+    std::vector<Hop> hops;
+    int firstSeed = meetingNode;
+    for (int at = meetingNode; forward.prev(at) != -1; at = forward.prev(at)) {
+        hops.push_back({forward.prev(at), at, hopLevel(forward.prev(at), at)});
+        firstSeed = forward.prev(at);
+    }
+    std::reverse(hops.begin(), hops.end());
+    int lastSeed = meetingNode;
+    for (int at = meetingNode; backward.prev(at) != -1; at = backward.prev(at)) {
+        hops.push_back({at, backward.prev(at), hopLevel(backward.prev(at), at)});
+        lastSeed = backward.prev(at);
+    }
+    const double startTime = forward.time(firstSeed), endTime = backward.time(lastSeed);
+    result.walkingDistance = forward.dist(firstSeed) + backward.dist(lastSeed);
+
+    CellGraph cellGraph;
+    result.path.assign(1, firstSeed);
+    for (const auto& [from, to, level] : hops) {
+        if (level == 0) {
+            result.path.push_back(to);
+        } else {
+            unpack(graph, arcMinutes, from, to, level - 1, cellGraph, result.path);
+        }
+    }
+
+    double time = startTime;
+    double roadDistance = 0;
+    for (size_t i = 1; i < result.path.size(); i++) {
+        const uint32_t arc = roadArc(graph, arcMinutes, result.path[i - 1], result.path[i]);
+        time += arcMinutes[arc];
+        roadDistance += graph.distance[arc];
+    }
+    result.travelTime = time + endTime;
+    result.totalDistance = result.walkingDistance + roadDistance;
+    result.vehicleDistance = std::round((result.totalDistance - result.walkingDistance) * 100) / 100;
+    stats.pathMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - unpackStart).count();
+    return true;
+}
@@ -0,0 +1,120 @@
+#ifndef MULTILEVELOVERLAY_H
+#define MULTILEVELOVERLAY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "csrgraph.h"
+#include "flatarray.h"
+#include "queryworkspace.h"
+#include "searchqueue.h"
+
+struct PathResult;
+class ThreadPool;
+
+// Multilevel partition overlay in the style of Customizable Route Planning. The
+// nodes are split into nested cells once (partition), then every cell gets a
+// clique of travel times between its boundary nodes (customize). Only the
+// cliques depend on the arc weights, so a speed change only customizes the cells
+// around the changed roads again while the partition stays. All arrays are
+// FlatArrays, so a copy shares the partition and the cliques it does not redo.
+//
+// Level 1 holds the smallest cells; each level groups 16 cells of the one below.
+// A boundary node of a cell has a road leaving the cell.
+class MultilevelOverlay {
+public:
+    struct Stats {
+        unsigned levels = 0;
+        unsigned droppedLevels = 0; // left out for cells with too many boundary nodes
+        size_t cells = 0;          // summed over the levels
+        size_t boundaryNodes = 0;  // summed over the levels
+        size_t cliqueEntries = 0;
+    };
+
+    // Recursive bisection of the node coordinates. Each cell is split along the axis
+    // whose median cuts fewer roads; cells of one depth are split in parallel.
+    void partition(const CsrGraph& graph, const FlatArray<std::pair<double, double>>& positions, ThreadPool& pool);
+    // The partition is the level 1 cell of every node, the rest follows from it and the roads.
+    // attach takes a stored one (false if it does not fit graph) and leaves the cliques unset.
+    [[nodiscard]] const FlatArray<uint32_t>& cells() const { return leafCell; }
+    bool attach(const CsrGraph& graph, FlatArray<uint32_t> cells);
+    // Every level's cliques end to end. attachCliques views stored ones, which must outlive
+    // the overlay; false if their size does not fit the partition.
+    [[nodiscard]] std::vector<double> cliques() const;
+    bool attachCliques(const FlatArray<double>& cliques);
+    // Recomputes every clique from arcMinutes (one weight per CSR arc), level by level
+    void customize(const CsrGraph& graph, const double* arcMinutes, ThreadPool& pool);
+    // Recomputes only the cliques of the cells holding one of nodes on every level, enough
+    // after the weights of arcs between these nodes changed
+    void customize(const CsrGraph& graph, const double* arcMinutes, const std::vector<int>& nodes, ThreadPool& pool);
+    void clear();
+    [[nodiscard]] bool empty() const { return levels.empty(); }
+    [[nodiscard]] Stats stats() const;
+
+    // Bidirectional Dijkstra over the overlay from the seeds already labelled in
+    // workspace. A node whose cell at some level holds no seed is searched through
+    // that level's clique. Fills path, travel time and distances of result, false
+    // if the two sides never meet. arcMinutes must be the customized weights.
+    bool search(const std::vector<std::pair<int, double>>& startNodes, const std::vector<std::pair<int, double>>& endNodes,
+                QueryWorkspace& workspace, const CsrGraph& graph, const double* arcMinutes, PathResult& result) const;
+
+private:
+    struct Level {
+        size_t cellCount = 0;
+        FlatArray<uint32_t> boundaryStart; // cellCount + 1 entries into boundaryNodes
+        FlatArray<int> boundaryNodes;      // grouped by cell
+        FlatArray<int> boundaryIndex;      // node -> position in its cell's list, -1 if inside
+        FlatArray<size_t> cliqueStart;     // cellCount + 1 entries into clique
+        FlatArray<double> clique;          // row major |B| x |B| per cell
+    };
+
+    [[nodiscard]] uint32_t cellOf(const int node, const size_t level) const {
+        return leafCell[node] >> (bitsPerLevel * level);
+    }
+    // Highest level whose cell around node holds none of the seeds, 0 for the road graph
+    [[nodiscard]] size_t searchLevel(int node, const std::vector<std::vector<uint32_t>>& seedCells) const;
+    // One cell of a level as a compact graph: its nodes (level 1) or the boundary nodes of
+    // its subcells, the roads the cell search may take between them, and Dijkstra state
+    struct CellGraph {
+        size_t level = 0;
+        uint32_t cell = 0;
+        std::vector<int> nodes;                    // local id -> node
+        std::vector<uint32_t> roadStart;           // nodes.size() + 1 entries into roads
+        std::vector<std::pair<int, double>> roads; // (local target, minutes)
+        std::vector<double> time;
+        std::vector<int> prev;
+        QuadHeap queue;
+    };
+
+    [[nodiscard]] int localIndex(size_t level, uint32_t cell, int node) const;
+    void loadCell(const CsrGraph& graph, const double* arcMinutes, size_t level, uint32_t cell, CellGraph& cellGraph) const;
+    // Dijkstra from a local source until onSettle(local) returns true; above level 1 the
+    // subcell cliques are taken as arcs too
+    template <typename OnSettle>
+    void searchCell(CellGraph& cellGraph, int source, const OnSettle& onSettle) const;
+    // Customizes cells of a level into a copy of its cliques, the other cells keep theirs
+    void customizeLevel(const CsrGraph& graph, const double* arcMinutes, size_t level, const std::vector<uint32_t>& cells,
+                        ThreadPool& pool);
+    void customizeCell(const CsrGraph& graph, const double* arcMinutes, size_t level, uint32_t cell, double* levelClique,
+                       CellGraph& cellGraph) const;
+    // Appends the road nodes after from up to to, staying inside from's cell at level
+    void unpack(const CsrGraph& graph, const double* arcMinutes, int from, int to, size_t level, CellGraph& cellGraph,
+                std::vector<int>& path) const;
+
+    // Leaf cells are 2^depth, enough for about leafCellSize nodes each
+    static unsigned depthFor(size_t nodeCount);
+    // Groups the nodes by leaf cell and finds the boundary nodes and clique layout of every level
+    void buildLevels(const CsrGraph& graph, FlatArray<uint32_t> cells, unsigned depth);
+
+    static constexpr unsigned bitsPerLevel = 4;
+
+    FlatArray<uint32_t> leafCell;     // node -> level 1 cell, the higher cells are its prefixes
+    FlatArray<int> leafNodes;         // nodes grouped by level 1 cell
+    FlatArray<size_t> leafStart;      // level 1 cell -> first entry in leafNodes
+    FlatArray<uint32_t> leafPosition; // node -> entry in leafNodes
+    std::vector<Level> levels;      // levels[0] is level 1
+    unsigned droppedLevels = 0;
+};
+
+#endif // MULTILEVELOVERLAY_H
@@ -0,0 +1,28 @@
+#include "queryworkspace.h"
+
+void SearchLabels::resize(const size_t nodeCount) {
+    labels.assign(nodeCount, Label{std::numeric_limits<double>::infinity(), 0.0, -1, 0, 0});
+    epoch = 1;
+}
+
+void SearchLabels::reset() {
+    if (++epoch == 0) {
+        // Stamp wrapped around, old labels could look current again
+        for (Label& label : labels) {
+            label.stamp = 0;
+            label.settledStamp = 0;
+        }
+        epoch = 1;
+    }
+}
+
+void QueryWorkspace::prepare(const size_t nodeCount) {
+    if (capacity != nodeCount) {
+        forward.resize(nodeCount);
+        backward.resize(nodeCount);
+        capacity = nodeCount;
+        return;
+    }
+    forward.reset();
+    backward.reset();
+}
@@ -0,0 +1,70 @@
+#ifndef QUERYWORKSPACE_H
+#define QUERYWORKSPACE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "searchqueue.h"
+
+// Dijkstra labels for one search direction. Entries are invalidated with an
+// epoch stamp, so reset() is O(1) instead of refilling N slots per query.
+class SearchLabels {
+public:
+    void resize(size_t nodeCount);
+    void reset();
+
+    [[nodiscard]] double time(const int node) const {
+        return labels[node].stamp == epoch ? labels[node].time : std::numeric_limits<double>::infinity();
+    }
+    [[nodiscard]] double dist(const int node) const { return labels[node].stamp == epoch ? labels[node].dist : 0.0; }
+    [[nodiscard]] int prev(const int node) const { return labels[node].stamp == epoch ? labels[node].prev : -1; }
+    [[nodiscard]] bool settled(const int node) const { return labels[node].settledStamp == epoch; }
+
+    void set(const int node, const double time, const double dist, const int prev) {
+        Label& label = labels[node];
+        label.time = time;
+        label.dist = dist;
+        label.prev = prev;
+        label.stamp = epoch;
+    }
+    void settle(const int node) { labels[node].settledStamp = epoch; }
+
+private:
+    // Kept together so a relaxation touches a single cache line
+    struct Label {
+        double time;
+        double dist;
+        int prev;
+        uint32_t stamp;
+        uint32_t settledStamp;
+    };
+
+    std::vector<Label> labels;
+    uint32_t epoch = 1;
+};
+
+// Forward and backward queue of one type
+template <typename Queue>
+struct QueuePair {
+    Queue forward;
+    Queue backward;
+};
+
+// Scratch state reused across queries on the same thread
+struct QueryWorkspace {
+    SearchLabels forward;
+    SearchLabels backward;
+    // The Dijkstra kernels take the pair of the selected QueueType, the others stay empty
+    QueuePair<BinaryHeap> binaryHeaps;
+    QueuePair<QuadHeap> quadHeaps;
+    QueuePair<RadixHeap> radixHeaps;
+
+    // Resizes on a map change, otherwise only bumps the epochs
+    void prepare(size_t nodeCount);
+
+private:
+    size_t capacity = 0;
+};
+
+#endif // QUERYWORKSPACE_H
@@ -0,0 +1,144 @@
+#ifndef RESULTCACHE_H
+#define RESULTCACHE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+// Counters of a ResultCache, summed over its shards
+struct ResultCacheStats {
+    size_t hits = 0;
+    size_t misses = 0; // stale entries included
+    size_t evictions = 0;
+    size_t entries = 0;
+    size_t capacity = 0;
+
+    [[nodiscard]] double hitRate() const { return hits + misses ? static_cast<double>(hits) / (hits + misses) : 0; }
+};
+
+// Least-recently-used cache shared by every query thread. Keys are spread over
+// independently locked shards, each evicting its own least recently used entry,
+// so concurrent lookups of different keys rarely wait on each other. Every
+// entry remembers the epoch of the map it was computed on and only answers
+// lookups made on that same map.
+template <typename Value>
+class ResultCache {
+public:
+    ResultCache(const size_t capacity, const unsigned shardCount)
+        : shardCount(std::max(1u, shardCount)), shards(std::make_unique<Shard[]>(this->shardCount)) {
+        // Spread the capacity evenly, every shard holds at least one entry
+        for (unsigned i = 0; i < this->shardCount; i++) {
+            shards[i].capacity = std::max<size_t>(1, capacity / this->shardCount + (i < capacity % this->shardCount));
+        }
+    }
+
+    // Copies the entry into value and marks it recently used, false on a miss
+    bool find(const std::string& key, const uint64_t epoch, Value& value) {
+        return find(key, epoch, [&value](const Value& entry) {
+            value = entry;
+            return true;
+        });
+    }
+
+    // Hands the entry to use(const Value&) under the shard lock. An entry use rejects
+    // counts as a miss and stays until insert replaces it.
+    template <typename Use>
+    bool find(const std::string& key, const uint64_t epoch, const Use& use) {
+        Shard& shard = shardOf(key);
+        std::lock_guard lock(shard.mutex);
+        const auto found = shard.index.find(key);
+        if (found == shard.index.end() || found->second->epoch != epoch) {
+            if (found != shard.index.end()) shard.erase(found);
+            shard.misses++;
+            return false;
+        }
+        if (!use(std::as_const(found->second->value))) {
+            shard.misses++;
+            return false;
+        }
+        shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+        shard.hits++;
+        return true;
+    }
+
+    // Adds or replaces the entry of key, evicting the shard's least recently used one when full
+    void insert(const std::string& key, const uint64_t epoch, const Value& value) {
+        Shard& shard = shardOf(key);
+        std::lock_guard lock(shard.mutex);
+        if (const auto found = shard.index.find(key); found != shard.index.end()) shard.erase(found);
+        if (shard.entries.size() >= shard.capacity) {
+            shard.index.erase(shard.entries.back().key);
+            shard.entries.pop_back();
+            shard.evictions++;
+        }
+        shard.entries.push_front({key, epoch, value});
+        // The view points into the list node, which never moves
+        shard.index.emplace(shard.entries.front().key, shard.entries.begin());
+    }
+
+    // Drops every entry, the counters stay
+    void clear() {
+        for (unsigned i = 0; i < shardCount; i++) {
+            std::lock_guard lock(shards[i].mutex);
+            shards[i].index.clear();
+            shards[i].entries.clear();
+        }
+    }
+
+    [[nodiscard]] ResultCacheStats stats() const {
+        ResultCacheStats total;
+        for (unsigned i = 0; i < shardCount; i++) {
+            std::lock_guard lock(shards[i].mutex);
+            total.hits += shards[i].hits;
+            total.misses += shards[i].misses;
+            total.evictions += shards[i].evictions;
+            total.entries += shards[i].entries.size();
+            total.capacity += shards[i].capacity;
+        }
+        return total;
+    }
+
+private:
+    struct Entry {
+        std::string key;
+        uint64_t epoch;
+        Value value;
+    };
+
+    // Own cache line each, so the locks of neighbouring shards do not share one
+    struct alignas(64) Shard {
+        mutable std::mutex mutex;
+        std::list<Entry> entries; // most recently used first
+        std::unordered_map<std::string_view, typename std::list<Entry>::iterator> index; // keys viewed in entries
+        size_t capacity = 1;
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t evictions = 0;
+
+        void erase(const typename decltype(index)::iterator found) {
+            const auto entry = found->second;
+            index.erase(found);
+            entries.erase(entry);
+        }
+    };
+
+    Shard& shardOf(const std::string& key) {
+        return shards[std::hash<std::string_view>()(key) % shardCount];
+    }
+
+    unsigned shardCount;
+    std::unique_ptr<Shard[]> shards;
+
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+};
+
+#endif // RESULTCACHE_H
@@ -0,0 +1,39 @@
+#include "searchqueue.h"
+
+void BinaryHeap::prepare(size_t) {
+    heap.clear();
+    pushCount = 0;
+    popCount = 0;
+}
+
+void QuadHeap::prepare(const size_t nodeCount) {
+    if (position.size() != nodeCount) {
+        position.assign(nodeCount, -1);
+    } else {
+        // Only the nodes still queued have a position set
+        for (const auto& [key, node] : heap) position[node] = -1;
+    }
+    heap.clear();
+    pushCount = 0;
+    popCount = 0;
+}
+
+void RadixHeap::prepare(size_t) {
+    for (auto& bucket : buckets) bucket.clear();
+    last = 0;
+    size = 0;
+    pushCount = 0;
+    popCount = 0;
+}
+
+void RadixHeap::refill() {
+    if (!buckets[0].empty()) return;
+    size_t from = 1;
+    while (buckets[from].empty()) from++;
+
+    auto& bucket = buckets[from];
+    last = std::min_element(bucket.begin(), bucket.end())->first;
+    // Every entry lands in a lower bucket, the ones equal to the new minimum in bucket 0
+    for (const auto& entry : bucket) buckets[bucketOf(entry.first)].push_back(entry);
+    bucket.clear();
+}
@@ -0,0 +1,167 @@
+#ifndef SEARCHQUEUE_H
+#define SEARCHQUEUE_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <utility>
+#include <vector>
+#include "bitops.h"
+
+// Priority queues of (minutes, node) for the Dijkstra kernels. They share one
+// interface so a kernel takes the queue as a template parameter:
+//   prepare(nodeCount)  empties the queue, keeping its storage
+//   push(key, node)     inserts, or lowers the key of a node already queued
+//   top(), pop(), empty()
+// pushes() and pops() count the operations since the last prepare().
+
+// Binary heap with lazy deletion, the std::priority_queue the kernels started
+// with: a lowered key is a second entry and the stale one is popped later.
+class BinaryHeap {
+public:
+    void prepare(size_t nodeCount);
+    [[nodiscard]] bool empty() const { return heap.empty(); }
+    [[nodiscard]] const std::pair<double, int>& top() const { return heap.front(); }
+    void push(const double key, const int node) {
+        heap.emplace_back(key, node);
+        std::push_heap(heap.begin(), heap.end(), std::greater<>());
+        pushCount++;
+    }
+    void pop() {
+        std::pop_heap(heap.begin(), heap.end(), std::greater<>());
+        heap.pop_back();
+        popCount++;
+    }
+    [[nodiscard]] size_t pushes() const { return pushCount; }
+    [[nodiscard]] size_t pops() const { return popCount; }
+
+private:
+    std::vector<std::pair<double, int>> heap;
+    size_t pushCount = 0;
+    size_t popCount = 0;
+};
+
+// Indexed 4-ary heap with decrease-key: every node is queued at most once, and
+// the shallower tree touches fewer cache lines per sift than a binary heap.
+class QuadHeap {
+public:
+    void prepare(size_t nodeCount);
+    [[nodiscard]] bool empty() const { return heap.empty(); }
+    [[nodiscard]] const std::pair<double, int>& top() const { return heap.front(); }
+    void push(const double key, const int node) {
+        int at = position[node];
+        if (at == -1) {
+            at = static_cast<int>(heap.size());
+            heap.emplace_back(key, node);
+        } else if (key < heap[at].first) {
+            heap[at].first = key;
+        } else {
+            return;
+        }
+        siftUp(at);
+        pushCount++;
+    }
+    void pop() {
+        position[heap.front().second] = -1;
+        heap.front() = heap.back();
+        heap.pop_back();
+        if (!heap.empty()) siftDown(0);
+        popCount++;
+    }
+    [[nodiscard]] size_t pushes() const { return pushCount; }
+    [[nodiscard]] size_t pops() const { return popCount; }
+
+private:
+    void siftUp(int at) {
+        const std::pair<double, int> entry = heap[at];
+        while (at > 0) {
+            const int parent = (at - 1) / 4;
+            if (!(entry < heap[parent])) break;
+            place(at, heap[parent]);
+            at = parent;
+        }
+        place(at, entry);
+    }
+    void siftDown(int at) {
+        const std::pair<double, int> entry = heap[at];
+        const int size = static_cast<int>(heap.size());
+        while (true) {
+            const int first = 4 * at + 1;
+            if (first >= size) break;
+            int best = first;
+            for (int child = first + 1; child < std::min(first + 4, size); child++) {
+                if (heap[child] < heap[best]) best = child;
+            }
+            if (!(heap[best] < entry)) break;
+            place(at, heap[best]);
+            at = best;
+        }
+        place(at, entry);
+    }
+    void place(const int at, const std::pair<double, int>& entry) {
+        heap[at] = entry;
+        position[entry.second] = at;
+    }
+
+    std::vector<std::pair<double, int>> heap;
+    std::vector<int> position; // node -> index in heap, -1 when not queued
+    size_t pushCount = 0;
+    size_t popCount = 0;
+};
+
+// Monotone radix heap. Keys must never drop below the last popped one, which
+// Dijkstra guarantees. A non-negative double compares like its bit pattern read
+// as an integer, so the bits are the integer key and no precision is lost.
+// Entries sit in the bucket of the highest bit where they differ from the last
+// popped key; lowered keys are second entries as in BinaryHeap.
+class RadixHeap {
+public:
+    void prepare(size_t nodeCount);
+    [[nodiscard]] bool empty() const { return size == 0; }
+    [[nodiscard]] std::pair<double, int> top() {
+        refill();
+        return {fromBits(buckets[0].back().first), buckets[0].back().second};
+    }
+    void push(const double key, const int node) {
+        const uint64_t bits = toBits(key);
+        buckets[bucketOf(bits)].emplace_back(bits, node);
+        size++;
+        pushCount++;
+    }
+    void pop() {
+        refill();
+        buckets[0].pop_back();
+        size--;
+        popCount++;
+    }
+    [[nodiscard]] size_t pushes() const { return pushCount; }
+    [[nodiscard]] size_t pops() const { return popCount; }
+
+private:
+    static uint64_t toBits(const double key) {
+        uint64_t bits;
+        std::memcpy(&bits, &key, sizeof bits);
+        return bits;
+    }
+    static double fromBits(const uint64_t bits) {
+        double key;
+        std::memcpy(&key, &bits, sizeof key);
+        return key;
+    }
+    [[nodiscard]] size_t bucketOf(const uint64_t bits) const {
+        return bits == last ? 0 : highestBit(bits ^ last) + 1;
+    }
+    // Moves the smallest bucket down around its minimum, so bucket 0 holds the top
+    void refill();
+
+    std::array<std::vector<std::pair<uint64_t, int>>, 65> buckets;
+    uint64_t last = 0;
+    size_t size = 0;
+    size_t pushCount = 0;
+    size_t popCount = 0;
+};
+
+#endif // SEARCHQUEUE_H
@@ -0,0 +1,60 @@
+#include "spatialgrid.h"
+
+void SpatialGrid::clear() {
+    cellStart.clear();
+    cellPoints.clear();
+    columns = rows = 0;
+}
+
+void SpatialGrid::attach(const Layout& layout, FlatArray<int> cells, FlatArray<CellPoint> points) {
+    minX = layout.minX;
+    minY = layout.minY;
+    maxX = layout.maxX;
+    maxY = layout.maxY;
+    cellSize = layout.cellSize;
+    columns = layout.columns;
+    rows = layout.rows;
+    cellStart = std::move(cells);
+    cellPoints = std::move(points);
+}
+
+void SpatialGrid::build(const FlatArray<std::pair<double, double>>& positions) {
+    clear();
+    if (positions.empty()) return;
+
+    minX = maxX = positions[0].first;
+    minY = maxY = positions[0].second;
+    for (const auto& [x, y] : positions) {
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+    }
+
+    // Aim for about one node per cell
+    const double width = maxX - minX, height = maxY - minY;
+    const double n = static_cast<double>(positions.size());
+    if (width > 0 && height > 0) cellSize = std::sqrt(width * height / n);
+    else cellSize = std::max(width, height) / n;
+    if (!(cellSize > 0)) cellSize = 1.0;
+
+    columns = static_cast<int>(std::min(width / cellSize, n)) + 1;
+    rows = static_cast<int>(std::min(height / cellSize, n)) + 1;
+
+    // Counting sort of the nodes into their cells
+    std::vector<int> cellOf(positions.size());
+    std::vector<int> start(static_cast<size_t>(columns) * rows + 1, 0);
+    for (size_t i = 0; i < positions.size(); ++i) {
+        cellOf[i] = row(positions[i].second) * columns + column(positions[i].first);
+        start[cellOf[i] + 1]++;
+    }
+    for (size_t c = 1; c < start.size(); ++c) start[c] += start[c - 1];
+
+    std::vector<CellPoint> points(positions.size());
+    std::vector<int> next(start.begin(), start.end() - 1);
+    for (size_t i = 0; i < positions.size(); ++i) {
+        points[next[cellOf[i]]++] = {positions[i].first, positions[i].second, static_cast<int>(i)};
+    }
+    cellStart.assign(std::move(start));
+    cellPoints.assign(std::move(points));
+}
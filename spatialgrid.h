@@ -0,0 +1,81 @@
+#ifndef SPATIALGRID_H
+#define SPATIALGRID_H
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+#include "flatarray.h"
+
+// Uniform bucket grid over the node coordinates, laid out CSR style:
+// the points of cell c are cellPoints[cellStart[c] .. cellStart[c+1]).
+class SpatialGrid {
+public:
+    struct CellPoint {
+        double x;
+        double y;
+        int id;
+    };
+
+    // Grid geometry, stored as is in map snapshots
+    struct Layout {
+        double minX, minY, maxX, maxY;
+        double cellSize;
+        int columns;
+        int rows;
+    };
+
+    void build(const FlatArray<std::pair<double, double>>& positions);
+    void clear();
+    [[nodiscard]] bool empty() const { return cellPoints.empty(); }
+
+    // Calls fn(node, distance) for every node within R of (x, y)
+    template <typename Fn>
+    void forEachWithin(double x, double y, double R, Fn&& fn) const;
+
+    // Raw arrays for snapshot files, attach() views them without copying
+    [[nodiscard]] Layout layout() const { return {minX, minY, maxX, maxY, cellSize, columns, rows}; }
+    [[nodiscard]] const FlatArray<int>& cells() const { return cellStart; }
+    [[nodiscard]] const FlatArray<CellPoint>& points() const { return cellPoints; }
+    void attach(const Layout& layout, FlatArray<int> cells, FlatArray<CellPoint> points);
+
+private:
+    // Clamped in floating point first, a huge R must not overflow the int cast
+    [[nodiscard]] int column(const double x) const {
+        return static_cast<int>(std::clamp(std::floor((x - minX) / cellSize), 0.0, columns - 1.0));
+    }
+    [[nodiscard]] int row(const double y) const {
+        return static_cast<int>(std::clamp(std::floor((y - minY) / cellSize), 0.0, rows - 1.0));
+    }
+
+    double minX{}, minY{}, maxX{}, maxY{};
+    double cellSize = 1.0;
+    int columns = 0;
+    int rows = 0;
+    FlatArray<int> cellStart;
+    FlatArray<CellPoint> cellPoints;
+};
+
+template <typename Fn>
+void SpatialGrid::forEachWithin(const double x, const double y, const double R, Fn&& fn) const {
+    if (cellPoints.empty() || R < 0) return;
+    // Query box entirely outside the map
+    if (x + R < minX || x - R > maxX || y + R < minY || y - R > maxY) return;
+
+    const int firstColumn = column(x - R), lastColumn = column(x + R);
+    const int firstRow = row(y - R), lastRow = row(y + R);
+    for (int r = firstRow; r <= lastRow; ++r) {
+        // Cells of one row are contiguous, so scan the whole column span at once
+        const int begin = cellStart[r * columns + firstColumn];
+        const int end = cellStart[r * columns + lastColumn + 1];
+        for (int i = begin; i < end; ++i) {
+            const CellPoint& p = cellPoints[i];
+            const double dx = p.x - x, dy = p.y - y;
+            if (const double distance = std::sqrt(dx * dx + dy * dy); distance <= R) {
+                fn(p.id, distance);
+            }
+        }
+    }
+}
+
+#endif // SPATIALGRID_H
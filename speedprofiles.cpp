@@ -0,0 +1,124 @@
+#include "speedprofiles.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+
+bool SpeedProfiles::build(const CsrGraph& graph, const std::vector<EdgeProfile>& profiles, std::string& error) {
+    clear();
+    std::vector<uint16_t> shapes(graph.arcCount(), 0);
+    std::vector<uint32_t> starts{0, 0};
+    std::vector<ProfilePoint> allPoints;
+    std::map<std::vector<ProfilePoint>, uint16_t> known;
+    double largest = 1;
+
+    const int nodeCount = static_cast<int>(graph.nodeCount());
+    for (size_t i = 0; i < profiles.size(); i++) {
+        const auto& [from, to, shapePoints] = profiles[i];
+        const std::string where = "profile " + std::to_string(i) + ": ";
+        if (from < 0 || from >= nodeCount || to < 0 || to >= nodeCount) {
+            error = where + "unknown node";
+            return false;
+        }
+        if (shapePoints.empty()) {
+            error = where + "no breakpoints";
+            return false;
+        }
+        for (size_t p = 0; p < shapePoints.size(); p++) {
+            const auto& [minute, factor] = shapePoints[p];
+            if (!(minute >= 0 && minute < dayMinutes) || (p > 0 && !(shapePoints[p - 1].minute < minute))) {
+                error = where + "breakpoint minutes must rise within [0, 1440)";
+                return false;
+            }
+            if (!(factor > 0) || !std::isfinite(factor)) {
+                error = where + "speed factors must be positive";
+                return false;
+            }
+        }
+
+        auto [entry, added] = known.emplace(shapePoints, static_cast<uint16_t>(known.size() + 1));
+        if (added) {
+            if (known.size() > std::numeric_limits<uint16_t>::max()) {
+                error = where + "more than 65535 distinct shapes";
+                return false;
+            }
+            allPoints.insert(allPoints.end(), shapePoints.begin(), shapePoints.end());
+            starts.push_back(static_cast<uint32_t>(allPoints.size()));
+            for (const ProfilePoint& point : shapePoints) largest = std::max(largest, static_cast<double>(point.factor));
+        }
+
+        bool found = false;
+        for (const auto& [tail, head] : {std::pair(from, to), std::pair(to, from)}) {
+            for (uint32_t arc = graph.firstArc(tail); arc < graph.lastArc(tail); arc++) {
+                if (graph.targets[arc] != head) continue;
+                shapes[arc] = entry->second;
+                found = true;
+            }
+        }
+        if (!found) {
+            error = where + "no road between " + std::to_string(from) + " and " + std::to_string(to);
+            return false;
+        }
+    }
+
+    arcShape.assign(std::move(shapes));
+    shapeStart.assign(std::move(starts));
+    points.assign(std::move(allPoints));
+    maxSpeedFactor = largest;
+    return true;
+}
+
+void SpeedProfiles::clear() {
+    arcShape.clear();
+    shapeStart.clear();
+    points.clear();
+    maxSpeedFactor = 1;
+}
+
+size_t SpeedProfiles::bytes() const {
+    return arcShape.size() * sizeof(uint16_t) + shapeStart.size() * sizeof(uint32_t) + points.size() * sizeof(ProfilePoint);
+}
+
+double SpeedProfiles::integrate(const uint16_t shape, const double distance, const double speed, const double at) const {
+    const ProfilePoint* first = points.data() + shapeStart[shape];
+    const size_t count = shapeStart[shape + 1] - shapeStart[shape];
+
+    // Segment i runs from breakpoint i to the next one, the last one to the first of the next day
+    double clock = std::fmod(at, dayMinutes);
+    if (clock < 0) clock += dayMinutes;
+    size_t i;
+    if (clock < first[0].minute) {
+        clock += dayMinutes;
+        i = count - 1;
+    } else {
+        i = static_cast<size_t>(std::upper_bound(first, first + count, clock, [](const double value, const ProfilePoint& point) {
+                return value < point.minute;
+            }) - first) - 1;
+    }
+
+    const double kmPerMinute = speed / 60;
+    double remaining = distance;
+    double elapsed = 0;
+    while (true) {
+        const bool wraps = i + 1 == count;
+        const double segmentStart = first[i].minute;
+        const double segmentEnd = wraps ? first[0].minute + dayMinutes : first[i + 1].minute;
+        const double startFactor = first[i].factor;
+        const double endFactor = wraps ? first[0].factor : first[i + 1].factor;
+
+        // Speed v(x) = a + b x, x minutes from now, within this segment
+        const double slope = (endFactor - startFactor) / (segmentEnd - segmentStart);
+        const double a = kmPerMinute * (startFactor + slope * (clock - segmentStart));
+        const double b = kmPerMinute * slope;
+        const double span = segmentEnd - clock;
+        const double covered = span * (a + 0.5 * b * span);
+        if (covered >= remaining) {
+            // Root of a x + b/2 x^2 = remaining, in the form that stays exact for b near 0
+            return elapsed + 2 * remaining / (a + std::sqrt(std::max(0.0, a * a + 2 * b * remaining)));
+        }
+        remaining -= covered;
+        elapsed += span;
+        clock = wraps ? first[0].minute : segmentEnd;
+        i = wraps ? 0 : i + 1;
+    }
+}
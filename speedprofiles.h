@@ -0,0 +1,68 @@
+#ifndef SPEEDPROFILES_H
+#define SPEEDPROFILES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "csrgraph.h"
+#include "flatarray.h"
+
+// Breakpoint of a daily speed profile: the road's speed is its base speed times
+// factor at this minute of the day, linear in between and wrapping at midnight
+struct ProfilePoint {
+    float minute; // [0, 1440)
+    float factor; // > 0
+
+    bool operator==(const ProfilePoint& other) const { return minute == other.minute && factor == other.factor; }
+    bool operator<(const ProfilePoint& other) const {
+        return minute < other.minute || (minute == other.minute && factor < other.factor);
+    }
+};
+
+// Profile of the road between two nodes, both directions
+struct EdgeProfile {
+    int from;
+    int to;
+    std::vector<ProfilePoint> points; // by minute
+};
+
+// Time-dependent arc speeds. Most roads share a handful of shapes, so every
+// distinct shape is stored once and an arc only keeps a 16-bit shape index next
+// to the other per-arc columns; the shapes themselves fit in a few cache lines.
+//
+// A vehicle drives at the profile speed of the current moment, so crossing an
+// arc integrates the speed over time. Entering later never means arriving
+// earlier (FIFO), whatever the shapes look like.
+class SpeedProfiles {
+public:
+    static constexpr double dayMinutes = 1440;
+
+    // Assigns the profiles to the arcs of their roads, identical shapes share one entry.
+    // False with error set on an unknown road, a malformed shape or too many shapes.
+    bool build(const CsrGraph& graph, const std::vector<EdgeProfile>& profiles, std::string& error);
+    void clear();
+    [[nodiscard]] bool empty() const { return arcShape.empty(); }
+    [[nodiscard]] size_t shapeCount() const { return shapeStart.empty() ? 0 : shapeStart.size() - 1; }
+    [[nodiscard]] size_t bytes() const;
+    // Largest factor of any shape (at least 1), scales the static lower bounds down
+    [[nodiscard]] double maxFactor() const { return maxSpeedFactor; }
+
+    // Minutes to cross an arc of distance km with base speed km/h, entering at minute `at`
+    // (any value, taken modulo a day). A stopped road stays stopped whatever its profile.
+    [[nodiscard]] double travelMinutes(const uint32_t arc, const double distance, const double speed, const double at) const {
+        const uint16_t shape = arcShape[arc];
+        if (shape == 0 || !(speed > 0)) return CsrGraph::travelMinutes(distance, speed);
+        return integrate(shape, distance, speed, at);
+    }
+
+private:
+    [[nodiscard]] double integrate(uint16_t shape, double distance, double speed, double at) const;
+
+    FlatArray<uint16_t> arcShape;   // arc -> shape, 0 = the base speed all day
+    FlatArray<uint32_t> shapeStart; // shapeCount + 1 entries into points, shape 0 is empty
+    FlatArray<ProfilePoint> points;
+    double maxSpeedFactor = 1;
+};
+
+#endif // SPEEDPROFILES_H
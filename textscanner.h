@@ -0,0 +1,105 @@
+#ifndef TEXTSCANNER_H
+#define TEXTSCANNER_H
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+// Whitespace separated number scanner over an in-memory buffer. Uses
+// std::from_chars, so parsing is locale independent and allocation free.
+class TextScanner {
+public:
+    TextScanner(const char* begin, const char* end) : first(begin), cursor(begin), last(end), token(begin) {}
+
+    // False on a malformed number or end of input, location() then points at it
+    template <typename T>
+    bool read(T& value) {
+        skipSpace();
+        token = cursor;
+        const char* start = cursor;
+        // from_chars rejects an explicit plus sign, the stream parser accepted it
+        if (start != last && *start == '+') ++start;
+        if constexpr (std::is_same_v<T, double>) {
+            if (readDecimal(start, value)) return true;
+        } else if constexpr (std::is_integral_v<T> && sizeof(T) >= 4) {
+            if (readInteger(start, value)) return true;
+        }
+        const auto [ptr, ec] = std::from_chars(start, last, value);
+        if (ec != std::errc() || (ptr != last && !isSpace(*ptr))) return false;
+        cursor = ptr;
+        return true;
+    }
+
+    // Whether the rest of the input is long enough for `records` records of `tokens` numbers each.
+    // Counts are checked with this instead of fixed caps, so a corrupt count fails before reserving memory
+    [[nodiscard]] bool canHold(const size_t records, const size_t tokens) const {
+        return records * tokens * 2 <= static_cast<size_t>(last - cursor) + 1;
+    }
+
+    // "line L, column C" of the last token that was read or attempted
+    [[nodiscard]] std::string location() const {
+        size_t line = 1;
+        const char* lineStart = first;
+        for (const char* p = first; p < token; ++p) {
+            if (*p == '\n') {
+                ++line;
+                lineStart = p + 1;
+            }
+        }
+        return "line " + std::to_string(line) + ", column " + std::to_string(token - lineStart + 1);
+    }
+
+private:
+    // Plain decimals ("-12.345") with at most 15 digits are a small integer divided by
+    // an exact power of ten, and one IEEE division rounds that correctly. Anything
+    // else (exponents, long mantissas, inf/nan) is left to from_chars
+    template <typename T>
+    bool readDecimal(const char* p, T& value) {
+        static constexpr double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+                                            1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15};
+        const bool negative = p != last && *p == '-';
+        if (negative) ++p;
+        uint64_t mantissa = 0;
+        int digits = 0, fraction = 0;
+        for (; p != last && static_cast<unsigned>(*p - '0') < 10; ++p, ++digits) mantissa = mantissa * 10 + (*p - '0');
+        if (p != last && *p == '.') {
+            for (++p; p != last && static_cast<unsigned>(*p - '0') < 10; ++p, ++digits, ++fraction) {
+                mantissa = mantissa * 10 + (*p - '0');
+            }
+        }
+        if (digits == 0 || digits > 15 || (p != last && !isSpace(*p))) return false;
+        const double result = static_cast<double>(mantissa) / powers[fraction];
+        value = static_cast<T>(negative ? -result : result);
+        cursor = p;
+        return true;
+    }
+
+    // Up to 9 digits always fit, longer or unsigned negative numbers go to from_chars for the range check
+    template <typename T>
+    bool readInteger(const char* p, T& value) {
+        const bool negative = p != last && *p == '-';
+        if (negative && std::is_unsigned_v<T>) return false;
+        if (negative) ++p;
+        int64_t number = 0;
+        int digits = 0;
+        for (; p != last && static_cast<unsigned>(*p - '0') < 10; ++p, ++digits) number = number * 10 + (*p - '0');
+        if (digits == 0 || digits > 9 || (p != last && !isSpace(*p))) return false;
+        value = static_cast<T>(negative ? -number : number);
+        cursor = p;
+        return true;
+    }
+
+    static bool isSpace(const char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f'; }
+    void skipSpace() {
+        while (cursor != last && isSpace(*cursor)) ++cursor;
+    }
+
+    const char* first;
+    const char* cursor;
+    const char* last;
+    const char* token;
+};
+
+#endif // TEXTSCANNER_H
@@ -0,0 +1,99 @@
+#include "threadpool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned threadCount) {
+    if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    workers.reserve(threadCount);
+    for (unsigned i = 0; i < threadCount; i++) workers.push_back(std::make_unique<Worker>());
+
+    threads.reserve(threadCount);
+    for (unsigned i = 0; i < threadCount; i++) threads.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(stateMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& thread : threads) thread.join();
+}
+
+void ThreadPool::parallelFor(const size_t count, size_t grain, const RangeFunction& fn) {
+    if (count == 0) return;
+    grain = std::max<size_t>(grain, 1);
+
+    std::lock_guard runLock(runMutex);
+    const size_t chunks = (count + grain - 1) / grain;
+    {
+        // Set before any chunk is queued, a worker still draining may pick one up early
+        std::lock_guard lock(stateMutex);
+        remaining = chunks;
+        failure = nullptr;
+    }
+
+    // Deal consecutive chunks to each worker so neighbouring queries stay on one thread
+    const size_t perWorker = (chunks + workers.size() - 1) / workers.size();
+    for (size_t c = 0; c < chunks; c++) {
+        Worker& worker = *workers[c / perWorker];
+        std::lock_guard lock(worker.mutex);
+        worker.tasks.push_back({c * grain, std::min(count, (c + 1) * grain), &fn});
+    }
+
+    std::unique_lock lock(stateMutex);
+    ++generation;
+    wake.notify_all();
+    done.wait(lock, [this] { return remaining == 0; });
+
+    if (failure) std::rethrow_exception(failure);
+}
+
+bool ThreadPool::takeTask(const unsigned index, Task& task) {
+    {
+        Worker& own = *workers[index];
+        std::lock_guard lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = own.tasks.front();
+            own.tasks.pop_front();
+            return true;
+        }
+    }
+    // Steal from the tail of the other workers' queues
+    for (size_t offset = 1; offset < workers.size(); offset++) {
+        Worker& victim = *workers[(index + offset) % workers.size()];
+        std::lock_guard lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = victim.tasks.back();
+            victim.tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(const unsigned index) {
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock lock(stateMutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+        }
+
+        Task task{};
+        while (takeTask(index, task)) {
+            std::exception_ptr error;
+            try {
+                (*task.fn)(task.begin, task.end, index);
+            } catch (...) {
+                error = std::current_exception();
+            }
+
+            std::lock_guard lock(stateMutex);
+            if (error && !failure) failure = error;
+            if (--remaining == 0) done.notify_all();
+        }
+    }
+}
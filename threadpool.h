@@ -0,0 +1,64 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that run index ranges. Each worker owns a
+// deque of chunks; it pops its own from the front and, once empty, steals
+// from the back of the others, so uneven query costs even out.
+class ThreadPool {
+public:
+    // fn(begin, end, workerIndex)
+    using RangeFunction = std::function<void(size_t, size_t, unsigned)>;
+
+    explicit ThreadPool(unsigned threadCount = 0); // 0 = one per hardware thread
+    ~ThreadPool();
+
+    [[nodiscard]] unsigned size() const { return static_cast<unsigned>(threads.size()); }
+
+    // Runs fn over [0, count) in chunks of at most `grain` and blocks until all are done.
+    // The first exception thrown by fn is rethrown here.
+    void parallelFor(size_t count, size_t grain, const RangeFunction& fn);
+
+private:
+    struct Task {
+        size_t begin;
+        size_t end;
+        const RangeFunction* fn;
+    };
+
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void workerLoop(unsigned index);
+    bool takeTask(unsigned index, Task& task);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+
+    std::mutex runMutex; // One parallelFor at a time
+
+    std::mutex stateMutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    uint64_t generation = 0;
+    size_t remaining = 0;
+    bool stopping = false;
+    std::exception_ptr failure;
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+};
+
+#endif // THREADPOOL_H